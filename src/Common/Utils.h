@@ -195,6 +195,8 @@ namespace Utils {
                          const char* format, ...) {
     if (!filedes) return false;
 
+    // Hold the stream so lines logged from several threads don't interleave
+    flockfile(filedes);
 #ifdef PREPENDED
   #ifdef COLOR_OUT
     fprintf(filedes, "%s[%s]%s ", level_colors[level].c_str(),
@@ -213,6 +215,7 @@ namespace Utils {
 
     fprintf(filedes, "%s", buffer);
     fprintf(filedes, "\n");
+    funlockfile(filedes);
     va_end(arguments);
 
     return true;
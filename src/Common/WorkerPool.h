@@ -0,0 +1,170 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is a fixed pool of worker threads for data-parallel loops.  Run
+ * splits a range of items into one contiguous share per worker and blocks
+ * until every share is done; the calling thread works the first share
+ * itself.  Threads are created once and sleep between runs, so a pool is
+ * cheap enough to reuse for every sweep of an iterative algorithm.
+ *
+ * Only one thread may call Run at a time.
+ **/
+
+#ifndef _SHL_COMMON_WORKERPOOL_H_
+#define _SHL_COMMON_WORKERPOOL_H_
+
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+class WorkerPool {
+ public:
+  /**
+   * Work function, called as task(arg, worker, begin, end) to process the
+   * items in [begin, end).  worker is in [0, size()) and is unique among
+   * the calls made by one Run, so it can index per-worker scratch space.
+   **/
+  typedef void (*Task)(void *arg, unsigned int worker, unsigned int begin,
+                       unsigned int end);
+
+  /**
+   * @param workers Number of workers including the calling thread, or 0
+   *                for one per online processor
+   **/
+  explicit WorkerPool(unsigned int workers = 0)
+    : task_(NULL), arg_(NULL), count_(0), generation_(0), pending_(0),
+      stopping_(false) {
+    size_ = workers > 0 ? workers : GetProcessorCount();
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&work_ready_, NULL);
+    pthread_cond_init(&work_done_, NULL);
+
+    // Sized up front so the starts handed to each thread never move
+    starts_.resize(size_ - 1);
+    threads_.resize(size_ - 1);
+    for (unsigned int i = 0; i < threads_.size(); ++i) {
+      starts_[i].pool_ = this;
+      starts_[i].worker_ = i + 1;
+      pthread_create(&threads_[i], NULL, &WorkerLoop, &starts_[i]);
+    }
+  }
+
+  ~WorkerPool() {
+    pthread_mutex_lock(&mutex_);
+    stopping_ = true;
+    pthread_cond_broadcast(&work_ready_);
+    pthread_mutex_unlock(&mutex_);
+
+    for (unsigned int i = 0; i < threads_.size(); ++i)
+      pthread_join(threads_[i], NULL);
+    pthread_cond_destroy(&work_done_);
+    pthread_cond_destroy(&work_ready_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  /**
+   * Runs task over the items [0, count), split evenly across the workers,
+   * and returns once all of them have finished
+   **/
+  void Run(Task task, void *arg, unsigned int count) {
+    pthread_mutex_lock(&mutex_);
+    task_ = task;
+    arg_ = arg;
+    count_ = count;
+    pending_ = threads_.size();
+    ++generation_;
+    pthread_cond_broadcast(&work_ready_);
+    pthread_mutex_unlock(&mutex_);
+
+    RunShare(0);
+
+    pthread_mutex_lock(&mutex_);
+    while (pending_ > 0)
+      pthread_cond_wait(&work_done_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  /**
+   * @return Number of workers, including the thread calling Run
+   **/
+  unsigned int size() const { return size_; }
+
+  /**
+   * @return Number of processors currently online (at least 1)
+   **/
+  static unsigned int GetProcessorCount() {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? static_cast<unsigned int>(processors) : 1;
+  }
+
+ private:
+  struct WorkerStart {
+    WorkerPool *pool_;
+    unsigned int worker_;
+  };
+
+  WorkerPool(WorkerPool const &);
+  WorkerPool &operator=(WorkerPool const &);
+
+  /**
+   * Works worker's share of the current run's items
+   **/
+  void RunShare(unsigned int worker) {
+    unsigned int begin = static_cast<unsigned long long>(count_) * worker
+                         / size_;
+    unsigned int end = static_cast<unsigned long long>(count_)
+                       * (worker + 1) / size_;
+    if (begin < end) task_(arg_, worker, begin, end);
+  }
+
+  /**
+   * Thread body: sleeps until a new run (or shutdown) is posted, works its
+   * share and reports back
+   **/
+  static void *WorkerLoop(void *arg) {
+    WorkerStart *start = reinterpret_cast<WorkerStart *>(arg);
+    WorkerPool *pool = start->pool_;
+    unsigned int seen = 0;
+
+    while (true) {
+      pthread_mutex_lock(&pool->mutex_);
+      while (pool->generation_ == seen && !pool->stopping_)
+        pthread_cond_wait(&pool->work_ready_, &pool->mutex_);
+      if (pool->stopping_) {
+        pthread_mutex_unlock(&pool->mutex_);
+        return NULL;
+      }
+      seen = pool->generation_;
+      pthread_mutex_unlock(&pool->mutex_);
+
+      pool->RunShare(start->worker_);
+
+      pthread_mutex_lock(&pool->mutex_);
+      if (--pool->pending_ == 0)
+        pthread_cond_signal(&pool->work_done_);
+      pthread_mutex_unlock(&pool->mutex_);
+    }
+  }
+
+  unsigned int size_;
+  std::vector<pthread_t> threads_;
+  std::vector<WorkerStart> starts_;
+
+  // Current run, guarded by mutex_ while it is posted and read-only while
+  // the workers are busy
+  pthread_mutex_t mutex_;
+  pthread_cond_t work_ready_;
+  pthread_cond_t work_done_;
+  Task task_;
+  void *arg_;
+  unsigned int count_;
+  unsigned int generation_;
+  unsigned int pending_;
+  bool stopping_;
+};
+
+#endif  // _SHL_COMMON_WORKERPOOL_H_
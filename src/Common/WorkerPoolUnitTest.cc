@@ -0,0 +1,79 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the WorkerPool class
+ **/
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "Common/WorkerPool.h"
+
+/**
+ * Counts how often each item is visited, and how many items each worker
+ * was handed
+ **/
+struct CountingTask {
+  std::vector<int> visits_;
+  std::vector<unsigned int> items_per_worker_;
+
+  static void Visit(void *arg, unsigned int worker, unsigned int begin,
+                    unsigned int end) {
+    CountingTask *counts = reinterpret_cast<CountingTask *>(arg);
+    for (unsigned int item = begin; item < end; ++item)
+      ++counts->visits_[item];
+    counts->items_per_worker_[worker] += end - begin;
+  }
+};
+
+/**
+ * @test    Every item is visited exactly once per run, in even shares
+ **/
+TEST(WorkerPoolTest, VisitsEveryItemOnce) {
+  WorkerPool pool(4);
+  EXPECT_EQ(4u, pool.size());
+
+  CountingTask counts;
+  counts.visits_.assign(1001, 0);
+  counts.items_per_worker_.assign(pool.size(), 0);
+  for (int run = 0; run < 50; ++run)
+    pool.Run(&CountingTask::Visit, &counts, counts.visits_.size());
+
+  for (unsigned int item = 0; item < counts.visits_.size(); ++item)
+    EXPECT_EQ(50, counts.visits_[item]);
+  for (unsigned int worker = 0; worker < pool.size(); ++worker) {
+    EXPECT_LE(50u * 250, counts.items_per_worker_[worker]);
+    EXPECT_GE(50u * 251, counts.items_per_worker_[worker]);
+  }
+
+  // Fewer items than workers, and none at all
+  counts.visits_.assign(2, 0);
+  pool.Run(&CountingTask::Visit, &counts, 2);
+  pool.Run(&CountingTask::Visit, &counts, 0);
+  EXPECT_EQ(1, counts.visits_[0]);
+  EXPECT_EQ(1, counts.visits_[1]);
+}
+
+/**
+ * @test    Pools default to one worker per processor, and a single worker
+ *          runs everything on the calling thread
+ **/
+TEST(WorkerPoolTest, Sizes) {
+  WorkerPool processors;
+  EXPECT_EQ(WorkerPool::GetProcessorCount(), processors.size());
+
+  WorkerPool single(1);
+  CountingTask counts;
+  counts.visits_.assign(10, 0);
+  counts.items_per_worker_.assign(1, 0);
+  single.Run(&CountingTask::Visit, &counts, 10);
+  EXPECT_EQ(10u, counts.items_per_worker_[0]);
+}
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
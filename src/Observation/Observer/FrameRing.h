@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is a fixed-capacity, lock-free ring of timestamped sensor frames
+ * passed from a single capturing thread to a single recognizing thread.
+ * Neither side ever blocks: a full ring refuses the frame and an empty one
+ * refuses the pop, leaving the caller to decide whether to drop or wait.
+ *
+ * Slots keep their storage between uses, and Pop swaps the consumer's
+ * vector into the slot it empties, so once frames reach a steady size
+ * neither side allocates.
+ **/
+
+#ifndef _SHL_OBSERVATION_OBSERVER_FRAMERING_H_
+#define _SHL_OBSERVATION_OBSERVER_FRAMERING_H_
+
+#include <vector>
+
+namespace Observation {
+
+class FrameRing {
+ public:
+  /**
+   * @param capacity Frames held at once (at least 1)
+   **/
+  explicit FrameRing(unsigned int capacity)
+    : slots_((capacity > 0 ? capacity : 1) + 1), head_(0), tail_(0) {}
+
+  /**
+   * Producer side: copies a frame into the ring
+   *
+   * @param sequence  Capture slot the frame was taken in
+   * @param timestamp System time in milliseconds the frame was taken
+   *
+   * @return false, leaving the ring untouched, if it is full
+   **/
+  bool Push(unsigned int sequence, double timestamp,
+            std::vector<double> const &values) {
+    unsigned int tail = tail_;
+    unsigned int next = (tail + 1) % slots_.size();
+    if (next == head_) return false;
+
+    // The consumer is done with the slot once head_ has moved past it
+    __sync_synchronize();
+    Slot &slot = slots_[tail];
+    slot.sequence_ = sequence;
+    slot.timestamp_ = timestamp;
+    slot.values_.assign(values.begin(), values.end());
+
+    // Publish the slot only after its contents are written
+    __sync_synchronize();
+    tail_ = next;
+    return true;
+  }
+
+  /**
+   * Consumer side: takes the oldest frame out of the ring
+   *
+   * @return false, leaving the outputs untouched, if the ring is empty
+   **/
+  bool Pop(unsigned int *sequence, double *timestamp,
+           std::vector<double> *values) {
+    unsigned int head = head_;
+    if (head == tail_) return false;
+
+    __sync_synchronize();
+    Slot &slot = slots_[head];
+    *sequence = slot.sequence_;
+    *timestamp = slot.timestamp_;
+    values->swap(slot.values_);
+
+    // Release the slot only after it has been read
+    __sync_synchronize();
+    head_ = (head + 1) % slots_.size();
+    return true;
+  }
+
+  bool empty() const { return head_ == tail_; }
+  unsigned int get_capacity() const { return slots_.size() - 1; }
+
+ private:
+  struct Slot {
+    Slot() : sequence_(0), timestamp_(0.) {}
+
+    unsigned int sequence_;
+    double timestamp_;
+    std::vector<double> values_;
+  };
+
+  // One slot always stays empty to tell a full ring from an empty one
+  std::vector<Slot> slots_;
+
+  // Next slot to pop, written only by the consumer
+  volatile unsigned int head_;
+
+  // Next slot to push, written only by the producer
+  volatile unsigned int tail_;
+};
+
+}  // namespace Observation
+
+#endif  // _SHL_OBSERVATION_OBSERVER_FRAMERING_H_
@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the single-producer, single-consumer frame ring
+ **/
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+#include "Observer/FrameRing.h"
+
+namespace Observation {
+
+static const unsigned int STREAM_LENGTH = 200000;
+
+/**
+ * Pushes frames 0, 1, 2, ... into the ring, retrying while it is full
+ **/
+static void *Produce(void *arg) {
+  FrameRing *ring = static_cast<FrameRing *>(arg);
+  std::vector<double> values(3);
+  for (unsigned int i = 0; i < STREAM_LENGTH; ++i) {
+    values[0] = i;
+    values[2] = -static_cast<double>(i);
+    while (!ring->Push(i, i * .5, values)) sched_yield();
+  }
+  return NULL;
+}
+
+/**
+ * @test    Frames come out in order, and a full ring refuses new ones
+ **/
+TEST(FrameRingTest, FullAndEmpty) {
+  FrameRing ring(3);
+  EXPECT_EQ(3u, ring.get_capacity());
+  EXPECT_TRUE(ring.empty());
+
+  unsigned int sequence = 0;
+  double timestamp = 0.;
+  std::vector<double> values;
+  EXPECT_FALSE(ring.Pop(&sequence, &timestamp, &values));
+
+  // Wrap around the ring a few times
+  for (unsigned int round = 0; round < 4; ++round) {
+    for (unsigned int i = 0; i < 3; ++i)
+      EXPECT_TRUE(ring.Push(round * 3 + i, i, std::vector<double>(i + 1, i)));
+    EXPECT_FALSE(ring.Push(99, 99., std::vector<double>()));
+
+    for (unsigned int i = 0; i < 3; ++i) {
+      ASSERT_TRUE(ring.Pop(&sequence, &timestamp, &values));
+      EXPECT_EQ(round * 3 + i, sequence);
+      EXPECT_EQ(static_cast<double>(i), timestamp);
+      EXPECT_EQ(std::vector<double>(i + 1, i), values);
+    }
+    EXPECT_TRUE(ring.empty());
+  }
+}
+
+/**
+ * @test    A consumer on another thread sees every frame, whole and in
+ *          order
+ **/
+TEST(FrameRingTest, ProducerConsumer) {
+  FrameRing ring(16);
+  pthread_t producer;
+  pthread_create(&producer, NULL, &Produce, &ring);
+
+  unsigned int sequence = 0;
+  double timestamp = 0.;
+  std::vector<double> values;
+  unsigned int errors = 0;
+  for (unsigned int i = 0; i < STREAM_LENGTH; ++i) {
+    while (!ring.Pop(&sequence, &timestamp, &values)) sched_yield();
+    if (sequence != i || timestamp != i * .5 || values.size() != 3
+        || values[0] != i || values[2] != -static_cast<double>(i))
+      ++errors;
+  }
+  pthread_join(producer, NULL);
+
+  EXPECT_EQ(0u, errors);
+  EXPECT_TRUE(ring.empty());
+}
+
+}  // namespace Observation
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
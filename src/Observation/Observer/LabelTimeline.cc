@@ -0,0 +1,208 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of an observer's interval-based label timeline
+ **/
+
+#include <algorithm>
+#include <queue>
+#include "Observer/LabelTimeline.h"
+
+namespace Observation {
+
+const unsigned int LabelTimeline::UNKNOWN_LABEL = 0;
+const double LabelTimeline::UNKNOWN_SCORE = 0.5;
+
+namespace {
+
+/**
+ * A segment covering the sweep's frame; the heap's top is the highest
+ * scoring, earliest added one
+ **/
+struct ActiveSegment {
+  ActiveSegment(double score, unsigned int index, int last_frame)
+    : score_(score), index_(index), last_frame_(last_frame) {}
+
+  bool operator<(ActiveSegment const &other) const {
+    if (score_ != other.score_) return score_ < other.score_;
+    return index_ > other.index_;
+  }
+
+  double score_;
+  unsigned int index_;
+  int last_frame_;
+};
+
+}  // namespace
+
+/**
+ * Orders segment indices by first frame
+ **/
+struct LabelTimeline::ByFirstFrame {
+  explicit ByFirstFrame(vector<Segment> const &segments)
+    : segments_(segments) {}
+
+  bool operator()(unsigned int a, unsigned int b) const {
+    return segments_[a].first_frame_ < segments_[b].first_frame_;
+  }
+
+  vector<Segment> const &segments_;
+};
+
+LabelTimeline::LabelTimeline() : first_frame_(0), frame_count_(0) {
+  InternLabel("Unknown");
+}
+
+unsigned int LabelTimeline::InternLabel(string const &name) {
+  map<string, unsigned int>::const_iterator found = ids_.find(name);
+  if (found != ids_.end()) return found->second;
+
+  unsigned int id = names_.size();
+  names_.push_back(name);
+  ids_[name] = id;
+  label_segments_.push_back(vector<unsigned int>());
+  return id;
+}
+
+bool LabelTimeline::FindLabel(string const &name, unsigned int *id) const {
+  map<string, unsigned int>::const_iterator found = ids_.find(name);
+  if (found == ids_.end()) return false;
+  *id = found->second;
+  return true;
+}
+
+bool LabelTimeline::AddSegment(unsigned int label, double score,
+                               int first_frame, int last_frame) {
+  if (label >= names_.size()) return false;
+  if (first_frame < first_frame_) first_frame = first_frame_;
+  if (last_frame >= get_end_frame()) last_frame = get_end_frame() - 1;
+  if (first_frame > last_frame) return false;
+
+  Segment segment;
+  segment.first_frame_ = first_frame;
+  segment.last_frame_ = last_frame;
+  segment.score_ = score;
+  segment.label_ = label;
+  label_segments_[label].push_back(segments_.size());
+  segments_.push_back(segment);
+  return true;
+}
+
+void LabelTimeline::DropFrames(unsigned int count) {
+  if (count > frame_count_) count = frame_count_;
+  first_frame_ += count;
+  frame_count_ -= count;
+
+  // Compact the segments still in view, keeping the order they were added
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < segments_.size(); ++i) {
+    if (segments_[i].last_frame_ >= first_frame_)
+      segments_[kept++] = segments_[i];
+  }
+  segments_.resize(kept);
+
+  for (unsigned int i = 0; i < label_segments_.size(); ++i)
+    label_segments_[i].clear();
+  for (unsigned int i = 0; i < segments_.size(); ++i)
+    label_segments_[segments_[i].label_].push_back(i);
+}
+
+void LabelTimeline::Clear() {
+  segments_.clear();
+  for (unsigned int i = 0; i < label_segments_.size(); ++i)
+    label_segments_[i].clear();
+  first_frame_ = 0;
+  frame_count_ = 0;
+}
+
+void LabelTimeline::Sweep(vector<unsigned int> const &indices,
+                          vector<int> *best) const {
+  best->assign(frame_count_, -1);
+  if (indices.empty()) return;
+
+  // Segments are added as they end, so sort the subset by where they start
+  vector<unsigned int> order(indices);
+  std::stable_sort(order.begin(), order.end(), ByFirstFrame(segments_));
+
+  std::priority_queue<ActiveSegment> active;
+  unsigned int next = 0;
+  for (unsigned int i = 0; i < frame_count_; ++i) {
+    int f = first_frame_ + static_cast<int>(i);
+    for (; next < order.size()
+           && segments_[order[next]].first_frame_ <= f; ++next) {
+      Segment const &segment = segments_[order[next]];
+      active.push(ActiveSegment(segment.score_, order[next],
+                                segment.last_frame_));
+    }
+
+    // Segments that ended are only dropped once they reach the top
+    while (!active.empty() && active.top().last_frame_ < f) active.pop();
+    if (!active.empty()) (*best)[i] = active.top().index_;
+  }
+}
+
+void LabelTimeline::GetBestLabels(vector<string> *labels) const {
+  vector<unsigned int> ids;
+  vector<double> scores;
+  GetBestLabelIds(&ids, &scores);
+
+  labels->resize(ids.size());
+  for (unsigned int f = 0; f < ids.size(); ++f)
+    (*labels)[f] = names_[ids[f]];
+}
+
+void LabelTimeline::GetBestLabelIds(vector<unsigned int> *labels,
+                                    vector<double> *scores) const {
+  vector<unsigned int> indices(segments_.size());
+  for (unsigned int i = 0; i < indices.size(); ++i) indices[i] = i;
+  vector<int> best;
+  Sweep(indices, &best);
+
+  labels->assign(frame_count_, UNKNOWN_LABEL);
+  scores->assign(frame_count_, UNKNOWN_SCORE);
+  for (unsigned int f = 0; f < frame_count_; ++f) {
+    if (best[f] >= 0 && segments_[best[f]].score_ > UNKNOWN_SCORE) {
+      (*labels)[f] = segments_[best[f]].label_;
+      (*scores)[f] = segments_[best[f]].score_;
+    }
+  }
+}
+
+void LabelTimeline::GetBestScores(unsigned int label,
+                                  vector<double> *scores) const {
+  scores->assign(frame_count_, 0.);
+  if (label >= names_.size()) return;
+
+  vector<int> best;
+  Sweep(label_segments_[label], &best);
+  double floor = label == UNKNOWN_LABEL ? UNKNOWN_SCORE : 0.;
+  for (unsigned int f = 0; f < frame_count_; ++f) {
+    double score = best[f] >= 0 ? segments_[best[f]].score_ : 0.;
+    (*scores)[f] = score > floor ? score : floor;
+  }
+}
+
+bool LabelTimeline::HasSegments(unsigned int label) const {
+  if (label == UNKNOWN_LABEL) return true;
+  return label < names_.size() && !label_segments_[label].empty();
+}
+
+void LabelTimeline::GetFrameLabels(
+    vector<vector<pair<double, string> > > *frames) const {
+  frames->assign(frame_count_, vector<pair<double, string> >(
+    1, pair<double, string>(UNKNOWN_SCORE, names_[UNKNOWN_LABEL])));
+  for (unsigned int i = 0; i < segments_.size(); ++i) {
+    Segment const &segment = segments_[i];
+    pair<double, string> label(segment.score_, names_[segment.label_]);
+    int first = segment.first_frame_ > first_frame_ ? segment.first_frame_
+                                                    : first_frame_;
+    for (int f = first; f <= segment.last_frame_; ++f)
+      (*frames)[f - first_frame_].push_back(label);
+  }
+}
+
+}  // namespace Observation
@@ -0,0 +1,165 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an observer's record of which primitives were recognized when.
+ * Each detection is kept once, as a scored segment of frames under an
+ * interned label id, rather than copied into every frame it spans.  Every
+ * frame also carries the label "Unknown" at UNKNOWN_SCORE.
+ *
+ * Per-frame questions (the best label, a label's best score) are answered
+ * by sweeping the frames once with a heap of the segments covering the
+ * current frame, so their cost grows with frames + segments instead of
+ * with frames x segments.
+ *
+ * Frames are numbered from the start of observation.  The oldest can be
+ * dropped once final, so a long session only holds a window of recent
+ * frames, and per-frame results cover the frames held: entry i is frame
+ * get_first_frame() + i.
+ **/
+
+#ifndef _SHL_OBSERVATION_OBSERVER_LABELTIMELINE_H_
+#define _SHL_OBSERVATION_OBSERVER_LABELTIMELINE_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Observation {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+class LabelTimeline {
+ public:
+  /**
+   * Id of the label "Unknown", and the score every frame carries it at
+   **/
+  static const unsigned int UNKNOWN_LABEL;
+  static const double UNKNOWN_SCORE;
+
+  LabelTimeline();
+
+  /**
+   * @return Id of the label name, added if it is new.  Ids stay valid
+   *         across Clear.
+   **/
+  unsigned int InternLabel(string const &name);
+
+  /**
+   * @param id Populated with the name's label id
+   * @return false if name was never interned
+   **/
+  bool FindLabel(string const &name, unsigned int *id) const;
+
+  string const &get_label_name(unsigned int id) const { return names_[id]; }
+  unsigned int get_label_count() const { return names_.size(); }
+
+  /**
+   * Adds frames, labeled only "Unknown", to the end of the timeline
+   **/
+  void AppendFrames(unsigned int count) { frame_count_ += count; }
+
+  /**
+   * Drops the oldest count frames, and every segment that ends before the
+   * frames left
+   **/
+  void DropFrames(unsigned int count);
+
+  /**
+   * Labels frames [first_frame, last_frame] with label at score, clipped
+   * to the frames the timeline holds
+   *
+   * @return false if label was never interned or no frame is left
+   **/
+  bool AddSegment(unsigned int label, double score, int first_frame,
+                  int last_frame);
+
+  /**
+   * Drops every frame and segment, keeping the interned labels, and
+   * numbers frames from 0 again
+   **/
+  void Clear();
+
+  /**
+   * @return Number of frames held
+   **/
+  unsigned int size() const { return frame_count_; }
+
+  /**
+   * @return Number of the oldest frame held, and one past the newest
+   **/
+  int get_first_frame() const { return first_frame_; }
+  int get_end_frame() const {
+    return first_frame_ + static_cast<int>(frame_count_);
+  }
+  unsigned int get_segment_count() const { return segments_.size(); }
+
+  /**
+   * Populates labels with each frame's highest scoring label name.  Ties
+   * go to "Unknown", then to the segment added first.
+   **/
+  void GetBestLabels(vector<string> *labels) const;
+
+  /**
+   * As GetBestLabels, populating label ids and their scores instead
+   **/
+  void GetBestLabelIds(vector<unsigned int> *labels,
+                       vector<double> *scores) const;
+
+  /**
+   * Populates scores with label's highest score in each frame, or 0 where
+   * nothing higher covers it
+   **/
+  void GetBestScores(unsigned int label, vector<double> *scores) const;
+
+  /**
+   * @return true if label covers any frame, which "Unknown" always does
+   **/
+  bool HasSegments(unsigned int label) const;
+
+  /**
+   * Populates frames with every frame's <score, label name> pairs,
+   * "Unknown" first and then in the order segments were added.  This
+   * copies each segment into every frame it spans, so it is meant for
+   * inspection rather than for long sessions.
+   **/
+  void GetFrameLabels(vector<vector<pair<double, string> > > *frames) const;
+
+ private:
+  struct Segment {
+    int first_frame_;
+    int last_frame_;
+    double score_;
+    unsigned int label_;
+  };
+
+  struct ByFirstFrame;
+
+  /**
+   * Sweeps the frames with the segments listed in indices, populating best
+   * with each frame's highest scoring segment index, earliest added winning
+   * ties, or -1 where none covers it
+   **/
+  void Sweep(vector<unsigned int> const &indices, vector<int> *best) const;
+
+  vector<string> names_;
+  map<string, unsigned int> ids_;
+
+  // Indices into segments_ per label id, in the order they were added
+  vector<vector<unsigned int> > label_segments_;
+
+  vector<Segment> segments_;
+  int first_frame_;
+  unsigned int frame_count_;
+};
+
+}  // namespace Observation
+
+#endif  // _SHL_OBSERVATION_OBSERVER_LABELTIMELINE_H_
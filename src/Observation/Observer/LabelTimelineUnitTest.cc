@@ -0,0 +1,180 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the observer's interval-based label timeline
+ **/
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Observer/LabelTimeline.h"
+
+namespace Observation {
+
+/**
+ * @test    Labels intern once, and "Unknown" is always there
+ **/
+TEST(LabelTimelineTest, InternLabels) {
+  LabelTimeline timeline;
+  EXPECT_EQ(1u, timeline.get_label_count());
+  EXPECT_EQ("Unknown", timeline.get_label_name(LabelTimeline::UNKNOWN_LABEL));
+
+  unsigned int wave = timeline.InternLabel("wave");
+  EXPECT_EQ(wave, timeline.InternLabel("wave"));
+  EXPECT_NE(wave, timeline.InternLabel("point"));
+
+  unsigned int id = 0;
+  ASSERT_TRUE(timeline.FindLabel("wave", &id));
+  EXPECT_EQ(wave, id);
+  EXPECT_FALSE(timeline.FindLabel("nod", &id));
+
+  timeline.AppendFrames(3);
+  EXPECT_TRUE(timeline.AddSegment(wave, 1., 0, 2));
+  timeline.Clear();
+  EXPECT_EQ(0u, timeline.size());
+  EXPECT_EQ(0u, timeline.get_segment_count());
+  EXPECT_EQ(wave, timeline.InternLabel("wave"));
+  EXPECT_FALSE(timeline.HasSegments(wave));
+}
+
+/**
+ * @test    The best label per frame follows scores, with ties to "Unknown"
+ *          and then to the earliest segment, and segments are clipped
+ **/
+TEST(LabelTimelineTest, BestLabels) {
+  LabelTimeline timeline;
+  unsigned int wave = timeline.InternLabel("wave");
+  unsigned int point = timeline.InternLabel("point");
+  timeline.AppendFrames(8);
+
+  EXPECT_TRUE(timeline.AddSegment(wave, .9, 1, 4));
+  EXPECT_TRUE(timeline.AddSegment(point, .9, 3, 6));
+  EXPECT_TRUE(timeline.AddSegment(point, 2., 6, 20));
+  EXPECT_TRUE(timeline.AddSegment(wave, .5, 0, 0));
+  EXPECT_FALSE(timeline.AddSegment(wave, 1., 9, 12));
+  EXPECT_FALSE(timeline.AddSegment(99, 1., 0, 1));
+
+  std::vector<std::string> labels;
+  timeline.GetBestLabels(&labels);
+  const char *expected[] = {"Unknown", "wave", "wave", "wave", "wave",
+                            "point", "point", "point"};
+  ASSERT_EQ(8u, labels.size());
+  for (unsigned int f = 0; f < labels.size(); ++f)
+    EXPECT_EQ(expected[f], labels[f]) << "frame " << f;
+
+  std::vector<double> scores;
+  timeline.GetBestScores(point, &scores);
+  const double expected_scores[] = {0., 0., 0., .9, .9, .9, 2., 2.};
+  for (unsigned int f = 0; f < scores.size(); ++f)
+    EXPECT_DOUBLE_EQ(expected_scores[f], scores[f]) << "frame " << f;
+
+  timeline.GetBestScores(LabelTimeline::UNKNOWN_LABEL, &scores);
+  EXPECT_EQ(std::vector<double>(8, LabelTimeline::UNKNOWN_SCORE), scores);
+}
+
+/**
+ * @test    Dropping old frames keeps frame numbers and the segments still
+ *          in view
+ **/
+TEST(LabelTimelineTest, DropFrames) {
+  LabelTimeline timeline;
+  unsigned int wave = timeline.InternLabel("wave");
+  unsigned int point = timeline.InternLabel("point");
+  timeline.AppendFrames(6);
+  EXPECT_TRUE(timeline.AddSegment(wave, 1., 0, 1));
+  EXPECT_TRUE(timeline.AddSegment(point, 2., 1, 4));
+
+  timeline.DropFrames(2);
+  EXPECT_EQ(2, timeline.get_first_frame());
+  EXPECT_EQ(6, timeline.get_end_frame());
+  EXPECT_EQ(4u, timeline.size());
+  EXPECT_EQ(1u, timeline.get_segment_count());
+  EXPECT_FALSE(timeline.HasSegments(wave));
+
+  // Segments reaching back before the first frame are clipped to it
+  timeline.AppendFrames(1);
+  EXPECT_FALSE(timeline.AddSegment(wave, 3., 0, 1));
+  EXPECT_TRUE(timeline.AddSegment(wave, 3., 0, 2));
+
+  std::vector<unsigned int> ids;
+  std::vector<double> scores;
+  timeline.GetBestLabelIds(&ids, &scores);
+  ASSERT_EQ(5u, ids.size());
+  EXPECT_EQ(wave, ids[0]);
+  EXPECT_DOUBLE_EQ(3., scores[0]);
+  EXPECT_EQ(point, ids[1]);
+  EXPECT_EQ(LabelTimeline::UNKNOWN_LABEL, ids[3]);
+  EXPECT_DOUBLE_EQ(LabelTimeline::UNKNOWN_SCORE, scores[3]);
+
+  std::vector<std::vector<std::pair<double, std::string> > > frames;
+  timeline.GetFrameLabels(&frames);
+  ASSERT_EQ(5u, frames.size());
+  EXPECT_EQ(3u, frames[0].size());
+
+  timeline.DropFrames(10);
+  EXPECT_EQ(0u, timeline.size());
+  EXPECT_EQ(7, timeline.get_first_frame());
+  EXPECT_EQ(0u, timeline.get_segment_count());
+}
+
+/**
+ * @test    Sweeps agree with the label-per-frame expansion on random
+ *          overlapping segments
+ **/
+TEST(LabelTimelineTest, MatchesExpansion) {
+  LabelTimeline timeline;
+  std::vector<unsigned int> ids;
+  ids.push_back(timeline.InternLabel("a"));
+  ids.push_back(timeline.InternLabel("b"));
+  ids.push_back(timeline.InternLabel("c"));
+  timeline.AppendFrames(200);
+
+  unsigned int seed = 7;
+  for (int i = 0; i < 300; ++i) {
+    int first = rand_r(&seed) % 200;
+    int last = first + rand_r(&seed) % 30;
+    double score = (rand_r(&seed) % 8) / 4.;
+    timeline.AddSegment(ids[rand_r(&seed) % ids.size()], score, first, last);
+  }
+
+  std::vector<std::vector<std::pair<double, std::string> > > frames;
+  timeline.GetFrameLabels(&frames);
+  std::vector<std::string> labels;
+  timeline.GetBestLabels(&labels);
+  ASSERT_EQ(200u, frames.size());
+  ASSERT_EQ(200u, labels.size());
+
+  std::vector<std::vector<double> > scores(ids.size());
+  for (unsigned int i = 0; i < ids.size(); ++i)
+    timeline.GetBestScores(ids[i], &scores[i]);
+
+  for (unsigned int f = 0; f < frames.size(); ++f) {
+    // First strictly higher score wins, starting from "Unknown"
+    unsigned int best = 0;
+    std::vector<double> best_scores(ids.size(), 0.);
+    for (unsigned int l = 0; l < frames[f].size(); ++l) {
+      if (frames[f][l].first > frames[f][best].first) best = l;
+      for (unsigned int i = 0; i < ids.size(); ++i) {
+        if (frames[f][l].second == timeline.get_label_name(ids[i])
+            && frames[f][l].first > best_scores[i])
+          best_scores[i] = frames[f][l].first;
+      }
+    }
+    EXPECT_EQ(frames[f][best].second, labels[f]) << "frame " << f;
+    for (unsigned int i = 0; i < ids.size(); ++i)
+      EXPECT_DOUBLE_EQ(best_scores[i], scores[i][f]) << "frame " << f;
+  }
+}
+
+}  // namespace Observation
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -12,7 +12,9 @@
 #ifndef _SHL_OBSERVATION_OBSERVER_OBSERVER_H_
 #define _SHL_OBSERVATION_OBSERVER_OBSERVER_H_
 
+#include <utility>
 #include <vector>
+#include "Observer/RecognitionListener.h"
 
 namespace Primitives {
 class QLearner;
@@ -72,9 +74,46 @@ class Observer {
   std::vector<Sensor *> & get_sensors() { return sensors_; }
   std::vector<QLearner *> & get_primitives() { return primitives_; }
 
+  /**
+   * Subscribes a listener to recognitions, which it receives as soon as the
+   * observer labels them rather than after observation ends.  Listeners
+   * should not be added or removed while observing.
+   *
+   * @param listener  Receives recognitions; not owned
+   * @param threshold Lowest score of the recognitions it receives
+   */
+  void AddListener(RecognitionListener *listener, double threshold) {
+    listeners_.push_back(std::make_pair(listener, threshold));
+  }
+
+  /**
+   * @return False if listener was never added
+   */
+  bool RemoveListener(RecognitionListener *listener) {
+    std::vector<std::pair<RecognitionListener *, double> >::iterator iter;
+    for (iter = listeners_.begin(); iter != listeners_.end(); ++iter) {
+      if (iter->first == listener) {
+        listeners_.erase(iter);
+        return true;
+      }
+    }
+    return false;
+  }
+
  protected:
+  /**
+   * Passes event to every listener whose threshold it reaches
+   */
+  void NotifyListeners(RecognitionEvent const &event) {
+    for (unsigned int i = 0; i < listeners_.size(); ++i) {
+      if (event.score_ >= listeners_[i].second)
+        listeners_[i].first->ReceiveRecognition(event);
+    }
+  }
+
   std::vector<Sensor *> sensors_;
   std::vector<QLearner *> primitives_;
+  std::vector<std::pair<RecognitionListener *, double> > listeners_;
 };
 
 }  // namespace Observation
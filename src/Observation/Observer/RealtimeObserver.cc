@@ -10,24 +10,48 @@
  */
 
 #include "Observer/RealtimeObserver.h"
+#include <math.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <vector>
 #include <deque>
+#include <set>
 #include <utility>
 #include "Primitives/QLearner/QTable.h"
 #include "Primitives/QLearner/State.h"
 #include "Common/Utils.h"
+#include "Common/WorkerPool.h"
+#include "Observer/FrameRing.h"
 namespace Observation {
 
 using google::protobuf::int64;
 using std::pair;
 using std::vector;
 using std::string;
+using std::set;
 using Primitives::State;
 using Primitives::QTable;
+using Primitives::Registry;
+using Primitives::RewardOverlay;
+using Primitives::TransitionGraph;
 using Utils::Log;
 
+RealtimeObserver::~RealtimeObserver() {
+  delete worker_pool_;
+}
+
+void RealtimeObserver::set_scoring_workers(unsigned int workers) {
+  delete worker_pool_;
+  worker_pool_ = NULL;
+  if (workers != 1) worker_pool_ = new WorkerPool(workers);
+}
+
+unsigned int RealtimeObserver::get_scoring_workers() const {
+  return worker_pool_ != NULL ? worker_pool_->size() : 1;
+}
+
 bool RealtimeObserver::Observe(Task* task, double duration) {
     duration_ = duration;
     return Observe(task);
@@ -35,9 +59,6 @@ bool RealtimeObserver::Observe(Task* task, double duration) {
 
 bool RealtimeObserver::Observe(Task* task) {
   FILE *log_stream = stderr;
-  double LEARNING_RATE = 0.2;
-  double DISCOUNT_FACTOR = 0.9;
-  const double WAYPOINT_PERCENTAGE = 85; // 0 - 100, % of hit_states to make wps
 
   if (sensors_.size() == 0) {
     Log(log_stream, DEBUG, (string("No sensors defined on observer.")).c_str());
@@ -62,612 +83,791 @@ bool RealtimeObserver::Observe(Task* task) {
   for (p_iter = primitives_.begin(); p_iter != primitives_.end(); ++p_iter) {
     ObservablePrimitive *op =
       new ObservablePrimitive((*p_iter)->get_name(), (*p_iter));
+    op->label_id = timeline_.InternLabel(op->name);
     primitives.push_back(op);
   }
 
+  // Primitives are independent unless two of them share a QLearner, in
+  // which case they would race on its QTable and must be scored in turn
+  set<QLearner *> learners(primitives_.begin(), primitives_.end());
+  bool parallel_scoring = worker_pool_ != NULL
+                          && learners.size() == primitives_.size();
+  vector<PrimitiveLabel> labels;
+
+  // A detection reaches back at most 1.5 times its primitive's longest
+  // duration, so frames older than that are final
+  double longest_millis = 0.;
+  for (unsigned int i = 0; i < primitives.size(); ++i) {
+    if (primitives[i]->duration_max_millis > longest_millis)
+      longest_millis = primitives[i]->duration_max_millis;
+  }
+  stream_window_ = static_cast<unsigned int>(
+    ceil(longest_millis * 1.5 / sampling_rate_)) + 2;
+
+  timeline_.Clear();
+  frames_.clear();
+  dropped_frames_ = 0;
+  overrun_frames_ = 0;
+
+  FrameJob job;
+  job.observer_ = this;
+  job.primitives_ = &primitives;
+  job.labels_ = &labels;
+  job.unified_frame_ = &unified_frame;
+  job.start_time_ = offline_ ? 0. : GetTimeMillis();
+  double end_time = job.start_time_ + duration_;
+
+  if (offline_) {
+    // Virtual time: each frame is taken one sampling period after the last,
+    // as soon as the previous one is recognized
+    int cur_frame = 0;
+    while (is_observing_) {
+      job.cur_time_ms_ = job.start_time_ + cur_frame * sampling_rate_;
+      if (duration_ > 0. && job.cur_time_ms_ >= end_time) break;
+
+      CaptureFrame(cur_frame, &unified_frame);
+      if (!SensorsRunning()) break;
+      job.cur_frame_ = cur_frame;
+      RecognizeFrame(&job, parallel_scoring);
+      ++cur_frame;
+    }
+  } else if (ring_capacity_ > 0) {
+    // Capture on its own thread, on a fixed schedule, and recognize here
+    // whatever it has queued
+    FrameRing ring(ring_capacity_);
+    CaptureJob capture;
+    capture.observer_ = this;
+    capture.ring_ = &ring;
+    capture.start_time_ = job.start_time_;
+    capture.end_time_ = end_time;
+    capture.done_ = false;
+
+    pthread_t capture_thread;
+    pthread_create(&capture_thread, NULL, &CaptureLoop, &capture);
+
+    struct timespec idle_ts;
+    idle_ts.tv_sec = 0;
+    idle_ts.tv_nsec = static_cast<long>(sampling_rate_ * 1000000. / 4.);
+    unsigned int sequence;
+    while (true) {
+      // Check done_ before popping, so no frame is left behind on exit
+      bool capture_done = capture.done_;
+      __sync_synchronize();
+      if (ring.Pop(&sequence, &job.cur_time_ms_, &unified_frame)) {
+        job.cur_frame_ = sequence;
+        RecognizeFrame(&job, parallel_scoring);
+      } else if (capture_done) {
+        break;
+      } else {
+        nanosleep(&idle_ts, NULL);
+      }
+    }
+    pthread_join(capture_thread, NULL);
+  } else {
+    double cur_time_ms = job.start_time_;
+    double last_frame_time_ms = 0.;
+    int cur_frame = 0;
+
+    // Observe for pre-specified duration
+    while (is_observing_ && cur_time_ms < end_time) {
+      // Wait for next sensor update
+      double wait_time_ms = (sampling_rate_
+                             - (cur_time_ms - last_frame_time_ms));
+      if (wait_time_ms > 0) {
+        struct timespec wait_ts;
+        wait_ts.tv_sec = 0;
+        wait_ts.tv_nsec = wait_time_ms * 1000000;
+        nanosleep(&wait_ts, NULL);
+      } else if (last_frame_time_ms > 0.) {
+        overrun_frames_ += static_cast<unsigned int>(-wait_time_ms
+                                                     / sampling_rate_);
+      }
+
+      cur_time_ms = GetTimeMillis();
+      last_frame_time_ms = cur_time_ms;
+
+      CaptureFrame(cur_frame, &unified_frame);
+      job.cur_time_ms_ = cur_time_ms;
+      job.cur_frame_ = cur_frame;
+      RecognizeFrame(&job, parallel_scoring);
+      ++cur_frame;
+    }
+  }
+
+  if (sink_ != NULL) EmitFrames(timeline_.size());
+
+  vector<ObservablePrimitive *>::iterator op_iter;
+  for (op_iter = primitives.begin(); op_iter != primitives.end();
+     ++op_iter) {
+    ObservablePrimitive *p = *op_iter;
+    delete p;
+    p = NULL;
+  }
+
+  return true;
+}
+
+double RealtimeObserver::GetTimeMillis() {
   struct timespec time;
   clock_gettime(CLOCK_REALTIME, &time);
-  double cur_time_ms = (time.tv_sec * 1000.) +
-                       (static_cast<double>(time.tv_nsec) / 1000000.);
+  return (time.tv_sec * 1000.) +
+         (static_cast<double>(time.tv_nsec) / 1000000.);
+}
 
+void RealtimeObserver::CaptureFrame(int cur_frame,
+                                    vector<double> *unified_frame) {
+  unified_frame->clear();
 
-  int cur_frame = 0;
-  double start_time = cur_time_ms;
-  double end_time = start_time + duration_;
-  double last_frame_time_ms = 0.;
+  #ifdef VERBOSE_MODE
+  // Retrieve latest sensor d
+  char buf[1024];
+  snprintf(buf, sizeof(buf),
+          "Capturing Frame %d with %ld sensors...", cur_frame,
+           sensors_.size());
+  Log(stderr, DEBUG, buf);
+  #endif
 
-  timeline_.clear();
-  frames_.clear();
+  unsigned int sens_iter;
+  for (sens_iter = 0; sens_iter < sensors_.size();
+       ++sens_iter) {
+    Sensor *sensor = sensors_[sens_iter];
 
-  // Observe for pre-specified duration
-  while (is_observing_ && cur_time_ms < end_time) {
-    unified_frame.clear();
-    bool clear_hit_states = false;
+    const double *values = sensor->GetValues();
 
+    #ifdef VERBOSE_MODE
+      snprintf(buf, sizeof(buf), "... contains %d values ...",
+         sensor->get_num_values());
+      Log(stderr, DEBUG, buf);
+    #endif
 
-    // Wait for next sensor update
-    double wait_time_ms = (sampling_rate_ - (cur_time_ms - last_frame_time_ms));
-    if (wait_time_ms > 0) {
-      struct timespec wait_ts;
-      wait_ts.tv_sec = 0;
-      wait_ts.tv_nsec = wait_time_ms * 1000000;
-      nanosleep(&wait_ts, NULL);
+    for (int i = 0; i < sensor->get_num_values(); ++i) {
+      // double rand_factor = static_cast<double>(rand() % 10) / 1000. + 0.995;
+      double rand_factor = 1.;
+      unified_frame->push_back(values[i] * rand_factor);
     }
-    
-    clock_gettime(CLOCK_REALTIME, &time);
-    cur_time_ms = (time.tv_sec * 1000.) +
-                         (static_cast<double>(time.tv_nsec) / 1000000.);
-    last_frame_time_ms = cur_time_ms;
+  }
+}
 
-    #ifdef VERBOSE_MODE
-    // Retrieve latest sensor d
+bool RealtimeObserver::SensorsRunning() {
+  for (unsigned int i = 0; i < sensors_.size(); ++i) {
+    if (!sensors_[i]->running()) return false;
+  }
+  return true;
+}
+
+void *RealtimeObserver::CaptureLoop(void *arg) {
+  CaptureJob *capture = static_cast<CaptureJob *>(arg);
+  RealtimeObserver *observer = capture->observer_;
+  double period = observer->sampling_rate_;
+
+  vector<double> unified_frame;
+  unsigned int slot = 0;
+  double slot_time = capture->start_time_;
+  while (observer->is_observing_ && slot_time < capture->end_time_) {
+    // Sleep to each slot's absolute time, so slow captures don't drift
+    struct timespec wake_ts;
+    wake_ts.tv_sec = static_cast<time_t>(slot_time / 1000.);
+    wake_ts.tv_nsec = static_cast<long>(
+      (slot_time - wake_ts.tv_sec * 1000.) * 1000000.);
+    clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &wake_ts, NULL);
+
+    // A capture running late skips the slots it missed rather than
+    // bunching frames together
+    double cur_time_ms = GetTimeMillis();
+    unsigned int missed = static_cast<unsigned int>(
+      (cur_time_ms - slot_time) / period);
+    if (missed > 0) {
+      __sync_fetch_and_add(&observer->overrun_frames_, missed);
+      slot += missed;
+    }
+
+    observer->CaptureFrame(slot, &unified_frame);
+    if (!capture->ring_->Push(slot, cur_time_ms, unified_frame))
+      __sync_fetch_and_add(&observer->dropped_frames_, 1);
+
+    ++slot;
+    slot_time = capture->start_time_ + slot * period;
+  }
+
+  __sync_synchronize();
+  capture->done_ = true;
+  return NULL;
+}
+
+void RealtimeObserver::RecognizeFrame(FrameJob *job, bool parallel_scoring) {
+  // Frames dropped or skipped before this one stay unlabeled
+  if (timeline_.get_end_frame() < job->cur_frame_) {
+    unsigned int missing = job->cur_frame_ - timeline_.get_end_frame();
+    frames_.resize(frames_.size() + missing);
+    timeline_.AppendFrames(missing);
+  }
+  frames_.push_back(*job->unified_frame_);  // Store incoming frame d
+  timeline_.AppendFrames(1);
+  #ifdef VERBOSE_MODE
+    Log(stderr, DEBUG,
+        string("Done capturing frame. Beginning primitive loop").c_str());
+  #endif
+
+  // Score every primitive against this frame, then label the timeline in
+  // primitive order once all of them are done
+  vector<ObservablePrimitive *> &primitives = *job->primitives_;
+  vector<PrimitiveLabel> &labels = *job->labels_;
+  labels.assign(primitives.size(), PrimitiveLabel());
+  if (parallel_scoring)
+    worker_pool_->Run(&ScoreTask, job, primitives.size());
+  else
+    ScoreTask(job, 0, 0, primitives.size());
+
+  for (unsigned int i = 0; i < labels.size(); ++i) {
+    if (!labels[i].assigned_) continue;
+    timeline_.AddSegment(primitives[i]->label_id, labels[i].score_,
+                         labels[i].frame_start_, labels[i].frame_end_);
+  }
+
+  // Tell listeners now, before the next frame, rather than after Observe
+  for (unsigned int i = 0; i < labels.size() && !listeners_.empty(); ++i) {
+    if (!labels[i].assigned_) continue;
+    RecognitionEvent event;
+    event.primitive_ = primitives[i]->name;
+    event.score_ = labels[i].score_;
+    event.frame_start_ = labels[i].frame_start_;
+    event.frame_end_ = labels[i].frame_end_;
+    event.time_ms_ = job->cur_time_ms_ - job->start_time_;
+    event.match_score_a_ = labels[i].match_score_a_;
+    event.match_score_b_ = labels[i].match_score_b_;
+    event.match_score_c_ = labels[i].match_score_c_;
+    event.match_score_d_ = labels[i].match_score_d_;
+    event.match_score_e_ = labels[i].match_score_e_;
+    event.match_score_f_ = labels[i].match_score_f_;
+    NotifyListeners(event);
+  }
+
+  // Streaming, emit in batches so each sweep of the window finalizes
+  // about as many frames as it covers
+  if (sink_ != NULL && timeline_.size() >= 2 * stream_window_)
+    EmitFrames(timeline_.size() - stream_window_);
+}
+
+void RealtimeObserver::EmitFrames(unsigned int count) {
+  if (count > timeline_.size()) count = timeline_.size();
+  vector<unsigned int> labels;
+  vector<double> scores;
+  timeline_.GetBestLabelIds(&labels, &scores);
+  for (unsigned int i = 0; i < count; ++i) {
+    sink_->ReceiveFrame(timeline_.get_first_frame() + static_cast<int>(i),
+                        timeline_.get_label_name(labels[i]), scores[i]);
+  }
+  timeline_.DropFrames(count);
+  frames_.erase(frames_.begin(), frames_.begin() + count);
+}
+
+double RealtimeObserver::GetBaseReward(ObservablePrimitive *p,
+                                       State *source, State *target) {
+  return p->overlay.GetReward(source, target, Registry::LAYER_BASE);
+}
+
+double RealtimeObserver::GetTotalReward(ObservablePrimitive *p,
+                                        State *source, State *target) {
+  return p->overlay.GetTotalReward(source, target);
+}
+
+void RealtimeObserver::SetBaseReward(ObservablePrimitive *p, State *source,
+                                     State *target, double reward) const {
+  if (read_only_)
+    p->overlay.SetReward(source, target, Registry::LAYER_BASE, reward);
+  else
+    source->set_reward(target, Registry::LAYER_BASE, reward);
+}
+
+void RealtimeObserver::ScoreTask(void *arg, unsigned int worker,
+                                 unsigned int begin, unsigned int end) {
+  FrameJob *job = static_cast<FrameJob *>(arg);
+  for (unsigned int i = begin; i < end; ++i)
+    job->observer_->ScorePrimitive((*job->primitives_)[i], *job,
+                                   &(*job->labels_)[i]);
+}
+
+void RealtimeObserver::ScorePrimitive(ObservablePrimitive *p,
+                                      FrameJob const &frame,
+                                      PrimitiveLabel *label) {
+  FILE *log_stream = stderr;
+  double LEARNING_RATE = 0.2;
+  double DISCOUNT_FACTOR = 0.9;
+  const double WAYPOINT_PERCENTAGE = 85; // 0 - 100, % of hit_states to make wps
+  vector<double> const &unified_frame = *frame.unified_frame_;
+  double cur_time_ms = frame.cur_time_ms_;
+  double start_time = frame.start_time_;
+  int cur_frame = frame.cur_frame_;
+
+  QTable *qtable = p->q_learner->get_q_table();
+
+  #ifdef VERBOSE_MODE
     char buf[1024];
-    snprintf(buf, sizeof(buf), 
-            "Capturing Frame %d with %ld sensors...", cur_frame,
-             sensors_.size());
+     snprintf(buf, sizeof(buf), 
+              "Analyzing primitive %s with state count %ld",
+              p->name.c_str(), 
+              qtable->get_states().size());
     Log(log_stream, DEBUG, buf);
-    #endif
-    
-    unsigned int sens_iter;
-    for (sens_iter = 0; sens_iter < sensors_.size();
-         ++sens_iter) {
-      Sensor *sensor = sensors_[sens_iter];
-
-      const double *values = sensor->GetValues();
-
-      #ifdef VERBOSE_MODE
-        snprintf(buf, sizeof(buf), "... contains %d values ...",
-           sensor->get_num_values());
-        Log(log_stream, DEBUG, buf);
-      #endif
-      
-      for (int i = 0; i < sensor->get_num_values(); ++i) {
-        // double rand_factor = static_cast<double>(rand() % 10) / 1000. + 0.995;
-        double rand_factor = 1.;
-        unified_frame.push_back(values[i] * rand_factor);
-      }
-    }
+  #endif
 
-    frames_.push_back(unified_frame);  // Store incoming frame d
-    vector<pair<double, string> > timeline_entry;
-    timeline_entry.push_back(pair<double, string>(0.5, "Unknown"));
-    timeline_.push_back(timeline_entry);  // Add default guess
-    #ifdef VERBOSE_MODE
-      Log(log_stream, DEBUG,
-          string("Done capturing frame. Beginning primitive loop").c_str());
-    #endif
+  // @TODO Check for timeout status- if yes, then continue
+  //                                 if no, check if should be released
 
-    vector<ObservablePrimitive *>::iterator p_iter;
-    for (p_iter = primitives.begin(); p_iter != primitives.end();
-         ++p_iter) {
-      ObservablePrimitive *p = *p_iter;
+  // @TODO Make sure the beginning of p's hit_states starts within the
+  //       window of eligibility for it occurring.
+  //       (cut out states beginning earlier than (now - p->duration)
 
-      QTable *qtable = p->q_learner->get_q_table();
+  // Get current state from QTable with descriptor unified_frame
+  State input_frame(unified_frame);
 
-      #ifdef VERBOSE_MODE
-        char buf[1024];
-         snprintf(buf, sizeof(buf), 
-                  "Analyzing primitive %s with state count %ld",
-                  p->name.c_str(), 
-                  qtable->get_states().size());
-        Log(log_stream, DEBUG, buf);
-      #endif
+  // Read-only, the frame is matched to the closest known state rather than
+  // added as an estimated one
+  State *current_state = qtable->GetState(input_frame, !read_only_);
+  if (!current_state && read_only_)
+    current_state = qtable->GetNearestState(input_frame);
 
-      // @TODO Check for timeout status- if yes, then continue
-      //                                 if no, check if should be released
+  if (!current_state) {
+    Log(log_stream, ERROR, "QTable failed to add state");
+    return;
+  }
 
-      // @TODO Make sure the beginning of p's hit_states starts within the
-      //       window of eligibility for it occurring.
-      //       (cut out states beginning earlier than (now - p->duration)
+  // If p has current_state set, get reward going from old to new state
+  // if non-zero reward, then add state to hit_states for p
+  State *prev_state = p->current_state;
 
-      // Get current state from QTable with descriptor unified_frame
-      State input_frame(unified_frame);
+  if (prev_state == current_state) {
+    //Log(stderr, DEBUG, "Duplicate frame received in RealtimeObserver.");
+    return;
+  }
 
-      State *current_state = qtable->GetState(
-        input_frame, true);
+  p->current_state = current_state;
 
-      if (!current_state) {
-        Log(log_stream, ERROR, "QTable failed to add state");
-      }
 
-      // If p has current_state set, get reward going from old to new state
-      // if non-zero reward, then add state to hit_states for p
-      State *prev_state = p->current_state;
+  double transition_reward = 0.;
+  if (prev_state != NULL) {
+    transition_reward = GetTotalReward(p, prev_state, current_state);
+    #ifdef VERBOSE_MODE
+      int64 outbound_count = 0;
+      TransitionGraph::RewardLinkIterator outbound;
+      for (outbound = prev_state->RewardLinks(); outbound.valid();
+           ++outbound)
+        ++outbound_count;
+      char buf[1024];
+      snprintf(buf, sizeof(buf), "...State transition %d has reward %g. "
+              "Prev_state has %ld"
+              " outbound connections. Descriptor size %ld",
+              cur_frame, transition_reward,
+            outbound_count,
+            static_cast<int64>(prev_state->get_dimensions()));
+      Log(log_stream, DEBUG, string(
+        prev_state->to_string() + " to " + 
+        current_state->to_string()).c_str());
+    #endif
+  } else {
+    return;
+  }
 
-      if (prev_state == current_state) {
-        //Log(stderr, DEBUG, "Duplicate frame received in RealtimeObserver.");
-        continue;
-      }
+  if (transition_reward > 0.) {
+    p->hit_states.push_back(pair<double, State*>(
+      cur_time_ms, current_state));
+  } else if (transition_reward == 0.) {
+    // No transition exists yet between previous frame and this frame
 
-      p->current_state = current_state;
-
-
-      double transition_reward = 0.;
-      if (prev_state != NULL) {
-        transition_reward = prev_state->GetRewardValue(current_state,
-                                                       true, "");
-        #ifdef VERBOSE_MODE
-          char buf[1024];
-          snprintf(buf, sizeof(buf), "...State transition %d has reward %g. "
-                  "Prev_state has %ld"
-                  " outbound connections. Descriptor size %ld",
-                  cur_frame, transition_reward,
-                static_cast<int64>(prev_state->get_reward().size()),
-                static_cast<int64>(prev_state->get_state_vector().size()));
-          Log(log_stream, DEBUG, string(
-            prev_state->to_string() + " to " + 
-            current_state->to_string()).c_str());
-        #endif
-      } else {
-        continue;
-      }
+    // Log(log_stream, ERROR,
+    //    "...Zero reward transition on training data..?");
+    SetBaseReward(p, prev_state, current_state, -1);
+  }
 
-      if (transition_reward > 0.) {
-        p->hit_states.push_back(pair<double, State*>(
-          cur_time_ms, current_state));
-      } else if (transition_reward == 0.) {
-        // No transition exists yet between previous frame and this frame
+  // If duration represented by hit_states is greater than 50% of the
+  // anticipated duration of the primitive and number of frames in
+  // hit_states between hit_states' start and now is less than
+  // 75% * number of frames elapsed between hit_states' start and now
+  //  --> add p to the timeout pile
+  double hit_state_duration = 0.;
+  double first_hit_timestamp = 0.;
+  if (p->hit_states.size() > 1) {
+    first_hit_timestamp = p->hit_states[0].first;
+    hit_state_duration = p->hit_states[p->hit_states.size()-1].first
+                         - first_hit_timestamp;
+  }
 
-        // Log(log_stream, ERROR,
-        //    "...Zero reward transition on training data..?");
-        prev_state->set_reward(current_state, "base", -1);
-      }
 
-      // If duration represented by hit_states is greater than 50% of the
-      // anticipated duration of the primitive and number of frames in
-      // hit_states between hit_states' start and now is less than
-      // 75% * number of frames elapsed between hit_states' start and now
-      //  --> add p to the timeout pile
-      double hit_state_duration = 0.;
-      double first_hit_timestamp = 0.;
-      if (p->hit_states.size() > 1) {
-        first_hit_timestamp = p->hit_states[0].first;
-        hit_state_duration = p->hit_states[p->hit_states.size()-1].first
-                             - first_hit_timestamp;
-      }
+  // If hit_state_duration > acceptable duration, trim the start
+  while (hit_state_duration > p->duration_max_millis * 1.5) {
+    p->hit_states.pop_front();
 
+    first_hit_timestamp = p->hit_states[0].first;
+    hit_state_duration = p->hit_states[p->hit_states.size()-1].first
+                         - first_hit_timestamp;
+  }
 
-      // If hit_state_duration > acceptable duration, trim the start
-      while (hit_state_duration > p->duration_max_millis * 1.5) {
-        p->hit_states.pop_front();
 
-        first_hit_timestamp = p->hit_states[0].first;
-        hit_state_duration = p->hit_states[p->hit_states.size()-1].first
-                             - first_hit_timestamp;
+  // @TODO: Magic numbers need documenting/turned into const variables
+  if (hit_state_duration > .5 * p->duration_max_millis) {
+      if (first_hit_timestamp > 0.
+          && static_cast<double>(p->hit_states.size())
+             / ((cur_time_ms - first_hit_timestamp) / sampling_rate_)
+             < 0.5) {
+        // timed_out_primitives.push_back(
+        //  pair<double,ObservablePrimitive*>(
+        //    (cur_time_ms+p->duration_max_millis/3.),p));
+        char buf[1024];
+        snprintf(buf, sizeof(buf), "...Hit window too inaccurate (%g%%)",
+          (p->hit_states.size()
+             / ((cur_time_ms - first_hit_timestamp) / sampling_rate_)));
+        // Log(log_stream,ERROR,buf);
+        return;
       }
+  } else {
+    // Not close enough to the required duration
+    // to actually consider this skill yet
 
+    char buf[1024];
+    snprintf(buf, sizeof(buf),
+             "...Hit window too small %g (%g%%) to check for goal",
+      hit_state_duration, (hit_state_duration / p->duration_max_millis));
+    // Log(log_stream,ERROR,buf);
+    return;
+  }
 
-      // @TODO: Magic numbers need documenting/turned into const variables
-      if (hit_state_duration > .5 * p->duration_max_millis) {
-          if (first_hit_timestamp > 0.
-              && static_cast<double>(p->hit_states.size())
-                 / ((cur_time_ms - first_hit_timestamp) / sampling_rate_)
-                 < 0.5) {
-            // timed_out_primitives.push_back(
-            //  pair<double,ObservablePrimitive*>(
-            //    (cur_time_ms+p->duration_max_millis/3.),p));
-            char buf[1024];
-            snprintf(buf, sizeof(buf), "...Hit window too inaccurate (%g%%)",
-              (p->hit_states.size()
-                 / ((cur_time_ms - first_hit_timestamp) / sampling_rate_)));
-            // Log(log_stream,ERROR,buf);
-            continue;
-          }
-      } else {
-        // Not close enough to the required duration
-        // to actually consider this skill yet
+  // If current state is a trained goal state of p or near a trained goal
+  // state of p:
+  // Log(log_stream,DEBUG,"...Checking for goal!");
+  double distance_to_goal = 0.;
+  const double DISTANCE_FROM_GOAL_SENSITIVITY_MULTIPLIER = 10.;
+  if (p->q_learner->IsNearTrainedGoalState(*current_state, 
+                              DISTANCE_FROM_GOAL_SENSITIVITY_MULTIPLIER,
+                              distance_to_goal)) {
+   // Log(log_stream, DEBUG,
+   //  string("ZOMG Near goal state for " + p->name).c_str());
+
+    double anticipated_frames_elapsed = (
+      (cur_time_ms - first_hit_timestamp) / sampling_rate_);
+
+    // Calculate the max number of states to pass through before
+    // overshooting the max possible time for that primitive
+    double max_state_transitions = sampling_rate_
+      * p->q_learner->get_anticipated_duration() * 1.5;
+
+    double target_state_transitions = hit_state_duration / sampling_rate_;
+
+    double temp_reward = 0.;
+    int states_traversed = 0;
+
+
+    // Create a vector 'waypoints' of State* from within p's qlearner
+    // sampling from p->hit_states.
+    //    For each entry, if rand() < .75, add State* to 'waypoints'.
+    vector<State*> waypoints;
+    vector<State *>::iterator waypoint_iter;
+    deque<pair<double, State*> >::iterator hit_iter;
+    waypoints.push_back(p->hit_states[0].second);
+    for (hit_iter = p->hit_states.begin()+1;
+         hit_iter != p->hit_states.end();
+         ++hit_iter) {
+      int r_val = rand_r(&p->rng_seed) % 100;
+
+      if (r_val < WAYPOINT_PERCENTAGE)
+        waypoints.push_back(hit_iter->second);
+    }
 
+
+    // Set p->QLearner's current_state to the first hit_state in the window
+
+    // Add layer "waypoint" onto all transitions into States in 'waypoints'
+    // to artificially increase the reward for paths through that state
+    for (waypoint_iter = waypoints.begin();
+         waypoint_iter != waypoints.end();
+         ++waypoint_iter) {
+      p->overlay.SetTargetReward(*waypoint_iter, Registry::LAYER_WAYPOINT,
+                                 150.);
+    }
+
+    // Calculate C:
+    // Follow a greedy path through the training data,
+    // only loosely following the received data. This can be though
+    // of as an "optimized" path, given the data seen.
+    // Store summed base_reward values in 'C'
+    double match_score_c = 0.;
+    vector<State *> optimal_path;
+    State *optimal_path_state;
+    State *optimal_path_next_state = NULL;
+    states_traversed = 0;
+    double optimal_path_score = 0.;
+
+    optimal_path_state = p->hit_states[0].second;
+    optimal_path.push_back(optimal_path_state);
+    while (states_traversed < anticipated_frames_elapsed) {
+      temp_reward = 0.;
+      bool success = p->q_learner->GetNextState(optimal_path_state,
+                                                &optimal_path_next_state,
+                                                temp_reward,
+                                                &p->overlay);
+
+      if (!success) {
         char buf[1024];
         snprintf(buf, sizeof(buf),
-                 "...Hit window too small %g (%g%%) to check for goal",
-          hit_state_duration, (hit_state_duration / p->duration_max_millis));
-        // Log(log_stream,ERROR,buf);
-        continue;
+                "Failed optimized state traversal on primitive %s"
+                " after %ld steps",
+                p->name.c_str(),
+                static_cast<int64>(optimal_path.size()));
+        Log(stderr, ERROR, buf);
+        break;
       }
 
-      // If current state is a trained goal state of p or near a trained goal
-      // state of p:
-      // Log(log_stream,DEBUG,"...Checking for goal!");
-      double distance_to_goal = 0.;
-      const double DISTANCE_FROM_GOAL_SENSITIVITY_MULTIPLIER = 10.;
-      if (p->q_learner->IsNearTrainedGoalState(*current_state, 
-                                  DISTANCE_FROM_GOAL_SENSITIVITY_MULTIPLIER,
-                                  distance_to_goal)) {
-       // Log(log_stream, DEBUG,
-       //  string("ZOMG Near goal state for " + p->name).c_str());
-
-        double anticipated_frames_elapsed = (
-          (cur_time_ms - first_hit_timestamp) / sampling_rate_);
-
-        // Calculate the max number of states to pass through before
-        // overshooting the max possible time for that primitive
-        double max_state_transitions = sampling_rate_
-          * p->q_learner->get_anticipated_duration() * 1.5;
-
-        double target_state_transitions = hit_state_duration / sampling_rate_;
-
-        double temp_reward = 0.;
-        int states_traversed = 0;
-
-
-        // Create a vector 'waypoints' of State* from within p's qlearner
-        // sampling from p->hit_states.
-        //    For each entry, if rand() < .75, add State* to 'waypoints'.
-        vector<State*> waypoints;
-        vector<State *>::iterator waypoint_iter;
-        deque<pair<double, State*> >::iterator hit_iter;
-        waypoints.push_back(p->hit_states[0].second);
-        for (hit_iter = p->hit_states.begin()+1;
-             hit_iter != p->hit_states.end();
-             ++hit_iter) {
-          int r_val = rand() % 100;
-
-          if (r_val < WAYPOINT_PERCENTAGE)
-            waypoints.push_back(hit_iter->second);
-        }
+      double transition_reward = GetBaseReward(p, optimal_path_state,
+                                               optimal_path_next_state);
+
+      double best_transition_from_next_state = 0.;
+      TransitionGraph::RewardLinkIterator future_reward;
+      for (future_reward = optimal_path_next_state->RewardLinks();
+           future_reward.valid();
+           ++future_reward) {
+            double reward = GetBaseReward(p, optimal_path_next_state,
+                                          future_reward.target());
+            if (reward > best_transition_from_next_state)
+              best_transition_from_next_state = reward;
+      }
 
+      optimal_path_score += transition_reward;
 
-        // Set p->QLearner's current_state to the first hit_state in the window
-
-        // Add layer "waypoint" onto all transitions into States in 'waypoints'
-        // to artificially increase the reward for paths through that state
-        for (waypoint_iter = waypoints.begin();
-             waypoint_iter != waypoints.end();
-             ++waypoint_iter) {
-          State *s = *waypoint_iter;
-          vector<State *> &incoming_states = s->get_incoming_states();
-          if (incoming_states.size() == 0) continue;
-          vector<State *>::iterator inc_iter;
-          for (inc_iter = incoming_states.begin();
-               inc_iter != incoming_states.end();
-               ++inc_iter) {
-            State *inc_state = *inc_iter;
-            if (!inc_state)
-              Log(stderr, ERROR, "NULL State to be WP'd?");
-            if (inc_state != s)
-              inc_state->set_reward(s, string("waypoint"), 150.);
-          }
-        }
+      optimal_path_state = optimal_path_next_state;
+      optimal_path.push_back(optimal_path_state);
 
-        // Calculate C:
-        // Follow a greedy path through the training data,
-        // only loosely following the received data. This can be though
-        // of as an "optimized" path, given the data seen.
-        // Store summed base_reward values in 'C'
-        double match_score_c = 0.;
-        vector<State *> optimal_path;
-        State *optimal_path_state;
-        State *optimal_path_next_state = NULL;
-        states_traversed = 0;
-        double optimal_path_score = 0.;
-
-        optimal_path_state = p->hit_states[0].second;
-        optimal_path.push_back(optimal_path_state);
-        while (states_traversed < anticipated_frames_elapsed) {
-          temp_reward = 0.;
-          bool success = p->q_learner->GetNextState(optimal_path_state,
-                                                    &optimal_path_next_state,
-                                                    temp_reward);
-
-          if (!success) {
-            char buf[1024];
-            snprintf(buf, sizeof(buf),
-                    "Failed optimized state traversal on primitive %s"
-                    " after %ld steps",
-                    p->name.c_str(),
-                    static_cast<int64>(optimal_path.size()));
-            Log(stderr, ERROR, buf);
-            break;
-          }
-
-          double transition_reward = optimal_path_state->GetRewardValue(
-                                  optimal_path_next_state, false, "base");
-
-          double best_transition_from_next_state = 0.;
-          map<State*, map<string, double> > const &next_state_rewards =
-            optimal_path_next_state->get_reward();
-          map<State*, std::map<std::string, double> >::const_iterator
-            future_reward;
-
-          for (future_reward = next_state_rewards.begin();
-               future_reward != next_state_rewards.end();
-               ++future_reward) {
-                double reward = optimal_path_next_state->GetRewardValue(
-                                future_reward->first, false, "base");
-                if (reward > best_transition_from_next_state)
-                  best_transition_from_next_state = reward;
-          }
-
-          optimal_path_score += transition_reward;
-
-          optimal_path_state = optimal_path_next_state;
-          optimal_path.push_back(optimal_path_state);
-
-          optimal_path_next_state = NULL;
-          ++states_traversed;
-
-          char buf[1024];
-          snprintf(buf, sizeof(buf), "Chose transition with value %g,"
-            " real value %g",
-            temp_reward, transition_reward);
-          // Log(stderr, DEBUG, buf);
-
-
-          double temp_dbl = 0.;
-          if (states_traversed > anticipated_frames_elapsed/4. &&
-              p->q_learner->IsNearTrainedGoalState(*optimal_path_state, .25,
-                                               temp_dbl)) {
-            break;
-          }
-
-          // Transition update rule
-          vector<State *> &inc_states =
-                optimal_path_state->get_incoming_states();
-
-          for (unsigned int i = 0; i < inc_states.size(); ++i) {
-              State *inc_state = inc_states[i];
-              double reward_to_cur_state = inc_state->GetRewardValue(
-                                           optimal_path_state, false, "base");
-              reward_to_cur_state = (1.-LEARNING_RATE)*reward_to_cur_state
-                + LEARNING_RATE * (transition_reward  + DISCOUNT_FACTOR
-                * best_transition_from_next_state - reward_to_cur_state);
-              inc_state->set_reward(optimal_path_state,
-                                    string("base"),
-                                    reward_to_cur_state);
-          }
+      optimal_path_next_state = NULL;
+      ++states_traversed;
 
-        }
+      char buf[1024];
+      snprintf(buf, sizeof(buf), "Chose transition with value %g,"
+        " real value %g",
+        temp_reward, transition_reward);
+      // Log(stderr, DEBUG, buf);
 
-        if (optimal_path.size() == 0) continue;
-        match_score_c = (optimal_path_score)
-                        / static_cast<double>(optimal_path.size()-1);
-
-
-        // Remove layer "waypoint" from transitions into States in 'waypoints'
-        for (waypoint_iter = waypoints.begin();
-             waypoint_iter != waypoints.end();
-             ++waypoint_iter) {
-          State *s = *waypoint_iter;
-          vector<State *> &incoming_states = s->get_incoming_states();
-          vector<State *>::iterator inc_iter;
-          for (inc_iter = incoming_states.begin();
-               inc_iter != incoming_states.end();
-               ++inc_iter) {
-            State *inc_state = *inc_iter;
-            inc_state->set_reward(s, "waypoint", 0.);
-          }
-        }
 
-        // Create a vector 'waypoints' of State* from within p's qlearner
-        // sampling from p->hit_states.
-        // Add every point as WP to overcome possible '-1' transitions
-        waypoints.clear();
-        for (hit_iter = p->hit_states.begin();
-             hit_iter != p->hit_states.end();
-             ++hit_iter) {
-          waypoints.push_back(hit_iter->second);
-        }
+      double temp_dbl = 0.;
+      if (states_traversed > anticipated_frames_elapsed/4. &&
+          p->q_learner->IsNearTrainedGoalState(*optimal_path_state, .25,
+                                           temp_dbl)) {
+        break;
+      }
 
+      // Transition update rule
+      TransitionGraph::IncomingLinkIterator inc_iter;
+      for (inc_iter = optimal_path_state->IncomingLinks();
+           inc_iter.valid(); ++inc_iter) {
+          State *inc_state = inc_iter.source();
+          double reward_to_cur_state = GetBaseReward(p, inc_state,
+                                                     optimal_path_state);
+          reward_to_cur_state = (1.-LEARNING_RATE)*reward_to_cur_state
+            + LEARNING_RATE * (transition_reward  + DISCOUNT_FACTOR
+            * best_transition_from_next_state - reward_to_cur_state);
+          SetBaseReward(p, inc_state, optimal_path_state,
+                        reward_to_cur_state);
+      }
 
-        // Set p->QLearner's current_state to the first hit_state in the window
-        // Add layer "waypoint" onto all transitions into States in 'waypoints'
-        // to artificially increase the reward for paths through that state
-        for (waypoint_iter = waypoints.begin();
-             waypoint_iter != waypoints.end();
-             ++waypoint_iter) {
-          State *s = *waypoint_iter;
-          vector<State *> &incoming_states = s->get_incoming_states();
-          if (incoming_states.size() == 0) continue;
-          vector<State *>::iterator inc_iter;
-          for (inc_iter = incoming_states.begin();
-               inc_iter != incoming_states.end();
-               ++inc_iter) {
-            State *inc_state = *inc_iter;
-            if (!inc_state)
-              Log(stderr, ERROR, "NULL State to be WP'd?");
-            if (inc_state != s)
-              inc_state->set_reward(s, string("waypoint"), 150.);
-          }
-        }
+    }
 
-        // Calculate B:
-        // Follow a greedy path through the QLearner, summing the base reward
-        // values as you go (ignoring waypoint layer). This is the "actual" 
-        // path through the state space that was observed
-        // Store summed base_reward values in match score 'B'
-        double match_score_b = 0.;
-        vector<State *> observed_path;
-        vector<State *>::iterator observed_path_iter;
-        State *wp_path_state = p->hit_states[0].second;  // start at first hi
-        State *wp_path_next_state = NULL;
-        states_traversed = 0.;
-        temp_reward = 0.;
-        observed_path.push_back(wp_path_state);
-        while (states_traversed < max_state_transitions
-               && states_traversed < target_state_transitions) {
-          bool success = p->q_learner->GetNextState(wp_path_state,
-                                                    &wp_path_next_state,
-                                                    temp_reward);
-          if (!success) {
-            // Shouldn't run into this case... maybe errorlog message here
-            char buf[1024];
-            snprintf(buf, sizeof(buf), "Failed state traversal on primitive %s"
-                " after %ld steps.",
-                p->name.c_str(),
-                static_cast<int64>(observed_path.size()));
-            Log(stderr, ERROR, buf);
-            break;
-          }
-
-
-          wp_path_state = wp_path_next_state;
-          observed_path.push_back(wp_path_state);
-          wp_path_next_state = NULL;
-          ++states_traversed;
-
-          double temp_dbl = 0.;
-          if (states_traversed > anticipated_frames_elapsed/4. &&          
-              p->q_learner->IsNearTrainedGoalState(*wp_path_state, .25,
-                                                   temp_dbl))
-            break;
-        }
+    if (optimal_path.size() == 0) {
+      p->overlay.ClearTargetRewards();
+      return;
+    }
+    match_score_c = (optimal_path_score)
+                    / static_cast<double>(optimal_path.size()-1);
 
-        double wp_path_score = 0.;
-        wp_path_state = *(observed_path.begin());
-        for (observed_path_iter = observed_path.begin()+1;
-             observed_path_iter != observed_path.end();
-             ++observed_path_iter) {
-          State *next = (*observed_path_iter);
 
-          wp_path_score += wp_path_state->GetRewardValue(next, false, "base");
-          wp_path_state = next;
-        }
+    // Remove layer "waypoint" from transitions into States in 'waypoints'
+    p->overlay.ClearTargetRewards();
 
-        if (observed_path.size() == 0) 
-          match_score_b = 0.;
-        else
-          match_score_b = (wp_path_score)
-                          / static_cast<double>(observed_path.size()-1);
-
-
-        // Remove layer "waypoint" from transitions into States in 'waypoints'
-        for (waypoint_iter = waypoints.begin();
-             waypoint_iter != waypoints.end();
-             ++waypoint_iter) {
-          State *s = *waypoint_iter;
-          vector<State *> &incoming_states = s->get_incoming_states();
-          vector<State *>::iterator inc_iter;
-          for (inc_iter = incoming_states.begin();
-               inc_iter != incoming_states.end();
-               ++inc_iter) {
-            State *inc_state = *inc_iter;
-            inc_state->set_reward(s, "waypoint", 0.);
-          }
-        }
+    // Create a vector 'waypoints' of State* from within p's qlearner
+    // sampling from p->hit_states.
+    // Add every point as WP to overcome possible '-1' transitions
+    waypoints.clear();
+    for (hit_iter = p->hit_states.begin();
+         hit_iter != p->hit_states.end();
+         ++hit_iter) {
+      waypoints.push_back(hit_iter->second);
+    }
 
-        // Calculate A:
-        // Over the time window covered by the observed path
-        // Calculate # good states / how many frames have elapsed, store in 'A'
-        double match_score_a = 1 -
-          (fabs(observed_path.size() - anticipated_frames_elapsed))
-          / anticipated_frames_elapsed;
-
-
-        // Calculate D:
-        // Calculate duration elapsed by WP'd calculated trajectory, assuming
-        //   one state per frame of input
-        double match_score_d = sampling_rate_
-          * static_cast<double>(optimal_path.size());
-
-        // Calculate E:
-        // Calculate duration of expected time to completion
-        double match_score_e = p->q_learner->get_anticipated_duration();
-
-        double match_distance_d_e = 1
-            - (fabs(match_score_d - match_score_e) / match_score_e);
-
-        // Calculate F:
-        // Calculate best possible per-state score for gesture
-        double match_score_f = 100.;
-
-        // Calculate confidence score for label:
-        // score = A * 0.2 + [B/C] * .7 + [D/E] * 0.1
-        double final_score = 0.;
-
-        if (use_waypointing_) {
-          final_score =  match_score_a * 0.25;
-          final_score += (match_score_b/100.) * 0.40;
-          if (match_score_b/match_score_c > 1.)
-            final_score += 0.2;
-          else
-            final_score += (match_score_b/match_score_c) * 0.20;
-            final_score += match_distance_d_e  * 0.15;
-
-          if (match_score_a < 0.75) final_score *= 0.8;
-          if (match_score_b < 75.) final_score *= 0.8;
-          if (match_score_c < 75.) final_score *= 0.8;
-          if (match_score_b - 10. > match_score_c) final_score *= 0.8;
-          if (match_distance_d_e < .80) final_score *= 0.8;
-        } else {
-          final_score =  match_score_a * 0.3
-                           + (match_score_b/100.) * 0.70;
-
-          if (match_score_a < .75) final_score *= 0.8;
-          if (match_score_b < 75.) final_score *= 0.8;
-        }
 
-        // For all frames covered from first_hit_timestamp to now, apply label
-        // pair: < score, p->name
-
-        // Figure out which frame to start with:
-        //    offset from start / (frames/sec)
-        int frame_start = static_cast<int>((first_hit_timestamp - start_time)
-                                            / sampling_rate_);
-        int frame_end = cur_frame;
-
-        char scorebuf[4096];
-        snprintf(scorebuf, sizeof(scorebuf), "Assigning Label: (%s, %g)"
-          " from frame %d to %d"
-          " scores: %g, %g, %g, %g, %g, %g, %g",
-          p->name.c_str(), final_score, frame_start, frame_end,
-          match_score_a, match_score_b, match_score_c, match_score_d,
-          match_score_e,
-          match_distance_d_e,
-          match_score_f);
-        Log(stderr, DEBUG, scorebuf);
-
-        pair<double, string> label(final_score, p->name);
-        for (int i = frame_start; i <= frame_end; ++i) {
-          timeline_[i].push_back(label);
-        }
+    // Set p->QLearner's current_state to the first hit_state in the window
+    // Add layer "waypoint" onto all transitions into States in 'waypoints'
+    // to artificially increase the reward for paths through that state
+    for (waypoint_iter = waypoints.begin();
+         waypoint_iter != waypoints.end();
+         ++waypoint_iter) {
+      p->overlay.SetTargetReward(*waypoint_iter, Registry::LAYER_WAYPOINT,
+                                 150.);
+    }
 
-        if (final_score > .90) {
-          // clear_hit_states = true;
-          for (unsigned int hidx = 0; hidx < p->hit_states.size(); ++hidx) {
-            State *s  = p->hit_states[hidx].second;
-            // Transition update rule
-            vector<State *> &inc_states = s->get_incoming_states();
-            for (unsigned int i = 0; i < inc_states.size(); ++i) {
-                State *inc_state = inc_states[i];
-                double reward_to_cur_state = inc_state->GetRewardValue(
-                                                        s, false, "base");
-                reward_to_cur_state += 25. * LEARNING_RATE;
-                reward_to_cur_state = std::min(100., reward_to_cur_state);
-                inc_state->set_reward(s, string("base"), reward_to_cur_state);
-            }
-          }
-
-
-          unsigned int h_sz = static_cast<int>(
-                                static_cast<double>(p->hit_states.size()) 
-                                * 3. / 4.);
-          while (--h_sz > 0)
-            p->hit_states.pop_front();
-        }
+    // Calculate B:
+    // Follow a greedy path through the QLearner, summing the base reward
+    // values as you go (ignoring waypoint layer). This is the "actual" 
+    // path through the state space that was observed
+    // Store summed base_reward values in match score 'B'
+    double match_score_b = 0.;
+    vector<State *> observed_path;
+    vector<State *>::iterator observed_path_iter;
+    State *wp_path_state = p->hit_states[0].second;  // start at first hi
+    State *wp_path_next_state = NULL;
+    states_traversed = 0.;
+    temp_reward = 0.;
+    observed_path.push_back(wp_path_state);
+    while (states_traversed < max_state_transitions
+           && states_traversed < target_state_transitions) {
+      bool success = p->q_learner->GetNextState(wp_path_state,
+                                                &wp_path_next_state,
+                                                temp_reward,
+                                                &p->overlay);
+      if (!success) {
+        // Shouldn't run into this case... maybe errorlog message here
+        char buf[1024];
+        snprintf(buf, sizeof(buf), "Failed state traversal on primitive %s"
+            " after %ld steps.",
+            p->name.c_str(),
+            static_cast<int64>(observed_path.size()));
+        Log(stderr, ERROR, buf);
+        break;
       }
+
+
+      wp_path_state = wp_path_next_state;
+      observed_path.push_back(wp_path_state);
+      wp_path_next_state = NULL;
+      ++states_traversed;
+
+      double temp_dbl = 0.;
+      if (states_traversed > anticipated_frames_elapsed/4. &&          
+          p->q_learner->IsNearTrainedGoalState(*wp_path_state, .25,
+                                               temp_dbl))
+        break;
     }
 
-    if (clear_hit_states) {
-      for (p_iter = primitives.begin(); p_iter != primitives.end();
-         ++p_iter) {
-        ObservablePrimitive *p = *p_iter;
-        p->hit_states.clear();
-      }
+    double wp_path_score = 0.;
+    wp_path_state = *(observed_path.begin());
+    for (observed_path_iter = observed_path.begin()+1;
+         observed_path_iter != observed_path.end();
+         ++observed_path_iter) {
+      State *next = (*observed_path_iter);
+
+      wp_path_score += GetBaseReward(p, wp_path_state, next);
+      wp_path_state = next;
     }
-    clear_hit_states = false;
 
-    ++cur_frame;
-  }
+    if (observed_path.size() == 0) 
+      match_score_b = 0.;
+    else
+      match_score_b = (wp_path_score)
+                      / static_cast<double>(observed_path.size()-1);
+
+
+    // Remove layer "waypoint" from transitions into States in 'waypoints'
+    p->overlay.ClearTargetRewards();
+
+    // Calculate A:
+    // Over the time window covered by the observed path
+    // Calculate # good states / how many frames have elapsed, store in 'A'
+    double match_score_a = 1 -
+      (fabs(observed_path.size() - anticipated_frames_elapsed))
+      / anticipated_frames_elapsed;
+
+
+    // Calculate D:
+    // Calculate duration elapsed by WP'd calculated trajectory, assuming
+    //   one state per frame of input
+    double match_score_d = sampling_rate_
+      * static_cast<double>(optimal_path.size());
+
+    // Calculate E:
+    // Calculate duration of expected time to completion
+    double match_score_e = p->q_learner->get_anticipated_duration();
+
+    double match_distance_d_e = 1
+        - (fabs(match_score_d - match_score_e) / match_score_e);
+
+    // Calculate F:
+    // Calculate best possible per-state score for gesture
+    double match_score_f = 100.;
+
+    // Calculate confidence score for label:
+    // score = A * 0.2 + [B/C] * .7 + [D/E] * 0.1
+    double final_score = 0.;
+
+    if (use_waypointing_) {
+      final_score =  match_score_a * 0.25;
+      final_score += (match_score_b/100.) * 0.40;
+      if (match_score_b/match_score_c > 1.)
+        final_score += 0.2;
+      else
+        final_score += (match_score_b/match_score_c) * 0.20;
+        final_score += match_distance_d_e  * 0.15;
+
+      if (match_score_a < 0.75) final_score *= 0.8;
+      if (match_score_b < 75.) final_score *= 0.8;
+      if (match_score_c < 75.) final_score *= 0.8;
+      if (match_score_b - 10. > match_score_c) final_score *= 0.8;
+      if (match_distance_d_e < .80) final_score *= 0.8;
+    } else {
+      final_score =  match_score_a * 0.3
+                       + (match_score_b/100.) * 0.70;
+
+      if (match_score_a < .75) final_score *= 0.8;
+      if (match_score_b < 75.) final_score *= 0.8;
+    }
 
-  vector<ObservablePrimitive *>::iterator op_iter;
-  for (op_iter = primitives.begin(); op_iter != primitives.end();
-     ++op_iter) {
-    ObservablePrimitive *p = *op_iter;
-    delete p;
-    p = NULL;
-  }
+    // For all frames covered from first_hit_timestamp to now, apply label
+    // pair: < score, p->name
+
+    // Figure out which frame to start with:
+    //    offset from start / (frames/sec)
+    int frame_start = static_cast<int>((first_hit_timestamp - start_time)
+                                        / sampling_rate_);
+    int frame_end = cur_frame;
+
+    char scorebuf[4096];
+    snprintf(scorebuf, sizeof(scorebuf), "Assigning Label: (%s, %g)"
+      " from frame %d to %d"
+      " scores: %g, %g, %g, %g, %g, %g, %g",
+      p->name.c_str(), final_score, frame_start, frame_end,
+      match_score_a, match_score_b, match_score_c, match_score_d,
+      match_score_e,
+      match_distance_d_e,
+      match_score_f);
+    Log(stderr, DEBUG, scorebuf);
+
+    label->assigned_ = true;
+    label->score_ = final_score;
+    label->frame_start_ = frame_start;
+    label->frame_end_ = frame_end;
+    label->match_score_a_ = match_score_a;
+    label->match_score_b_ = match_score_b;
+    label->match_score_c_ = match_score_c;
+    label->match_score_d_ = match_score_d;
+    label->match_score_e_ = match_score_e;
+    label->match_score_f_ = match_score_f;
+
+    if (final_score > .90) {
+      // clear_hit_states = true;
+      for (unsigned int hidx = 0; hidx < p->hit_states.size(); ++hidx) {
+        State *s  = p->hit_states[hidx].second;
+        // Transition update rule
+        TransitionGraph::IncomingLinkIterator inc_iter;
+        for (inc_iter = s->IncomingLinks(); inc_iter.valid(); ++inc_iter) {
+            State *inc_state = inc_iter.source();
+            double reward_to_cur_state = GetBaseReward(p, inc_state, s);
+            reward_to_cur_state += 25. * LEARNING_RATE;
+            reward_to_cur_state = std::min(100., reward_to_cur_state);
+            SetBaseReward(p, inc_state, s, reward_to_cur_state);
+        }
+      }
 
-  return true;
+
+      unsigned int h_sz = static_cast<int>(
+                            static_cast<double>(p->hit_states.size()) 
+                            * 3. / 4.);
+      while (--h_sz > 0)
+        p->hit_states.pop_front();
+    }
+  }
 }
 
 bool RealtimeObserver::StopObserving() {
@@ -677,7 +877,7 @@ bool RealtimeObserver::StopObserving() {
 
 
 void RealtimeObserver::reset() {
-  timeline_.clear();
+  timeline_.Clear();
 }
 
 /**
@@ -687,25 +887,7 @@ void RealtimeObserver::reset() {
  **/
 vector<string> RealtimeObserver::GetFinalTimeline() {
   vector<string> best_timeline;
-  vector<vector<pair<double, string> > >::iterator frame_iter;
-  vector<pair<double, string> >::iterator label_iter;
-
-  for (frame_iter = timeline_.begin(); frame_iter != timeline_.end();
-       ++frame_iter) {
-    vector<pair<double, string> > &labels = (*frame_iter);
-    pair<double, string> *best_guess = NULL;
-    for (label_iter = labels.begin(); label_iter != labels.end();
-         ++label_iter) {
-      if (best_guess == NULL) {
-        best_guess = &(*label_iter);
-      } else {
-        if ((*label_iter).first > best_guess->first)
-          best_guess = &(*label_iter);
-      }
-    }
-    best_timeline.push_back(best_guess->second);
-  }
-
+  timeline_.GetBestLabels(&best_timeline);
   return best_timeline;
 }
 
@@ -716,22 +898,27 @@ vector<string> RealtimeObserver::GetFinalTimeline() {
  **/
 vector<map<string, double> > RealtimeObserver::GetPrimitivePerformanceTimeline(
   void) {
-  //  vector<vector<pair<double, string> > > timeline_;
-  vector<map<string, double> > result;
+  vector<map<string, double> > result(timeline_.size());
 
-  for (unsigned int i = 0; i < timeline_.size(); ++i) {
-    map<string, double> frame_result;
-    for (unsigned int j = 0; j < primitives_.size(); ++j) {
-      frame_result[primitives_[j]->get_name()] = 0.;
-    }
+  // Every primitive gets a score in every frame, and any other label (such
+  // as "Unknown") in the frames where it scores above 0
+  vector<bool> is_primitive(timeline_.get_label_count(), false);
+  for (unsigned int j = 0; j < primitives_.size(); ++j) {
+    string const &name = primitives_[j]->get_name();
+    unsigned int label;
+    if (timeline_.FindLabel(name, &label)) is_primitive[label] = true;
+    for (unsigned int i = 0; i < result.size(); ++i) result[i][name] = 0.;
+  }
 
-    vector<pair<double, string> > &labels = timeline_[i];
-    for (unsigned int j = 0; j < labels.size(); ++j) {
-      if (labels[j].first > frame_result[labels[j].second])
-        frame_result[labels[j].second] = labels[j].first;
+  vector<double> scores;
+  for (unsigned int label = 0; label < is_primitive.size(); ++label) {
+    if (!is_primitive[label] && !timeline_.HasSegments(label)) continue;
+    string const &name = timeline_.get_label_name(label);
+    timeline_.GetBestScores(label, &scores);
+    for (unsigned int i = 0; i < result.size(); ++i) {
+      if (is_primitive[label] || scores[i] > 0.)
+        result[i][name] = scores[i];
     }
-
-    result.push_back(frame_result);
   }
   return result;
 }
@@ -743,27 +930,16 @@ vector<map<string, double> > RealtimeObserver::GetPrimitivePerformanceTimeline(
  **/
 map<string, vector<double> >
   RealtimeObserver::GetPrimitiveCentricPerformanceTimeline(void) {
-  //  vector<vector<pair<double, string> > > timeline_;
   map<string, vector<double> > result;
 
   for (unsigned int j = 0; j < primitives_.size(); ++j) {
-    vector<double> confidences;
-
-    for (unsigned int i = 0; i < timeline_.size(); ++i) {
-      vector<pair<double, string> > &labels = timeline_[i];
-      double best_score = 0.;
-
-      for (unsigned int k = 0; k < labels.size(); ++k) {
-        if (labels[k].first > best_score
-            && !strcmp(labels[k].second.c_str(),
-                       primitives_[j]->get_name().c_str()))
-          best_score = labels[k].first;
-      }
-
-      confidences.push_back(best_score);
-    }
-
-    result[primitives_[j]->get_name()] = confidences;
+    string const &name = primitives_[j]->get_name();
+    unsigned int label;
+    vector<double> &confidences = result[name];
+    if (timeline_.FindLabel(name, &label))
+      timeline_.GetBestScores(label, &confidences);
+    else
+      confidences.assign(timeline_.size(), 0.);
   }
 
   return result;
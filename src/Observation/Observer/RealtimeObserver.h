@@ -13,19 +13,27 @@
 #define _SHL_OBSERVATION_OBSERVER_REALTIMEOBSERVER_H_
 
 
+#include <cstdlib>
 #include <vector>
 #include <deque>
 #include <string>
 #include <utility>
 #include <map>
+#include "Observer/LabelTimeline.h"
 #include "Observer/Observer.h"
 #include "Observer/Task.h"
+#include "Observer/TimelineSink.h"
 #include "Primitives/QLearner/QLearner.h"
+#include "Primitives/QLearner/RewardOverlay.h"
 #include "Primitives/Student/Sensor.h"
 #include "Primitives/QLearner/State.h"
 
+class WorkerPool;
+
 namespace Observation {
 
+class FrameRing;
+
 using std::vector;
 using std::map;
 using std::string;
@@ -33,12 +41,17 @@ using std::pair;
 using std::deque;
 using Primitives::QLearner;
 using Primitives::Sensor;
+using Primitives::RewardOverlay;
 using Primitives::State;
 
 class RealtimeObserver : public Observer {
  public:
   explicit RealtimeObserver(double sampling_rate_hz) :  use_waypointing_(true),
-      is_observing_(false), duration_(0.), sampling_rate_(sampling_rate_hz) {}
+      is_observing_(false), duration_(0.), sampling_rate_(sampling_rate_hz),
+      worker_pool_(NULL), ring_capacity_(0), dropped_frames_(0),
+      overrun_frames_(0), offline_(false), read_only_(false), sink_(NULL),
+      stream_window_(0) {}
+  ~RealtimeObserver();
 
   bool Observe(Task* task, double duration);
   bool Observe(Task* task);
@@ -55,15 +68,97 @@ class RealtimeObserver : public Observer {
   vector<map<string, double> > GetPrimitivePerformanceTimeline(void);
   map<string, vector<double> > GetPrimitiveCentricPerformanceTimeline(void);
 
-  vector<vector<pair<double, string> > > &get_timeline() {
-    return timeline_;
-  }
+  /**
+   * @return Labels recognized during the last observation, one segment per
+   *         detection
+   **/
+  LabelTimeline const &get_timeline() const { return timeline_; }
+
+  /**
+   * Sets how many threads score the primitives against each frame.  Each
+   * frame's scores are joined before the timeline is labeled, in primitive
+   * order, so the timeline doesn't depend on the thread count.
+   *
+   * @param workers Threads including the observing one; 1 (the default)
+   *                scores sequentially, 0 uses one per online processor
+   **/
+  void set_scoring_workers(unsigned int workers);
+  unsigned int get_scoring_workers() const;
+
+  /**
+   * Moves sensor capture onto its own thread, which samples on a fixed
+   * schedule and queues timestamped frames for recognition in a ring, so
+   * slow recognition delays labels rather than frames.
+   *
+   * @param capacity Frames the ring holds; 0 (the default) captures and
+   *                 recognizes in turn on the observing thread
+   **/
+  void set_capture_ring(unsigned int capacity) { ring_capacity_ = capacity; }
+  unsigned int get_capture_ring() const { return ring_capacity_; }
+
+  /**
+   * @return Frames captured during the last observation that recognition
+   *         fell too far behind to queue
+   **/
+  unsigned int get_dropped_frames() const { return dropped_frames_; }
+
+  /**
+   * @return Sampling periods missed during the last observation because
+   *         the previous capture (or, without a ring, recognition) ran late
+   **/
+  unsigned int get_overrun_frames() const { return overrun_frames_; }
+
+  /**
+   * Switches observation to virtual time for recorded input.  Offline, no
+   * frame waits on the clock: each is taken as soon as the last has been
+   * recognized and stamped one sampling period later, starting from 0.
+   * Observation ends when a sensor stops running (e.g. a recording plays
+   * out) or, if a duration is set, once that much virtual time has passed,
+   * so results don't depend on machine speed or load.  Any capture ring is
+   * bypassed.
+   *
+   * Recorded sensors should step one frame per poll to match, e.g. with
+   * PlaybackSensor::set_realtime(false).
+   **/
+  void set_offline(bool offline) { offline_ = offline; }
+  bool get_offline() const { return offline_; }
+
+  /**
+   * Keeps observation from changing the skills it recognizes.  Read-only,
+   * each frame is matched to an existing state of each skill (exactly, or
+   * else the nearest) instead of being added as an estimated state, and
+   * reward estimates and updates go to the per-primitive overlay that is
+   * discarded when Observe returns.
+   **/
+  void set_read_only(bool read_only) { read_only_ = read_only; }
+  bool get_read_only() const { return read_only_; }
+
+  /**
+   * Streams the timeline out instead of keeping all of it, so memory stays
+   * flat however long observation runs.  Only a window of recent frames is
+   * held, long enough for the longest primitive's detections to reach
+   * back over; older frames go to sink with their final labels, and the
+   * rest when Observe returns, leaving the timeline empty.
+   *
+   * @param sink Receives final labels; NULL (the default) keeps the whole
+   *             timeline until the next observation or reset
+   **/
+  void set_timeline_sink(TimelineSink *sink) { sink_ = sink; }
+  TimelineSink *get_timeline_sink() const { return sink_; }
+
+  /**
+   * @return Frames a streaming observation holds before it emits any
+   *         (it then emits all but this many at once), as set by the last
+   *         one's primitives
+   **/
+  unsigned int get_stream_window() const { return stream_window_; }
 
   class ObservablePrimitive {
    public:
     ObservablePrimitive(string n, QLearner* qlearner)
       : name(n), q_learner(qlearner), current_state(NULL),
-        goal_distance(1E10), strikes(0) {
+        goal_distance(1E10), strikes(0), label_id(0), rng_seed(rand()),
+        overlay(&qlearner->get_q_table()->get_graph()) {
       hit_states.clear();
       duration_max_millis = qlearner->get_anticipated_duration();
     }
@@ -76,29 +171,151 @@ class RealtimeObserver : public Observer {
     State *current_state;
     double goal_distance;
     int strikes;
+
+    // Id of name in the observer's timeline
+    unsigned int label_id;
     double duration_max_millis;
+
+    // Waypoint sampling draws from this with rand_r, so primitives scored
+    // on different threads neither share nor reorder a random sequence
+    unsigned int rng_seed;
+
+    // Waypoints are boosted here for one traversal at a time, so the
+    // skill's QTable is never written to mark them.  Read-only sessions
+    // also keep their reward estimates here instead of in the QTable.
+    RewardOverlay overlay;
   };
 
 
   bool use_waypointing_;
 
  private:
+  RealtimeObserver(RealtimeObserver const &);
+  RealtimeObserver &operator=(RealtimeObserver const &);
+
+  /**
+   * Label a primitive asks for once scored against a frame: score over the
+   * frames [frame_start_, frame_end_], and the components of score as in
+   * RecognitionEvent
+   **/
+  struct PrimitiveLabel {
+    PrimitiveLabel()
+      : assigned_(false), score_(0.), frame_start_(0), frame_end_(0),
+        match_score_a_(0.), match_score_b_(0.), match_score_c_(0.),
+        match_score_d_(0.), match_score_e_(0.), match_score_f_(0.) {}
+
+    bool assigned_;
+    double score_;
+    int frame_start_;
+    int frame_end_;
+    double match_score_a_;
+    double match_score_b_;
+    double match_score_c_;
+    double match_score_d_;
+    double match_score_e_;
+    double match_score_f_;
+  };
+
+  /**
+   * Everything scoring one frame needs, shared read-only by the workers
+   **/
+  struct FrameJob {
+    RealtimeObserver *observer_;
+    vector<ObservablePrimitive *> *primitives_;
+    vector<PrimitiveLabel> *labels_;
+    vector<double> const *unified_frame_;
+    double cur_time_ms_;
+    double start_time_;
+    int cur_frame_;
+  };
+
+  /**
+   * What the capture thread needs to fill a ring for one observation
+   **/
+  struct CaptureJob {
+    RealtimeObserver *observer_;
+    FrameRing *ring_;
+    double start_time_;
+    double end_time_;
+    volatile bool done_;
+  };
+
+  static double GetTimeMillis();
+
+  /**
+   * Polls every sensor into one unified frame
+   **/
+  void CaptureFrame(int cur_frame, vector<double> *unified_frame);
+
+  /**
+   * Capture thread body: samples every sampling_rate_ milliseconds from the
+   * job's start time until its end time, pushing frames into its ring
+   **/
+  static void *CaptureLoop(void *arg);
+
+  /**
+   * @return False if any sensor has stopped running
+   **/
+  bool SensorsRunning();
+
+  /**
+   * Stores the job's frame, scores every primitive against it, labels the
+   * timeline and tells listeners.  Frames missing before it are recorded
+   * as unknown.
+   **/
+  void RecognizeFrame(FrameJob *job, bool parallel_scoring);
+
+  /**
+   * Sends the oldest count frames' final labels to sink_ and drops them
+   **/
+  void EmitFrames(unsigned int count);
+
+  /**
+   * WorkerPool task scoring the job's primitives [begin, end)
+   **/
+  static void ScoreTask(void *arg, unsigned int worker, unsigned int begin,
+                        unsigned int end);
+
+  /**
+   * Advances p to the frame and, if p's recent hits look like a complete
+   * execution, scores the match into label.  Touches nothing but p and its
+   * QLearner, so distinct primitives can be scored concurrently.
+   **/
+  void ScorePrimitive(ObservablePrimitive *p, FrameJob const &frame,
+                      PrimitiveLabel *label);
+
+  /**
+   * Reward reads and writes for scoring.  Reads go through p's overlay;
+   * writes land in it when read-only and on p's QTable otherwise.
+   **/
+  static double GetBaseReward(ObservablePrimitive *p, State *source,
+                              State *target);
+  static double GetTotalReward(ObservablePrimitive *p, State *source,
+                               State *target);
+  void SetBaseReward(ObservablePrimitive *p, State *source, State *target,
+                     double reward) const;
+
   /**
    * Internal timeline that is reset each time "Observe" is called
    * Describes what is occurring during each frame of animation
-   *
-   * Outer vector's elements represent each frame
-   * Inner vector's elements represent <score, label> pairs
    **/
-  vector<vector<pair<double, string> > > timeline_;
+  LabelTimeline timeline_;
 
   /**
-   * Internal representation of received frames
+   * Internal representation of received frames, aligned with timeline_
    **/
-  vector<vector<double> > frames_;
-  bool is_observing_;
+  deque<vector<double> > frames_;
+  volatile bool is_observing_;
   double duration_;
   double sampling_rate_;
+  WorkerPool *worker_pool_;
+  unsigned int ring_capacity_;
+  volatile unsigned int dropped_frames_;
+  volatile unsigned int overrun_frames_;
+  bool offline_;
+  bool read_only_;
+  TimelineSink *sink_;
+  unsigned int stream_window_;
 };
 
 
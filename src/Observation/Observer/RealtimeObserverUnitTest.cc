@@ -0,0 +1,420 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the realtime observer's parallel primitive scoring
+ **/
+
+#include <gtest/gtest.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "Observer/RealtimeObserver.h"
+#include "Primitives/Exploration/GreedyExplorer.h"
+#include "Primitives/QLearner/QTable.h"
+#include "Primitives/QLearner/Registry.h"
+#include "Primitives/QLearner/StandardQLearner.h"
+#include "Primitives/QLearner/State.h"
+
+namespace Observation {
+
+using Primitives::GreedyExplorer;
+using Primitives::QTable;
+using Primitives::Registry;
+using Primitives::StandardQLearner;
+
+/**
+ * Sensor reading 0, 1, 2, ... on successive polls
+ **/
+class RampSensor : public Sensor {
+ public:
+  RampSensor() : Sensor("ramp"), next_(0.), delay_millis_(0), length_(0) {
+    values_ = new double[1];
+    num_values_ = 1;
+  }
+  ~RampSensor() { delete[] values_; }
+
+  bool SetValues(double const * const values, int num_values) {
+    return false;
+  }
+
+  double const * const GetValues() {
+    if (delay_millis_ > 0) {
+      struct timespec delay_ts;
+      delay_ts.tv_sec = 0;
+      delay_ts.tv_nsec = delay_millis_ * 1000000L;
+      nanosleep(&delay_ts, NULL);
+    }
+    Poll();
+    return values_;
+  }
+
+  void Rewind() { next_ = 0.; }
+
+  /**
+   * Makes each poll take at least millis
+   **/
+  void set_delay(int millis) { delay_millis_ = millis; }
+
+  /**
+   * Makes the ramp stop running after length readings; 0 never stops
+   **/
+  void set_length(int length) { length_ = length; }
+  bool running() { return length_ == 0 || next_ <= length_; }
+
+ protected:
+  bool Poll() {
+    values_[0] = next_;
+    next_ += 1.;
+    return true;
+  }
+
+ private:
+  double next_;
+  int delay_millis_;
+  int length_;
+};
+
+/**
+ * Sink recording every frame it receives, and the most frames its observer
+ * held while emitting
+ **/
+class RecordingSink : public TimelineSink {
+ public:
+  explicit RecordingSink(RealtimeObserver *observer)
+    : observer_(observer), most_held_(0) {}
+
+  void ReceiveFrame(int frame, string const &label, double score) {
+    frames_.push_back(frame);
+    labels_.push_back(label);
+    if (observer_->get_timeline().size() > most_held_)
+      most_held_ = observer_->get_timeline().size();
+  }
+
+  RealtimeObserver *observer_;
+  std::vector<int> frames_;
+  std::vector<string> labels_;
+  unsigned int most_held_;
+};
+
+/**
+ * Listener recording each recognition and how far its observer had got
+ * when it arrived
+ **/
+class RecordingListener : public RecognitionListener {
+ public:
+  explicit RecordingListener(RealtimeObserver *observer)
+    : observer_(observer) {}
+
+  void ReceiveRecognition(RecognitionEvent const &event) {
+    events_.push_back(event);
+    end_frames_.push_back(observer_->get_timeline().get_end_frame());
+  }
+
+  RealtimeObserver *observer_;
+  std::vector<RecognitionEvent> events_;
+  std::vector<int> end_frames_;
+};
+
+class RealtimeObserverTest : public testing::Test {
+ protected:
+  static const int CHAIN_LENGTH = 30;
+  static const double FRAME_MILLIS;
+
+  RealtimeObserverTest() : observer_(FRAME_MILLIS) {
+    AddRampSkills(&skills_);
+    observer_.AddSensor(&sensor_);
+  }
+
+  virtual ~RealtimeObserverTest() {
+    for (unsigned int i = 0; i < skills_.size(); ++i)
+      delete skills_[i];
+    for (unsigned int i = 0; i < spare_skills_.size(); ++i)
+      delete spare_skills_[i];
+  }
+
+  /**
+   * Adds four skills trained on the ramp the sensor produces
+   **/
+  void AddRampSkills(std::vector<StandardQLearner *> *skills) {
+    for (int i = 0; i < 4; ++i) {
+      char name[32];
+      snprintf(name, sizeof(name), "ramp%d", i);
+      StandardQLearner *skill = new StandardQLearner(name);
+      skill->SetExplorationFunction(new GreedyExplorer());
+      skills->push_back(skill);
+
+      QTable *q_table = skill->get_q_table();
+      std::vector<State *> states;
+      for (int j = 0; j < CHAIN_LENGTH; ++j) {
+        std::vector<double> state_vector(1, static_cast<double>(j));
+        states.push_back(q_table->AddState(State(state_vector)));
+      }
+      for (int j = 0; j + 1 < CHAIN_LENGTH; ++j)
+        states[j]->set_reward(states[j + 1], Registry::LAYER_BASE, 100.);
+      q_table->AddGoalState(states[CHAIN_LENGTH - 1], true);
+      q_table->set_nearby_thresholds(std::vector<double>(1, .5));
+      skill->set_anticipated_duration(
+        static_cast<int>(FRAME_MILLIS * CHAIN_LENGTH));
+    }
+  }
+
+  /**
+   * @return Frames labeled with each skill's name anywhere in the timeline
+   **/
+  std::vector<int> CountLabels() {
+    std::vector<int> counts(skills_.size(), 0);
+    vector<vector<pair<double, string> > > timeline;
+    observer_.get_timeline().GetFrameLabels(&timeline);
+    for (unsigned int f = 0; f < timeline.size(); ++f) {
+      for (unsigned int l = 0; l < timeline[f].size(); ++l) {
+        for (unsigned int i = 0; i < skills_.size(); ++i) {
+          if (timeline[f][l].second == skills_[i]->get_name())
+            ++counts[i];
+        }
+      }
+    }
+    return counts;
+  }
+
+  RampSensor sensor_;
+  std::vector<StandardQLearner *> skills_;
+  std::vector<StandardQLearner *> spare_skills_;
+  RealtimeObserver observer_;
+};
+
+const double RealtimeObserverTest::FRAME_MILLIS = 5.;
+
+/**
+ * @test    Scoring defaults to sequential, and a pool sizes as requested
+ **/
+TEST_F(RealtimeObserverTest, ScoringWorkers) {
+  EXPECT_EQ(1u, observer_.get_scoring_workers());
+  observer_.set_scoring_workers(3);
+  EXPECT_EQ(3u, observer_.get_scoring_workers());
+  observer_.set_scoring_workers(0);
+  EXPECT_LE(1u, observer_.get_scoring_workers());
+  observer_.set_scoring_workers(1);
+  EXPECT_EQ(1u, observer_.get_scoring_workers());
+}
+
+/**
+ * @test    Primitives scored in parallel all reach the timeline, including
+ *          when two of them share a QLearner
+ **/
+TEST_F(RealtimeObserverTest, ParallelScoring) {
+  for (unsigned int i = 0; i < skills_.size(); ++i)
+    observer_.AddSkill(skills_[i]);
+  observer_.set_scoring_workers(4);
+  ASSERT_TRUE(observer_.Observe(NULL, FRAME_MILLIS * CHAIN_LENGTH * 1.5));
+  ASSERT_LT(0u, observer_.get_timeline().size());
+  EXPECT_EQ("Unknown", observer_.GetFinalTimeline()[0]);
+
+  std::vector<int> counts = CountLabels();
+  for (unsigned int i = 0; i < counts.size(); ++i)
+    EXPECT_LT(0, counts[i]) << skills_[i]->get_name();
+
+  observer_.AddSkill(skills_[0]);
+  sensor_.Rewind();
+  ASSERT_TRUE(observer_.Observe(NULL, FRAME_MILLIS * CHAIN_LENGTH * 1.5));
+  EXPECT_LT(0, CountLabels()[0]);
+}
+
+/**
+ * @test    With a capture ring, frames are captured on schedule and still
+ *          recognized
+ **/
+TEST_F(RealtimeObserverTest, CaptureRing) {
+  for (unsigned int i = 0; i < skills_.size(); ++i)
+    observer_.AddSkill(skills_[i]);
+  observer_.set_capture_ring(8);
+  observer_.set_scoring_workers(2);
+  ASSERT_TRUE(observer_.Observe(NULL, FRAME_MILLIS * CHAIN_LENGTH * 1.5));
+
+  // One timeline entry per sampling period, give or take the last
+  unsigned int expected = static_cast<unsigned int>(CHAIN_LENGTH * 1.5);
+  EXPECT_GE(expected + 1, observer_.get_timeline().size());
+  EXPECT_LE(expected - 1 - observer_.get_overrun_frames(),
+            observer_.get_timeline().size());
+  std::vector<int> counts = CountLabels();
+  for (unsigned int i = 0; i < counts.size(); ++i)
+    EXPECT_LT(0, counts[i]) << skills_[i]->get_name();
+}
+
+/**
+ * @test    Captures slower than the sampling period skip the periods they
+ *          overran, which stay unlabeled in the timeline
+ **/
+TEST_F(RealtimeObserverTest, CaptureOverrun) {
+  observer_.AddSkill(skills_[0]);
+  observer_.set_capture_ring(8);
+  sensor_.set_delay(static_cast<int>(FRAME_MILLIS * 2.5));
+  ASSERT_TRUE(observer_.Observe(NULL, FRAME_MILLIS * 20));
+
+  EXPECT_LT(5u, observer_.get_overrun_frames());
+  EXPECT_EQ(0u, observer_.get_dropped_frames());
+  vector<vector<pair<double, string> > > timeline;
+  observer_.get_timeline().GetFrameLabels(&timeline);
+  EXPECT_GE(21u, timeline.size());
+  EXPECT_LE(15u, timeline.size());
+  for (unsigned int f = 0; f < timeline.size(); ++f)
+    EXPECT_EQ("Unknown", timeline[f][0].second);
+}
+
+/**
+ * @test    Offline, every frame of a finite recording is seen once in
+ *          virtual time, and identical inputs give identical timelines
+ **/
+TEST_F(RealtimeObserverTest, Offline) {
+  for (unsigned int i = 0; i < skills_.size(); ++i)
+    observer_.AddSkill(skills_[i]);
+  observer_.set_offline(true);
+  observer_.set_scoring_workers(4);
+  sensor_.set_length(45);
+  ASSERT_TRUE(observer_.Observe(NULL));
+  EXPECT_EQ(45u, observer_.get_timeline().size());
+  EXPECT_EQ(0u, observer_.get_overrun_frames());
+  std::vector<int> counts = CountLabels();
+  for (unsigned int i = 0; i < counts.size(); ++i)
+    EXPECT_LT(0, counts[i]) << skills_[i]->get_name();
+
+  // Same recording, fresh skills, sequential scoring and a slow machine
+  RampSensor replay;
+  replay.set_length(45);
+  replay.set_delay(static_cast<int>(FRAME_MILLIS * 2));
+  RealtimeObserver observer(FRAME_MILLIS);
+  AddRampSkills(&spare_skills_);
+  for (unsigned int i = 0; i < spare_skills_.size(); ++i)
+    observer.AddSkill(spare_skills_[i]);
+  observer.AddSensor(&replay);
+  observer.set_offline(true);
+  ASSERT_TRUE(observer.Observe(NULL));
+  vector<vector<pair<double, string> > > timeline, replayed;
+  observer_.get_timeline().GetFrameLabels(&timeline);
+  observer.get_timeline().GetFrameLabels(&replayed);
+  EXPECT_TRUE(timeline == replayed);
+
+  // A duration cuts observation off in virtual time
+  sensor_.Rewind();
+  ASSERT_TRUE(observer_.Observe(NULL, FRAME_MILLIS * 10));
+  EXPECT_EQ(10u, observer_.get_timeline().size());
+}
+
+/**
+ * @test    Read-only observation recognizes the same way without adding
+ *          states to, or changing rewards in, the skills
+ **/
+TEST_F(RealtimeObserverTest, ReadOnly) {
+  for (unsigned int i = 0; i < skills_.size(); ++i)
+    observer_.AddSkill(skills_[i]);
+  observer_.set_offline(true);
+  observer_.set_read_only(true);
+  sensor_.set_length(45);
+  ASSERT_TRUE(observer_.Observe(NULL));
+
+  std::vector<int> counts = CountLabels();
+  for (unsigned int i = 0; i < skills_.size(); ++i) {
+    EXPECT_LT(0, counts[i]) << skills_[i]->get_name();
+    QTable *q_table = skills_[i]->get_q_table();
+    ASSERT_EQ(static_cast<unsigned int>(CHAIN_LENGTH),
+              q_table->get_states().size());
+    for (int j = 0; j + 1 < CHAIN_LENGTH; ++j) {
+      State *s = q_table->get_states()[j];
+      EXPECT_EQ(100., s->GetRewardValue(q_table->get_states()[j + 1], true,
+                                        ""));
+    }
+  }
+
+  // Learning observation grows the tables past the trained ramp
+  observer_.set_read_only(false);
+  sensor_.Rewind();
+  ASSERT_TRUE(observer_.Observe(NULL));
+  EXPECT_LT(static_cast<unsigned int>(CHAIN_LENGTH),
+            skills_[0]->get_q_table()->get_states().size());
+}
+
+/**
+ * @test    Streaming holds a bounded window yet emits every frame, in
+ *          order, with the labels the whole timeline would have given
+ **/
+TEST_F(RealtimeObserverTest, Streaming) {
+  for (unsigned int i = 0; i < skills_.size(); ++i)
+    observer_.AddSkill(skills_[i]);
+  observer_.set_offline(true);
+  observer_.set_read_only(true);
+  sensor_.set_length(150);
+  srand(7);
+  ASSERT_TRUE(observer_.Observe(NULL));
+  std::vector<string> expected = observer_.GetFinalTimeline();
+  ASSERT_EQ(150u, expected.size());
+
+  RecordingSink sink(&observer_);
+  observer_.set_timeline_sink(&sink);
+  sensor_.Rewind();
+  srand(7);
+  ASSERT_TRUE(observer_.Observe(NULL));
+
+  unsigned int window = observer_.get_stream_window();
+  EXPECT_GT(expected.size(), window);
+  EXPECT_GE(2 * window, sink.most_held_);
+  EXPECT_EQ(0u, observer_.get_timeline().size());
+  ASSERT_EQ(expected.size(), sink.frames_.size());
+  for (unsigned int f = 0; f < sink.frames_.size(); ++f)
+    EXPECT_EQ(static_cast<int>(f), sink.frames_[f]);
+  EXPECT_TRUE(expected == sink.labels_);
+}
+
+/**
+ * @test    Listeners hear of each recognition reaching their threshold in
+ *          the frame it is labeled, with its frames and score components
+ **/
+TEST_F(RealtimeObserverTest, Listeners) {
+  for (unsigned int i = 0; i < skills_.size(); ++i)
+    observer_.AddSkill(skills_[i]);
+  observer_.set_offline(true);
+  sensor_.set_length(45);
+
+  RecognitionQueue queue;
+  RecordingListener confident(&observer_);
+  observer_.AddListener(&queue, -1E10);
+  observer_.AddListener(&confident, .6);
+  EXPECT_FALSE(observer_.RemoveListener(NULL));
+  ASSERT_TRUE(observer_.Observe(NULL));
+
+  std::vector<RecognitionEvent> events;
+  RecognitionEvent event;
+  while (queue.Pop(&event)) events.push_back(event);
+  EXPECT_EQ(observer_.get_timeline().get_segment_count(), events.size());
+
+  unsigned int expected_confident = 0;
+  for (unsigned int i = 0; i < events.size(); ++i) {
+    EXPECT_LE(events[i].frame_start_, events[i].frame_end_);
+    EXPECT_DOUBLE_EQ(FRAME_MILLIS * events[i].frame_end_,
+                     events[i].time_ms_);
+    EXPECT_DOUBLE_EQ(FRAME_MILLIS * CHAIN_LENGTH, events[i].match_score_e_);
+    EXPECT_DOUBLE_EQ(100., events[i].match_score_f_);
+    if (events[i].score_ >= .6) ++expected_confident;
+  }
+  ASSERT_LT(0u, expected_confident);
+  ASSERT_EQ(expected_confident, confident.events_.size());
+  for (unsigned int i = 0; i < confident.events_.size(); ++i) {
+    EXPECT_LE(.6, confident.events_[i].score_);
+    EXPECT_EQ(confident.events_[i].frame_end_ + 1, confident.end_frames_[i]);
+  }
+
+  EXPECT_TRUE(observer_.RemoveListener(&queue));
+  EXPECT_TRUE(observer_.RemoveListener(&confident));
+  sensor_.Rewind();
+  ASSERT_TRUE(observer_.Observe(NULL));
+  EXPECT_FALSE(queue.Pop(&event));
+}
+
+}  // namespace Observation
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
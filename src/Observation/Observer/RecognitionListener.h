@@ -0,0 +1,111 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for being told of recognized primitives as soon as
+ * an observer labels them, plus a listener that queues them for another
+ * thread to collect.
+ **/
+
+#ifndef _SHL_OBSERVATION_OBSERVER_RECOGNITIONLISTENER_H_
+#define _SHL_OBSERVATION_OBSERVER_RECOGNITIONLISTENER_H_
+
+#include <pthread.h>
+#include <deque>
+#include <string>
+
+namespace Observation {
+
+using std::deque;
+using std::string;
+
+/**
+ * One primitive labeled over a range of frames, with the components its
+ * score was built from
+ **/
+struct RecognitionEvent {
+  RecognitionEvent()
+    : score_(0.), frame_start_(0), frame_end_(0), time_ms_(0.),
+      match_score_a_(0.), match_score_b_(0.), match_score_c_(0.),
+      match_score_d_(0.), match_score_e_(0.), match_score_f_(0.) {}
+
+  string primitive_;
+  double score_;
+
+  // Frames labeled, numbered from the start of observation
+  int frame_start_;
+  int frame_end_;
+
+  // Observation time of frame_end_, in milliseconds
+  double time_ms_;
+
+  // A: how closely the observed path's length matched the expected frames
+  // B: mean base reward along the path through the observed waypoints
+  // C: mean base reward along the optimized path
+  // D: duration of the optimized path, one state per frame
+  // E: anticipated duration of the primitive
+  // F: best possible per-state reward
+  double match_score_a_;
+  double match_score_b_;
+  double match_score_c_;
+  double match_score_d_;
+  double match_score_e_;
+  double match_score_f_;
+};
+
+class RecognitionListener {
+ public:
+  /**
+   * Destructor for RecognitionListener must free all memory it allocated
+   * internally, but is not responsible for freeing anything passed into it.
+   **/
+  virtual ~RecognitionListener() {}
+
+  /**
+   * Receives a recognition.  Called on the observing thread, so anything
+   * slow here delays the next frame.
+   **/
+  virtual void ReceiveRecognition(RecognitionEvent const &event) = 0;
+};
+
+class RecognitionQueue : public RecognitionListener {
+ public:
+  RecognitionQueue() { pthread_mutex_init(&mutex_, NULL); }
+  ~RecognitionQueue() { pthread_mutex_destroy(&mutex_); }
+
+  void ReceiveRecognition(RecognitionEvent const &event) {
+    pthread_mutex_lock(&mutex_);
+    events_.push_back(event);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  /**
+   * Takes the oldest queued recognition, from any thread
+   *
+   * @return false, leaving event untouched, if none is queued
+   **/
+  bool Pop(RecognitionEvent *event) {
+    pthread_mutex_lock(&mutex_);
+    bool found = !events_.empty();
+    if (found) {
+      *event = events_.front();
+      events_.pop_front();
+    }
+    pthread_mutex_unlock(&mutex_);
+    return found;
+  }
+
+ private:
+  RecognitionQueue(RecognitionQueue const &);
+  RecognitionQueue &operator=(RecognitionQueue const &);
+
+  pthread_mutex_t mutex_;
+  deque<RecognitionEvent> events_;
+};
+
+}  // namespace Observation
+
+#endif  // _SHL_OBSERVATION_OBSERVER_RECOGNITIONLISTENER_H_
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for receiving a streaming observer's final labels,
+ * one frame at a time and in frame order, plus a sink that appends them to
+ * a file as "frame,label,score" lines.
+ **/
+
+#ifndef _SHL_OBSERVATION_OBSERVER_TIMELINESINK_H_
+#define _SHL_OBSERVATION_OBSERVER_TIMELINESINK_H_
+
+#include <stdio.h>
+#include <string>
+
+namespace Observation {
+
+using std::string;
+
+class TimelineSink {
+ public:
+  /**
+   * Destructor for TimelineSink must free all memory it allocated
+   * internally, but is not responsible for freeing anything passed into it.
+   **/
+  virtual ~TimelineSink() {}
+
+  /**
+   * Receives one frame's final label
+   *
+   * @param     frame           Frame number since observation began
+   * @param     label           Highest scoring label, "Unknown" if none
+   *                            scored higher
+   * @param     score           The label's score
+   **/
+  virtual void ReceiveFrame(int frame, string const &label,
+                            double score) = 0;
+};
+
+class FileTimelineSink : public TimelineSink {
+ public:
+  /**
+   * @param file Open file to append to; flushed after every frame, and
+   *             never closed by the sink
+   **/
+  explicit FileTimelineSink(FILE *file) : file_(file) {}
+
+  void ReceiveFrame(int frame, string const &label, double score) {
+    fprintf(file_, "%d,%s,%g\n", frame, label.c_str(), score);
+    fflush(file_);
+  }
+
+ private:
+  FILE *file_;
+};
+
+}  // namespace Observation
+
+#endif  // _SHL_OBSERVATION_OBSERVER_TIMELINESINK_H_
@@ -52,8 +52,8 @@ bool PlaybackSensor::Poll() {
   // frames we've "received" since the last poll. 0 indicates none, some o/w
   int num_frames_recvd;
 
-  // If we're just starting...
-  if (!last_poll_frame_)
+  // If we're just starting, or stepping a frame at a time...
+  if (!last_poll_frame_ || !realtime_)
     num_frames_recvd = 1;
 
   // Otherwise, we're polling at some arbitrary point
@@ -36,7 +36,7 @@ class PlaybackSensor : public Sensor {
    * @param   num_sensors   The number of sensors (doubles) per line of file
    **/
   PlaybackSensor(char const * filename, int num_sensors) : Sensor("Playback"),
-      filename_(filename), stale_(true), running_(false),
+      filename_(filename), stale_(true), running_(false), realtime_(true),
       last_poll_time_(0), last_poll_frame_(0), file_handle_(NULL) {
     values_ = new double[num_sensors];
     num_values_ = (num_sensors);
@@ -79,6 +79,15 @@ class PlaybackSensor : public Sensor {
    **/
   virtual int last_poll_frame() { return last_poll_frame_; }
 
+  /**
+   * Chooses how polls advance through the file.  In realtime (the default)
+   * a poll skips ahead by the frames recorded since the last one; otherwise
+   * every poll reads exactly the next frame, so a recording can be played
+   * as fast as it is consumed with every frame seen once.
+   **/
+  void set_realtime(bool realtime) { realtime_ = realtime; }
+  bool get_realtime() const { return realtime_; }
+
  protected:
   /**
    * Note that the Poll() method operates slightly differently in the
@@ -126,6 +135,11 @@ class PlaybackSensor : public Sensor {
    **/
   bool running_;
 
+  /**
+   * Whether polls follow the wall clock or step one frame at a time
+   **/
+  bool realtime_;
+
   /**
    * We maintain a record of the first seconds recorded to avoid overflow issues
    **/
@@ -85,6 +85,30 @@ TEST_F(PlaybackSensorTest, PollKnownFile) {
   EXPECT_TRUE(sensor_->stale());
 }
 
+/**
+ * @test    Out of realtime, each poll reads the next frame no matter how
+ *          quickly polls come, until the file runs out
+ **/
+TEST_F(PlaybackSensorTest, StepThroughFrames) {
+  sensor_->set_realtime(false);
+  const double* observed_sensors = NULL;
+  for (int i = 1; i <= 36; ++i) {
+    observed_sensors = sensor_->GetValues();
+    EXPECT_TRUE(sensor_->running());
+    EXPECT_FALSE(sensor_->stale());
+    EXPECT_EQ(i, sensor_->last_poll_frame());
+    if (i == 2) {
+      EXPECT_EQ(-0.04499, observed_sensors[0]);
+    }
+  }
+  EXPECT_EQ(-0.07091000, observed_sensors[0]);
+  EXPECT_EQ(-1128.00000, observed_sensors[5]);
+
+  sensor_->GetValues();
+  EXPECT_FALSE(sensor_->running());
+  EXPECT_TRUE(sensor_->stale());
+}
+
 }  // namespace Observation
 
 int main(int argc, char* argv[]) {
@@ -37,12 +37,16 @@ static unsigned int primitives_count = 7;
 int main(int argc, char* argv[]) {
   if (argc < 5) {
     cout << "aaai12 <training dir> <test file> <observation duration>"
-         << "<waypointing: 1 or 0>" << endl;
+         << "<waypointing: 1 or 0> [offline: 1 or 0]" << endl;
     return 0;
   }
 
   double duration = atof(argv[3]);
 
+  // Offline, the recording is played frame by frame in virtual time, as
+  // fast as it can be recognized
+  bool offline = (argc > 5 && argv[5][0] == '1');
+
 
   cout << "Starting test:" << endl;
   string base_dir(argv[1]);
@@ -109,7 +113,9 @@ int main(int argc, char* argv[]) {
 
   PlaybackSensor *test_sensor = new PlaybackSensor(test_file, 6);
   test_sensor->set_nearby_threshold(xy_min*nearby_multiplier);
+  test_sensor->set_realtime(!offline);
   observer.AddSensor(test_sensor);
+  observer.set_offline(offline);
   observer.Observe(NULL, duration);
 
   // vector<vector<pair<double, string> > timeline = observer.get_timeline();
@@ -54,9 +54,9 @@ bool OutputStatePath(vector<State *> path, string filename) {
   for (unsigned int i = 0; i < path.size(); ++i) {
     State *s = path[i];
     char buf[4096];
-    std::vector<double> const &state_vector = s->get_state_vector();
+    double const *state_vector = s->get_values();
     snprintf(buf, sizeof(buf), "%f", state_vector[0]);
-    for (unsigned int j = 0; j < state_vector.size(); ++j) {
+    for (unsigned int j = 0; j < s->get_dimensions(); ++j) {
       char temp[64];
       snprintf(temp,sizeof(temp), ", %f", state_vector[j]);
       strcat(buf,temp);
@@ -76,7 +76,8 @@ void EvaluateDetector(RealtimeObserver *obs,
                       LBDStudent *student, 
                       string const &base_dir,
                       char *filename,
-                      bool use_waypointing) {
+                      bool use_waypointing,
+                      bool offline) {
     // Transfer student skills to observer
     vector<QLearner *> * student_skills = student->get_primitives();
     vector<QLearner *>::iterator s_iter;
@@ -94,7 +95,9 @@ void EvaluateDetector(RealtimeObserver *obs,
 
     PlaybackSensor *test_sensor = new PlaybackSensor(test_file, NUM_SENSORS);
     test_sensor->set_nearby_threshold(XY_MIN*NEARBY_MULTIPLIER);
+    test_sensor->set_realtime(!offline);
     obs->AddSensor(test_sensor);
+    obs->set_offline(offline);
     obs->Observe(NULL, obs_duration);
 
     // vector<vector<pair<double, string> > timeline = obs->get_timeline();
@@ -157,12 +160,13 @@ vector<QLearner *> GetSeenSkills(LBDStudent *student,
 int main(int argc, char* argv[]) {
   if (argc < 5) {
     cout << "iros12 <training dir> <test file> <observation duration>"
-         << "<waypointing: 1 or 0>" << endl;
+         << "<waypointing: 1 or 0> [offline: 1 or 0]" << endl;
     return 0;
   }
 
   double duration = atof(argv[3]);
   bool use_waypointing = (argv[4][0] == '0');
+  bool offline = (argc > 5 && argv[5][0] == '1');
   cout << "Starting test:" << endl;
   string base_dir(argv[1]);
 
@@ -212,7 +216,8 @@ int main(int argc, char* argv[]) {
   while (playback < 10) {
     RealtimeObserver observer(sampling_frequency);
     EvaluateDetector(&observer, duration, 
-                     &student, base_dir, argv[2], use_waypointing);
+                     &student, base_dir, argv[2], use_waypointing,
+                     offline);
 
     vector<QLearner *> skills = GetSeenSkills(&student,
                                               observer.GetFinalTimeline());
@@ -51,16 +51,16 @@ class CreditAssignmentType {
     learner_ = learner;
   }
 
+  /**
+   * Reference back to the parent QLearner object
+   */
+  QLearner *learner_;
+
  private:
   /*
    * Disable default constructor
    */
   CreditAssignmentType() {}
-
-  /**
-   * Reference back to the parent QLearner object
-   */
-  QLearner *learner_;
 };
 
 }  // namespace Primitives
@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of prioritized-sweeping credit assignment
+ **/
+
+#include <cmath>
+#include "Credit/PrioritizedSweeping.h"
+#include "QLearner/QLearner.h"
+#include "QLearner/QTable.h"
+#include "QLearner/State.h"
+#include "QLearner/TransitionGraph.h"
+
+namespace Primitives {
+
+const double PrioritizedSweeping::DEFAULT_LEARNING_RATE = .2;
+const double PrioritizedSweeping::DEFAULT_DISCOUNT_FACTOR = .9;
+const double PrioritizedSweeping::DEFAULT_THRESHOLD = 1E-3;
+
+double PrioritizedSweeping::GetValue(TransitionGraph &graph,
+                                     unsigned int id) {
+  unsigned int successor;
+  double value = 0.;
+  if (!graph.GetBestSuccessor(id, &successor, &value)) return 0.;
+  return value;
+}
+
+void PrioritizedSweeping::UpdateIncoming(TransitionGraph &graph,
+                                         unsigned int id, double change) {
+  // Only existing links change (none are added), so walking them is safe
+  TransitionGraph::IncomingLinkIterator iter;
+  for (iter = graph.IncomingLinks(id); iter.valid(); ++iter) {
+    unsigned int source = iter.source_id();
+    double old_value = GetValue(graph, source);
+    graph.SetReward(source, id, Registry::LAYER_BASE,
+                    graph.GetReward(source, id, Registry::LAYER_BASE)
+                    + change);
+
+    double delta = GetValue(graph, source) - old_value;
+    if (delta == 0.) continue;
+    if (pending_[source] == 0.) touched_.push_back(source);
+    pending_[source] += delta;
+    if (fabs(pending_[source]) > threshold_)
+      queue_.PushOrDecrease(source, -fabs(pending_[source]));
+  }
+}
+
+bool PrioritizedSweeping::ApplyCredit(double signal) {
+  update_count_ = 0;
+  QTable *q_table = learner_->get_q_table();
+  TransitionGraph &graph = q_table->get_graph();
+
+  State *current = learner_->get_current_state();
+  if (current != NULL && current->get_graph() != &graph)
+    current = q_table->GetState(*current, false);
+  if (current == NULL) {
+    Log(stderr, WARNING, "PrioritizedSweeping: No current state in the "
+                         "learner's QTable to credit.");
+    return false;
+  }
+
+  if (pending_.size() < graph.size())
+    pending_.resize(graph.size(), 0.);
+  queue_.Reset(graph.size());
+  touched_.clear();
+
+  UpdateIncoming(graph, current->get_graph_id(), learning_rate_ * signal);
+  ++update_count_;
+
+  while (!queue_.empty() && update_count_ < max_updates_) {
+    unsigned int id = queue_.Pop();
+    double change = pending_[id];
+    pending_[id] = 0.;
+    UpdateIncoming(graph, id, learning_rate_ * discount_factor_ * change);
+    ++update_count_;
+  }
+
+  // Changes left under the threshold or when the cap is hit are dropped
+  // rather than carried into the next signal
+  for (unsigned int i = 0; i < touched_.size(); ++i)
+    pending_[touched_[i]] = 0.;
+  return true;
+}
+
+}  // namespace Primitives
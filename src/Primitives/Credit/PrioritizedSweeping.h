@@ -0,0 +1,115 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is a prioritized-sweeping credit assignment function.
+ *
+ * A state's value is the total reward of its best outgoing link (its
+ * greedy successor in the QTable). A feedback signal is credited to every
+ * reward link into the learner's current state, and the resulting change
+ * in its sources' values is propagated backward through incoming links:
+ * a value change of delta at a state moves each link into it by
+ * learning_rate * discount_factor * delta.
+ *
+ * States wait in a priority queue keyed on the size of their unpropagated
+ * value change, and only changes above a threshold are propagated, so a
+ * signal costs work proportional to the region it actually affects rather
+ * than to the whole table. Changes still unpropagated when a signal ends
+ * are dropped, never added to the next signal's.
+ **/
+
+#ifndef _SHL_PRIMITIVES_CREDIT_PRIORITIZEDSWEEPING_H_
+#define _SHL_PRIMITIVES_CREDIT_PRIORITIZEDSWEEPING_H_
+
+#include <vector>
+#include "Credit/CreditAssignmentType.h"
+#include "Exploration/IndexedHeap.h"
+
+namespace Primitives {
+
+class State;
+class TransitionGraph;
+
+class PrioritizedSweeping : public CreditAssignmentType {
+ public:
+  static const double DEFAULT_LEARNING_RATE;
+  static const double DEFAULT_DISCOUNT_FACTOR;
+  static const double DEFAULT_THRESHOLD;
+  static const unsigned int DEFAULT_MAX_UPDATES = 10000;
+
+  /**
+   * @param learner QLearner whose QTable is credited; its current state is
+   *                where each signal lands
+   **/
+  explicit PrioritizedSweeping(QLearner * const learner)
+    : CreditAssignmentType(learner),
+      learning_rate_(DEFAULT_LEARNING_RATE),
+      discount_factor_(DEFAULT_DISCOUNT_FACTOR),
+      threshold_(DEFAULT_THRESHOLD),
+      max_updates_(DEFAULT_MAX_UPDATES),
+      update_count_(0) {}
+
+  /**
+   * Credits signal to the links into the learner's current state and
+   * sweeps the resulting value changes backward
+   *
+   * @return false if the learner has no current state in its QTable
+   **/
+  virtual bool ApplyCredit(double signal);
+
+  void set_learning_rate(double rate) { learning_rate_ = rate; }
+  void set_discount_factor(double discount) { discount_factor_ = discount; }
+
+  /**
+   * Value changes no larger than threshold are not propagated
+   **/
+  void set_threshold(double threshold) { threshold_ = threshold; }
+
+  /**
+   * Caps the number of states swept per signal
+   **/
+  void set_max_updates(unsigned int updates) { max_updates_ = updates; }
+
+  /**
+   * @return Number of states whose incoming links the last signal updated
+   **/
+  unsigned int get_update_count() const { return update_count_; }
+
+ private:
+  /**
+   * @return Value of the state with id: its best outgoing link's total
+   *         reward, 0 if it has none
+   **/
+  static double GetValue(TransitionGraph &graph, unsigned int id);
+
+  /**
+   * Moves every reward link into the state with id by change, and queues
+   * each source whose value changed as a result
+   **/
+  void UpdateIncoming(TransitionGraph &graph, unsigned int id,
+                      double change);
+
+  double learning_rate_;
+  double discount_factor_;
+  double threshold_;
+  unsigned int max_updates_;
+  unsigned int update_count_;
+
+  // Queue of states with unpropagated value changes. Keys are negated
+  // priorities, since the heap pops its smallest key; a state's key is
+  // only ever raised in priority, so it may be swept a little early if its
+  // pending change later shrinks.
+  IndexedHeap queue_;
+  std::vector<double> pending_;
+
+  // States given a pending change during the current signal, so all of
+  // them (queued or not) can be reset when it ends
+  std::vector<unsigned int> touched_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_CREDIT_PRIORITIZEDSWEEPING_H_
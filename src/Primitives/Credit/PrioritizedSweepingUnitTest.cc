@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for prioritized-sweeping credit assignment
+ **/
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "Credit/PrioritizedSweeping.h"
+#include "QLearner/QTable.h"
+#include "QLearner/StandardQLearner.h"
+#include "QLearner/State.h"
+
+namespace Primitives {
+
+class PrioritizedSweepingTest : public testing::Test {
+ protected:
+  /**
+   * A 200-state chain, each state linking to the next with reward 1, and
+   * a separate 200-state chain nothing links into the first from
+   **/
+  PrioritizedSweepingTest() : skill_("chain") {
+    QTable *q_table = skill_.get_q_table();
+    for (int i = 0; i < 400; ++i) {
+      std::vector<double> state_vector(1, static_cast<double>(i));
+      states_.push_back(q_table->AddState(State(state_vector)));
+    }
+    for (int i = 0; i < 399; ++i) {
+      if (i == 199) continue;
+      states_[i]->set_reward(states_[i + 1], Registry::LAYER_BASE, 1.);
+    }
+
+    credit_ = new PrioritizedSweeping(&skill_);
+    skill_.SetCreditFunction(credit_);
+  }
+
+  StandardQLearner skill_;
+  std::vector<State *> states_;
+  PrioritizedSweeping *credit_;
+};
+
+/**
+ * @test    A signal moves the links into the current state and decays
+ *          backward, stopping once changes fall under the threshold
+ **/
+TEST_F(PrioritizedSweepingTest, SweepsBackward) {
+  EXPECT_FALSE(skill_.AssignCredit(10.));
+
+  skill_.SetCurrentState(states_[150]);
+  ASSERT_TRUE(skill_.AssignCredit(10.));
+
+  // 10 * .2 on the link into 150, then .2 * .9 of each change before it
+  EXPECT_DOUBLE_EQ(3., states_[149]->GetRewardValue(states_[150]));
+  EXPECT_DOUBLE_EQ(1.36, states_[148]->GetRewardValue(states_[149]));
+  EXPECT_DOUBLE_EQ(1. + 2. * .18 * .18,
+                   states_[147]->GetRewardValue(states_[148]));
+  EXPECT_DOUBLE_EQ(1., states_[150]->GetRewardValue(states_[151]));
+  EXPECT_DOUBLE_EQ(1., states_[50]->GetRewardValue(states_[51]));
+
+  // 2 * .18^k drops under 1E-3 after five steps back
+  EXPECT_EQ(6u, credit_->get_update_count());
+  EXPECT_DOUBLE_EQ(1., states_[143]->GetRewardValue(states_[144]));
+
+  // Negative feedback sweeps the same way, down
+  ASSERT_TRUE(skill_.AssignCredit(-10.));
+  EXPECT_DOUBLE_EQ(1., states_[149]->GetRewardValue(states_[150]));
+  EXPECT_NEAR(1., states_[148]->GetRewardValue(states_[149]), 1E-12);
+}
+
+/**
+ * @test    Only the better of two links passes a value change on, and work
+ *          stays inside the affected region of the table
+ **/
+TEST_F(PrioritizedSweepingTest, AffectedRegionOnly) {
+  // 350 has a better link elsewhere, so crediting 352 can't change its value
+  states_[350]->set_reward(states_[10], Registry::LAYER_BASE, 5.);
+  skill_.SetCurrentState(states_[352]);
+  credit_->set_threshold(0.);
+  credit_->set_max_updates(1000);
+  ASSERT_TRUE(skill_.AssignCredit(1.));
+  EXPECT_DOUBLE_EQ(1.036, states_[350]->GetRewardValue(states_[351]));
+  EXPECT_DOUBLE_EQ(1., states_[349]->GetRewardValue(states_[350]));
+  EXPECT_EQ(2u, credit_->get_update_count());
+
+  // Signals landing on a state outside the table are matched to the
+  // table's copy
+  State outside(std::vector<double>(1, 20.));
+  skill_.SetCurrentState(&outside);
+  credit_->set_max_updates(3);
+  ASSERT_TRUE(skill_.AssignCredit(1.));
+  EXPECT_DOUBLE_EQ(1.2, states_[19]->GetRewardValue(states_[20]));
+  EXPECT_EQ(3u, credit_->get_update_count());
+}
+
+/**
+ * @test    Changes too small to propagate are dropped when their signal
+ *          ends, not added to the next one's
+ **/
+TEST_F(PrioritizedSweepingTest, SignalsIndependent) {
+  skill_.SetCurrentState(states_[150]);
+  credit_->set_threshold(.9);
+
+  // Moves 149's value by .2, under the threshold
+  ASSERT_TRUE(skill_.AssignCredit(1.));
+  EXPECT_EQ(1u, credit_->get_update_count());
+
+  // Moves it by .8, only over the threshold if .2 were carried over
+  ASSERT_TRUE(skill_.AssignCredit(4.));
+  EXPECT_EQ(1u, credit_->get_update_count());
+  EXPECT_DOUBLE_EQ(2., states_[149]->GetRewardValue(states_[150]));
+  EXPECT_DOUBLE_EQ(1., states_[148]->GetRewardValue(states_[149]));
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
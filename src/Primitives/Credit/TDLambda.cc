@@ -0,0 +1,66 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of TD(lambda) credit assignment
+ **/
+
+#include "Credit/TDLambda.h"
+#include "QLearner/QLearner.h"
+#include "QLearner/QTable.h"
+#include "QLearner/State.h"
+#include "QLearner/StateHistory.h"
+#include "QLearner/TransitionGraph.h"
+
+namespace Primitives {
+
+const double TDLambda::DEFAULT_LEARNING_RATE = .2;
+const double TDLambda::DEFAULT_DISCOUNT_FACTOR = .9;
+const double TDLambda::DEFAULT_LAMBDA = .8;
+const double TDLambda::DEFAULT_MIN_TRACE = 1E-3;
+
+State *TDLambda::Resolve(QTable *q_table, State *state) {
+  if (state == NULL || state->get_graph() == &q_table->get_graph())
+    return state;
+  return q_table->GetState(*state, false);
+}
+
+bool TDLambda::ApplyCredit(double signal) {
+  update_count_ = 0;
+  StateHistory const &history = learner_->get_state_history();
+  QTable *q_table = learner_->get_q_table();
+  TransitionGraph &graph = q_table->get_graph();
+  if (history.size() < 2) {
+    Log(stderr, WARNING, "TDLambda: No transitions in the state history "
+                         "to credit.");
+    return false;
+  }
+
+  double decay = discount_factor_ * lambda_;
+  double trace = 1.;
+  State *target = Resolve(q_table, history.GetState(0));
+  for (unsigned int age = 1; age < history.size() && trace >= min_trace_;
+       ++age) {
+    State *source = Resolve(q_table, history.GetState(age));
+    if (source == target) continue;
+
+    // States the table doesn't know break the chain but still age it
+    if (source != NULL && target != NULL) {
+      unsigned int source_id = source->get_graph_id();
+      unsigned int target_id = target->get_graph_id();
+      graph.SetReward(source_id, target_id, Registry::LAYER_BASE,
+                      graph.GetReward(source_id, target_id,
+                                      Registry::LAYER_BASE)
+                      + learning_rate_ * signal * trace);
+      ++update_count_;
+    }
+    trace *= decay;
+    target = source;
+  }
+  return true;
+}
+
+}  // namespace Primitives
@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is a TD(lambda) credit assignment function over the learner's
+ * bounded state history.
+ *
+ * Each transition in recent history carries an eligibility trace that
+ * decays by discount_factor * lambda per transition back from the current
+ * state. A feedback signal is credited to every transition's base-layer
+ * reward in proportion to its trace, in one pass back through the history,
+ * so feedback costs O(trace length) however large the table is.
+ *
+ * Repeated entries of the same state (a robot holding still between
+ * frames) are not transitions, and neither earn credit nor decay the
+ * trace.
+ **/
+
+#ifndef _SHL_PRIMITIVES_CREDIT_TDLAMBDA_H_
+#define _SHL_PRIMITIVES_CREDIT_TDLAMBDA_H_
+
+#include "Credit/CreditAssignmentType.h"
+
+namespace Primitives {
+
+class QTable;
+class State;
+
+class TDLambda : public CreditAssignmentType {
+ public:
+  static const double DEFAULT_LEARNING_RATE;
+  static const double DEFAULT_DISCOUNT_FACTOR;
+  static const double DEFAULT_LAMBDA;
+  static const double DEFAULT_MIN_TRACE;
+
+  explicit TDLambda(QLearner * const learner)
+    : CreditAssignmentType(learner),
+      learning_rate_(DEFAULT_LEARNING_RATE),
+      discount_factor_(DEFAULT_DISCOUNT_FACTOR),
+      lambda_(DEFAULT_LAMBDA),
+      min_trace_(DEFAULT_MIN_TRACE),
+      update_count_(0) {}
+
+  /**
+   * Credits signal to the transitions in the learner's state history,
+   * scaled by each one's eligibility trace
+   *
+   * @return false if the history holds no transition to credit
+   **/
+  virtual bool ApplyCredit(double signal);
+
+  void set_learning_rate(double rate) { learning_rate_ = rate; }
+  void set_discount_factor(double discount) { discount_factor_ = discount; }
+  void set_lambda(double lambda) { lambda_ = lambda; }
+
+  /**
+   * Transitions whose trace has decayed below min_trace earn no credit
+   **/
+  void set_min_trace(double min_trace) { min_trace_ = min_trace; }
+
+  /**
+   * @return Number of transitions the last signal credited
+   **/
+  unsigned int get_update_count() const { return update_count_; }
+
+ private:
+  /**
+   * @return q_table's copy of state, or NULL if it has none
+   **/
+  static State *Resolve(QTable *q_table, State *state);
+
+  double learning_rate_;
+  double discount_factor_;
+  double lambda_;
+  double min_trace_;
+  unsigned int update_count_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_CREDIT_TDLAMBDA_H_
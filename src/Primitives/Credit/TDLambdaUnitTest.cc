@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for TD(lambda) credit assignment
+ **/
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "Credit/TDLambda.h"
+#include "QLearner/QTable.h"
+#include "QLearner/StandardQLearner.h"
+#include "QLearner/State.h"
+
+namespace Primitives {
+
+class TDLambdaTest : public testing::Test {
+ protected:
+  TDLambdaTest() : skill_("trace") {
+    QTable *q_table = skill_.get_q_table();
+    for (int i = 0; i < 50; ++i) {
+      std::vector<double> state_vector(1, static_cast<double>(i));
+      states_.push_back(q_table->AddState(State(state_vector)));
+    }
+    credit_ = new TDLambda(&skill_);
+    skill_.SetCreditFunction(credit_);
+  }
+
+  StandardQLearner skill_;
+  std::vector<State *> states_;
+  TDLambda *credit_;
+};
+
+/**
+ * @test    Credit decays by discount * lambda per transition back through
+ *          history, skipping repeated states
+ **/
+TEST_F(TDLambdaTest, DecayedTraces) {
+  skill_.SetCurrentState(states_[0]);
+  EXPECT_FALSE(skill_.AssignCredit(10.));
+
+  states_[1]->set_reward(states_[2], Registry::LAYER_BASE, 1.);
+  skill_.SetCurrentState(states_[1]);
+  skill_.SetCurrentState(states_[1]);
+  skill_.SetCurrentState(states_[2]);
+  State outside(std::vector<double>(1, 3.));
+  skill_.SetCurrentState(&outside);
+  ASSERT_TRUE(skill_.AssignCredit(10.));
+
+  EXPECT_EQ(3u, credit_->get_update_count());
+  EXPECT_DOUBLE_EQ(2., states_[2]->GetRewardValue(states_[3]));
+  EXPECT_DOUBLE_EQ(1. + 2. * .72, states_[1]->GetRewardValue(states_[2]));
+  EXPECT_DOUBLE_EQ(2. * .72 * .72, states_[0]->GetRewardValue(states_[1]));
+  EXPECT_DOUBLE_EQ(0., states_[1]->GetRewardValue(states_[1]));
+}
+
+/**
+ * @test    Traces stop once they decay below min_trace, however long the
+ *          history is
+ **/
+TEST_F(TDLambdaTest, TraceLength) {
+  for (int lap = 0; lap < 3; ++lap) {
+    for (int i = 0; i < 50; ++i)
+      skill_.SetCurrentState(states_[i]);
+  }
+  credit_->set_min_trace(.1);
+  ASSERT_TRUE(skill_.AssignCredit(1.));
+
+  // .72^7 is the last trace of at least .1
+  EXPECT_EQ(8u, credit_->get_update_count());
+  EXPECT_GT(states_[41]->GetRewardValue(states_[42]), 0.);
+  EXPECT_DOUBLE_EQ(0., states_[40]->GetRewardValue(states_[41]));
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -7,167 +7,426 @@
 #include <string>
 #include <vector>
 #include <list>
-#include <map>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
 #include "Exploration/AStarExplorer.h"
 #include "Exploration/ExplorationType.h"
 #include "Student/Sensor.h"
+#include "QLearner/DistanceKernel.h"
 #include "QLearner/QLearner.h"
 
 namespace Primitives {
 
+const double AStarExplorer::ANYTIME_INITIAL_WEIGHT = 3.;
+const double AStarExplorer::ANYTIME_WEIGHT_STEP = .5;
+
 /**
- * Defines a heuristic function to be used when finding goal states
+ * Deadlines are only checked every this many expansions
  **/
-double AStarExplorer::Heuristic(State *cur_state, State *goal_state) {
-  return cur_state->GetEuclideanDistance(goal_state);
+static const unsigned int EXPANSIONS_PER_CLOCK_CHECK = 32;
+
+double AStarExplorer::Now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + static_cast<double>(time.tv_nsec) / 1E9;
 }
-  
 
+/**
+ * Defines a heuristic function to be used when finding goal states: the
+ * distance to the nearest goal, which never overestimates the remaining
+ * path cost to any goal
+ **/
+double AStarExplorer::Heuristic(State *cur_state) {
+  if (goal_rows_.empty()) return 0.;
+  double squared_distance = 0.;
+  DistanceKernel::NearestRow(cur_state->get_values(), &goal_rows_[0],
+                             goal_rows_.size(), cur_state->get_dimensions(),
+                             &squared_distance);
+  return sqrt(squared_distance);
+}
 
-std::list<State *> AStarExplorer::ReconstructPath(
-                                  std::map<State *, State *> came_from,
-                                  State *cur_state) {
-  std::list<State *> path;
-  if (came_from.find(cur_state) != came_from.end()) {
-    path = this->ReconstructPath(came_from, came_from[cur_state]);
-  }
-  path.push_back(cur_state);
+State *AStarExplorer::ResolveGoal(State *goal_state) {
+  if (goal_state == NULL) return NULL;
+  if (goal_state->get_graph() == &q_table_->get_graph()) return goal_state;
+  State *internal = q_table_->GetState(goal_state->get_state_hash());
+  if (internal != NULL && internal->Equals(goal_state)) return internal;
+  return NULL;
+}
+
+std::list<State *> *AStarExplorer::ReconstructPath(unsigned int end) {
+  TransitionGraph &graph = q_table_->get_graph();
+  std::list<State *> *path = new std::list<State *>();
+  for (int id = end; id >= 0; id = came_from_[id])
+    path->push_front(graph.get_state(id));
   return path;
 }
 
+void AStarExplorer::GrowSearch(unsigned int node_count) {
+  if (best_scores_.size() < node_count) {
+    best_scores_.resize(node_count);
+    came_from_.resize(node_count);
+    visit_stamp_.resize(node_count, 0);
+  }
+  open_set_.Reserve(node_count);
+}
+
+void AStarExplorer::BeginSearch(unsigned int node_count) {
+  GrowSearch(node_count);
+
+  // Stamps make every state unvisited without touching the arrays; only
+  // when the stamp wraps do they need clearing
+  if (++search_stamp_ == 0) {
+    std::fill(visit_stamp_.begin(), visit_stamp_.end(), 0);
+    search_stamp_ = 1;
+  }
+  open_set_.Reset(node_count);
+}
+
+void AStarExplorer::Expand(unsigned int cur_id, double weight) {
+  State *cur_state = q_table_->get_graph().get_state(cur_id);
+
+  // Look at all neighboring states, add them to the open set if we haven't
+  // seen them before or have found a shorter way to them
+  q_table_->GetNearbyStates(*cur_state, &neighbors_);
+  std::vector<State *>::iterator n_iter;
+  for (n_iter = neighbors_.begin(); n_iter != neighbors_.end(); ++n_iter) {
+    State *neighbor = *n_iter;
+    unsigned int neighbor_id = neighbor->get_graph_id();
+    bool visited = IsVisited(neighbor_id);
+
+    // If already evaluated, try the next one
+    if (visited && !open_set_.Contains(neighbor_id))
+      continue;
+
+    double temp_heuristic_score = best_scores_[cur_id]
+                                  + cur_state->GetEuclideanDistance(neighbor);
+
+    if (!visited || temp_heuristic_score < best_scores_[neighbor_id]) {
+      visit_stamp_[neighbor_id] = search_stamp_;
+      came_from_[neighbor_id] = cur_id;
+      best_scores_[neighbor_id] = temp_heuristic_score;
+      open_set_.PushOrDecrease(neighbor_id, temp_heuristic_score
+                               + weight * Heuristic(neighbor));
+    }
+  }
+}
+
 /**
  * Finds paths from the current state to the goal states specified for the
  * currently loaded skill.
  */
 bool AStarExplorer::PopulatePaths(State *cur_state) {
   this->ClearPaths();
-  
-  // Go through all of the trained and discovered goal states known,
-  // add paths for each one to the paths_ vector
-  std::vector<State *>::iterator iter;
-  std::vector<State *> &goal_states = q_table_->get_goal_states();
-  for (iter = goal_states.begin(); iter != goal_states.end(); ++iter) {
-    State *goal = *iter;
-    std::list<State *> * path = FindPath(cur_state, goal);
-    if (path != NULL)
-      paths_.push_back(path);    
-  }
 
-  goal_states = q_table_->get_trained_goal_states();
-  for (iter = goal_states.begin(); iter != goal_states.end(); ++iter) {
-    State *goal = *iter;
-    std::list<State *> * path = FindPath(cur_state, goal);
-    if (path != NULL)
-      paths_.push_back(path);    
-  }
+  // Go through all of the trained and discovered goal states known, and
+  // plan for all of them (and any postconditions) in one search
+  std::vector<State *> goal_states = q_table_->get_goal_states();
+  std::vector<State *> const &trained_goal_states =
+    q_table_->get_trained_goal_states();
+  goal_states.insert(goal_states.end(), trained_goal_states.begin(),
+                     trained_goal_states.end());
 
-  
-  // If there are postconditions
-  // Run with a NULL goal_state to explore until any goal states are found.
-  if (active_skill_->get_postconditions().size() > 0) {
-    std::list<State *> * path = FindPath(cur_state, NULL);
-    if (path != NULL)
-      paths_.push_back(path);        
+  // If there are postconditions, also explore until a state meeting them
+  // is found
+  bool to_postcondition = active_skill_->get_postconditions().size() > 0;
+
+  std::vector<std::list<State *> *> goal_paths;
+  std::list<State *> *postcondition_path = NULL;
+  CachedSearch(cur_state, goal_states, to_postcondition, &goal_paths,
+               to_postcondition ? &postcondition_path : NULL);
+
+  std::vector<std::list<State *> *>::iterator iter;
+  for (iter = goal_paths.begin(); iter != goal_paths.end(); ++iter) {
+    if (*iter != NULL)
+      paths_.push_back(*iter);
   }
-  
+  if (postcondition_path != NULL)
+    paths_.push_back(postcondition_path);
+
   return (paths_.size() > 0);
 }
 
 std::list<State *> * AStarExplorer::FindPath(
                                       State *cur_state, State *goal_state) {
-  
-  // Map from State hash to State pointer
-  std::map<std::string, State*> closed_set;
+  std::vector<State *> goal_states;
+  std::vector<std::list<State *> *> paths;
+  if (goal_state == NULL) {
+    std::list<State *> *postcondition_path = NULL;
+    Search(cur_state, goal_states, true, &paths, &postcondition_path);
+    return postcondition_path;
+  }
 
-  // Explored nodes
-  std::map<State*, State*> came_from;
+  goal_states.push_back(goal_state);
+  CachedSearch(cur_state, goal_states, false, &paths, NULL);
+  return paths[0];
+}
 
-  // Nodes to be expanded
-  std::map<std::string, State*> open_set;
+unsigned int AStarExplorer::FindPaths(
+    State *cur_state, std::vector<State *> const &goal_states,
+    std::vector<std::list<State *> *> *paths) {
+  return CachedSearch(cur_state, goal_states, false, paths, NULL);
+}
 
-  // Map from State pointer to associated goal-distance score
-  std::map<State *, double> state_scores;  
-  std::map<State *, double> best_state_scores;
+unsigned int AStarExplorer::CachedSearch(
+    State *cur_state, std::vector<State *> const &goal_states,
+    bool to_postcondition, std::vector<std::list<State *> *> *paths,
+    std::list<State *> **postcondition_path) {
+  TransitionGraph &graph = q_table_->get_graph();
+  if (cur_state == NULL || cur_state->get_graph() != &graph) {
+    return Search(cur_state, goal_states, to_postcondition, paths,
+                  postcondition_path);
+  }
 
+  unsigned int start = cur_state->get_graph_id();
+  paths->assign(goal_states.size(), NULL);
+  if (postcondition_path != NULL) *postcondition_path = NULL;
 
-  // Initialize with start state (cur_state)
-  open_set[cur_state->get_state_hash()] = cur_state;
-  best_state_scores[cur_state] = 0.;
-  state_scores[cur_state] = best_state_scores[cur_state] 
-                            + Heuristic(cur_state, goal_state);
-  
-  while (open_set.size() > 0) {
-    
-    // Get state with the lowest composite distance score from open_set
-    State *lowest_score_state = NULL;
-    double lowest_score = 0.0;
-    std::map<std::string, State*>::iterator iter;
-    for (iter = open_set.begin(); iter != open_set.end(); ++iter) {
-      double score = state_scores[iter->second];
-      if (iter == open_set.begin() || score < lowest_score) {
-        lowest_score = score;
-        lowest_score_state = iter->second;
-      }
+  unsigned int reached = 0;
+  std::vector<State *> missed_goals;
+  std::vector<unsigned int> missed_slots;
+  for (unsigned int i = 0; i < goal_states.size(); ++i) {
+    State *goal = ResolveGoal(goal_states[i]);
+    if (goal == NULL
+        || !path_cache_.Lookup(graph, start, goal->get_graph_id(),
+                               &path_ids_)) {
+      missed_goals.push_back(goal_states[i]);
+      missed_slots.push_back(i);
+      continue;
     }
-    
-    // Error condition
-    if (lowest_score_state == NULL) {
-      Log(stdout, ERROR, "AStarExplorer::FindPath - Empty open_set.");
-      return NULL; 
+    if (path_ids_.empty()) continue;
+
+    std::list<State *> *path = new std::list<State *>();
+    std::vector<unsigned int>::const_iterator id_iter;
+    for (id_iter = path_ids_.begin(); id_iter != path_ids_.end(); ++id_iter)
+      path->push_back(graph.get_state(*id_iter));
+    (*paths)[i] = path;
+    ++reached;
+  }
+  if (missed_goals.empty() && !to_postcondition) return reached;
+
+  std::vector<std::list<State *> *> found;
+  Search(cur_state, missed_goals, to_postcondition, &found,
+         postcondition_path);
+  for (unsigned int i = 0; i < missed_goals.size(); ++i) {
+    (*paths)[missed_slots[i]] = found[i];
+    if (found[i] != NULL) ++reached;
+
+    // A goal missed by a search cut short may still be reachable
+    State *goal = ResolveGoal(missed_goals[i]);
+    if (goal == NULL || (found[i] == NULL && search_timed_out_)) continue;
+    path_ids_.clear();
+    if (found[i] != NULL) {
+      std::list<State *>::const_iterator state_iter;
+      for (state_iter = found[i]->begin(); state_iter != found[i]->end();
+           ++state_iter)
+        path_ids_.push_back((*state_iter)->get_graph_id());
     }
+    path_cache_.Store(graph, start, goal->get_graph_id(), path_ids_);
+  }
+  return reached;
+}
 
-    State *cur_state = lowest_score_state;
+unsigned int AStarExplorer::Search(
+    State *cur_state, std::vector<State *> const &goal_states,
+    bool to_postcondition, std::vector<std::list<State *> *> *paths,
+    std::list<State *> **postcondition_path) {
+  paths->assign(goal_states.size(), NULL);
+  if (postcondition_path != NULL) *postcondition_path = NULL;
+  search_timed_out_ = false;
+
+  TransitionGraph &graph = q_table_->get_graph();
+  if (cur_state == NULL || cur_state->get_graph() != &graph) {
+    Log(stderr, ERROR, "AStarExplorer::FindPath - Start state isn't in the "
+                       "skill's QTable.");
+    return 0;
+  }
+
+  BeginSearch(graph.size());
+  if (goal_slot_.size() < graph.size())
+    goal_slot_.resize(graph.size(), -1);
+
+  // Mark each distinct goal the table holds
+  goal_ids_.clear();
+  goal_rows_.clear();
+  std::vector<State *>::const_iterator goal_iter;
+  for (goal_iter = goal_states.begin(); goal_iter != goal_states.end();
+       ++goal_iter) {
+    State *goal = ResolveGoal(*goal_iter);
+    if (goal == NULL || goal_slot_[goal->get_graph_id()] >= 0) continue;
+    goal_slot_[goal->get_graph_id()] = goal_ids_.size();
+    goal_ids_.push_back(goal->get_graph_id());
+    goal_rows_.push_back(goal->get_values());
+  }
+  unsigned int remaining = goal_ids_.size();
+  std::vector<std::list<State *> *> found(goal_ids_.size(), NULL);
+
+  // Initialize with start state (cur_state)
+  unsigned int start = cur_state->get_graph_id();
+  visit_stamp_[start] = search_stamp_;
+  best_scores_[start] = 0.;
+  came_from_[start] = -1;
+  open_set_.PushOrDecrease(start, Heuristic(cur_state));
+
+  double deadline = Now() + max_search_time_;
+  unsigned int expansions = 0;
+  while (!open_set_.empty() && (remaining > 0 || to_postcondition)) {
+    if (max_search_time_ > 0.
+        && ++expansions % EXPANSIONS_PER_CLOCK_CHECK == 0
+        && Now() >= deadline) {
+      Log(stderr, WARNING, "AStarExplorer: Search ran out of time.");
+      search_timed_out_ = true;
+      break;
+    }
+
+    // Take the state with the lowest composite distance score; once popped
+    // (visited but no longer open) a state is closed
+    unsigned int cur_id = open_set_.Pop();
+    State *cur_state = graph.get_state(cur_id);
 
-  
     // Check to see if it's a goal state
-    bool is_goal_state = false;
-    if (goal_state == NULL)
-      is_goal_state = active_skill_->IsGoalState(lowest_score_state);
-    else
-      is_goal_state = goal_state->Equals(lowest_score_state);
-      
-    if (is_goal_state) {
-      //Reconstruct path and return it
-      std::list<State *> found_path = this->ReconstructPath(came_from, 
-                                                            cur_state);
-      std::list<State *> * path = new std::list<State *>(found_path);
-      return path;
+    int slot = goal_slot_[cur_id];
+    if (slot >= 0 && found[slot] == NULL) {
+      found[slot] = this->ReconstructPath(cur_id);
+      --remaining;
+    }
+    if (to_postcondition && active_skill_->IsGoalState(cur_state)) {
+      *postcondition_path = this->ReconstructPath(cur_id);
+      to_postcondition = false;
     }
-        
-    // Remove current state from the open set, add to closed set
-    open_set.erase(open_set.find(cur_state->get_state_hash()));
-    closed_set[cur_state->get_state_hash()] = cur_state;
-    
-    
-    // Look at all neighboring states, add them to the open set if we haven't
-    // seen them before
-    std::vector<State *> neighbors = q_table_->GetNearbyStates(*cur_state);
-    std::vector<State *>::iterator n_iter;
-    for (n_iter = neighbors.begin(); n_iter != neighbors.end(); ++n_iter) {
-      State *neighbor = *n_iter;
-      
-      // If already evaluated, try the next one
-      if (closed_set.find(neighbor->get_state_hash()) != closed_set.end())
+    if (remaining == 0 && !to_postcondition) break;
+
+    Expand(cur_id, 1.);
+  }
+
+  // Hand each requested goal its own copy of the path found to it
+  unsigned int reached = 0;
+  std::vector<bool> handed_out(found.size(), false);
+  for (unsigned int i = 0; i < goal_states.size(); ++i) {
+    State *goal = ResolveGoal(goal_states[i]);
+    if (goal == NULL) continue;
+    int slot = goal_slot_[goal->get_graph_id()];
+    if (found[slot] == NULL) continue;
+    (*paths)[i] = handed_out[slot] ? new std::list<State *>(*found[slot])
+                                   : found[slot];
+    handed_out[slot] = true;
+    ++reached;
+  }
+
+  for (unsigned int i = 0; i < goal_ids_.size(); ++i)
+    goal_slot_[goal_ids_[i]] = -1;
+  goal_rows_.clear();
+
+  return reached;
+}
+
+bool AStarExplorer::BeginAnytimePlan(State *cur_state, State *goal_state) {
+  plan_start_ = NULL;
+  plan_goal_ = ResolveGoal(goal_state);
+  plan_weight_ = ANYTIME_INITIAL_WEIGHT;
+  plan_stamp_ = 0;
+  plan_status_ = PLAN_FAILED;
+  plan_path_.clear();
+  plan_bound_ = HUGE_VAL;
+
+  if (cur_state == NULL || cur_state->get_graph() != &q_table_->get_graph()
+      || plan_goal_ == NULL) {
+    Log(stderr, ERROR, "AStarExplorer::BeginAnytimePlan - States aren't in "
+                       "the skill's QTable.");
+    return false;
+  }
+
+  plan_start_ = cur_state;
+  plan_status_ = PLAN_PARTIAL;
+  return true;
+}
+
+void AStarExplorer::RestartAnytimeSearch() {
+  BeginSearch(q_table_->get_graph().size());
+  plan_stamp_ = search_stamp_;
+
+  unsigned int start = plan_start_->get_graph_id();
+  visit_stamp_[start] = search_stamp_;
+  best_scores_[start] = 0.;
+  came_from_[start] = -1;
+  plan_closest_ = start;
+  plan_closest_distance_ = Heuristic(plan_start_);
+  open_set_.PushOrDecrease(start, plan_weight_ * plan_closest_distance_);
+}
+
+AStarExplorer::PlanStatus AStarExplorer::ContinueAnytimePlan(
+    std::list<State *> *path, double *bound) {
+  path->clear();
+  *bound = HUGE_VAL;
+  if (plan_start_ == NULL) return PLAN_FAILED;
+
+  TransitionGraph &graph = q_table_->get_graph();
+  unsigned int goal_id = plan_goal_->get_graph_id();
+  goal_rows_.assign(1, plan_goal_->get_values());
+
+  if (plan_status_ == PLAN_PARTIAL || plan_status_ == PLAN_BOUNDED) {
+    // Resume the search left by the last call, unless another search has
+    // reused its arrays since. States added to the table in between start
+    // out unvisited.
+    if (plan_stamp_ != search_stamp_ || plan_stamp_ == 0)
+      RestartAnytimeSearch();
+    else
+      GrowSearch(graph.size());
+
+    double deadline = Now() + max_search_time_;
+    unsigned int expansions = 0;
+    while (true) {
+      if (open_set_.empty()) {
+        // Every reachable state was explored without reaching the goal
+        if (plan_path_.empty()) plan_status_ = PLAN_FAILED;
+        plan_stamp_ = 0;
+        break;
+      }
+      if (max_search_time_ > 0.
+          && ++expansions % EXPANSIONS_PER_CLOCK_CHECK == 0
+          && Now() >= deadline)
+        break;
+
+      unsigned int cur_id = open_set_.Pop();
+      double distance = Heuristic(graph.get_state(cur_id));
+      if (distance < plan_closest_distance_) {
+        plan_closest_ = cur_id;
+        plan_closest_distance_ = distance;
+      }
+
+      if (cur_id == goal_id) {
+        std::list<State *> *found = this->ReconstructPath(cur_id);
+        plan_path_.swap(*found);
+        delete found;
+        plan_bound_ = plan_weight_;
+
+        if (plan_weight_ <= 1.) {
+          plan_status_ = PLAN_OPTIMAL;
+          break;
+        }
+
+        // Tighten the bound and search again
+        plan_status_ = PLAN_BOUNDED;
+        plan_weight_ = std::max(1., plan_weight_ - ANYTIME_WEIGHT_STEP);
+        RestartAnytimeSearch();
         continue;
-      
-      
-      double temp_heuristic_score = 
-              best_state_scores[cur_state]
-              + cur_state->GetEuclideanDistance(neighbor);
-      
-      if (open_set.find(neighbor->get_state_hash()) == open_set.end()
-          || temp_heuristic_score < best_state_scores[neighbor]) {
-        open_set[neighbor->get_state_hash()] = neighbor;
-        came_from[neighbor] = cur_state;
-        best_state_scores[neighbor] = temp_heuristic_score;
-        state_scores[neighbor] = temp_heuristic_score 
-                                 + Heuristic(neighbor, goal_state);
       }
+
+      Expand(cur_id, plan_weight_);
     }
   }
-  
-  
-  return NULL;
+
+  if (!plan_path_.empty()) {
+    *path = plan_path_;
+    *bound = plan_bound_;
+  } else if (plan_status_ == PLAN_PARTIAL && plan_stamp_ == search_stamp_) {
+    std::list<State *> *partial = this->ReconstructPath(plan_closest_);
+    path->swap(*partial);
+    delete partial;
+  }
+
+  goal_rows_.clear();
+  return plan_status_;
 }
 
 /**
@@ -198,27 +457,8 @@ bool AStarExplorer::GetNextState(State *cur_state,
   
  
                     
-  std::map<State*, std::map<std::string, double> > const &rewards =
-    cur_state->get_reward();
-  std::map<State*, std::map<std::string, double> >::const_iterator iter;
-
-  State *best_candidate = NULL;
-  double best_reward = -10000.;
-
-  for (iter = rewards.begin(); iter != rewards.end(); ++iter) {
-    State *prospect = iter->first;
-    double prospect_reward = cur_state->GetRewardValue(prospect);
-    if (best_candidate == NULL || prospect_reward > best_reward) {
-      best_candidate = prospect;
-      best_reward = prospect_reward;
-    }
-  }
-
-  if (best_candidate == NULL) return false;
-
-  *reward = best_reward;
-  *next_state = best_candidate;
-  return true;
+  // Greedy steps come straight from the QTable's cached policy
+  return cur_state->GetBestSuccessor(next_state, reward);
 }
 
 
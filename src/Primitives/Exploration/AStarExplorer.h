@@ -7,6 +7,23 @@
  *
  * Runs A* search from current state to each defined goal state. Chooses
  * the highest-reward path of all found paths.
+ *
+ * Every goal is planned for in a single search, guided by the distance to
+ * the nearest goal. That heuristic is consistent, so each goal's path is
+ * still a shortest one.
+ *
+ * Searches stop after max_search_time seconds (if positive). For control
+ * loops there is also an anytime planner: weighted A* whose weight is
+ * tightened toward 1 each time it finds a path, run for at most
+ * max_search_time per call and resumed where it left off on the next.
+ *
+ * Searches address states by their dense id in the skill's QTable: the
+ * open set is an IndexedHeap, and path costs and back-pointers live in flat
+ * arrays that are reused (not cleared) from one search to the next.
+ *
+ * Paths to goal states are cached per (start, goal) pair and reused until
+ * a state is added that could shorten them; see PathCache. Postcondition
+ * searches and anytime plans always search afresh.
  **/
 
 #ifndef _SHL_PRIMITIVES_EXPLORATION_ASTAREXPLORER_H_
@@ -14,36 +31,186 @@
 
 #include <string>
 #include <vector>
-#include <map>
 #include <list>
 #include "Student/Student.h"
 #include "Exploration/ExplorationType.h"
+#include "Exploration/IndexedHeap.h"
 #include "Student/Sensor.h"
+#include "QLearner/PathCache.h"
 #include "QLearner/QLearner.h"
 
 namespace Primitives {
 
 class AStarExplorer : public ExplorationType {
  public:
+  /**
+   * Outcome of an anytime planning call
+   **/
+  enum PlanStatus {
+    PLAN_FAILED,   // The goal can't be reached (or no plan was begun)
+    PLAN_PARTIAL,  // No path to the goal yet; the path leads toward it
+    PLAN_BOUNDED,  // The path reaches the goal within bound of optimal
+    PLAN_OPTIMAL   // The path is a shortest path to the goal
+  };
+
+  /**
+   * Heuristic weight of the anytime planner's first search, and how much
+   * it is lowered after each path found
+   **/
+  static const double ANYTIME_INITIAL_WEIGHT;
+  static const double ANYTIME_WEIGHT_STEP;
+
   AStarExplorer(Student *s, QLearner *skill, double max_search_time) 
     : owner_student_(s), 
       active_skill_(skill),
-      max_search_time_(max_search_time) {}
+      max_search_time_(max_search_time),
+      expected_state_(NULL),
+      q_table_(skill->get_q_table()),
+      search_stamp_(0),
+      search_timed_out_(false),
+      path_cache_(PathCache::DEPENDS_ON_DISTANCES),
+      plan_start_(NULL),
+      plan_goal_(NULL),
+      plan_weight_(ANYTIME_INITIAL_WEIGHT),
+      plan_stamp_(0),
+      plan_status_(PLAN_FAILED),
+      plan_bound_(0.),
+      plan_closest_(0),
+      plan_closest_distance_(0.) {}
   ~AStarExplorer() { ClearPaths(); }
   
   
   bool PopulatePaths(State *cur_state);
+
+  /**
+   * Finds the shortest path to one goal state
+   *
+   * @param goal_state Goal to reach, or NULL to stop at the first state
+   *                   meeting the skill's postconditions
+   * @return Newly allocated path, or NULL if the goal can't be reached
+   **/
   std::list<State *> * FindPath(State * cur_state,
                                                State * goal_state);
+
+  /**
+   * Finds the shortest path to each of goal_states in a single search
+   *
+   * @param paths Populated with one newly allocated path per goal, in the
+   *              order of goal_states; NULL where a goal can't be reached
+   * @return Number of goals reached
+   **/
+  unsigned int FindPaths(State *cur_state,
+                         std::vector<State *> const &goal_states,
+                         std::vector<std::list<State *> *> *paths);
+
+  /**
+   * Starts anytime planning from cur_state to goal_state, discarding any
+   * plan in progress. No searching is done until ContinueAnytimePlan.
+   *
+   * @return false if either state isn't in the skill's QTable
+   **/
+  bool BeginAnytimePlan(State *cur_state, State *goal_state);
+
+  /**
+   * Advances the current anytime plan for at most max_search_time seconds.
+   * Other searches run in between calls make the plan restart its current
+   * weight, but keep the best path found so far.
+   *
+   * @param path Populated with the best path found so far, or if none, the
+   *             path to the explored state nearest the goal
+   * @param bound Populated with the factor by which path's cost may exceed
+   *              the shortest path's, or HUGE_VAL for a partial path
+   * @return How far planning has got
+   **/
+  PlanStatus ContinueAnytimePlan(std::list<State *> *path, double *bound);
   
   bool GetNextState(State *cur_state,
                     State ** next_state,
                     double *reward);
+  using ExplorationType::GetNextState;
+
+  /**
+   * @return Cache of paths to goal states found by earlier searches
+   **/
+  PathCache const &get_path_cache() const { return path_cache_; }
 
  private:
-  std::list<State *> ReconstructPath(
-                                     std::map<State *, State *> came_from,
-                                     State *cur_state);
+  /**
+   * Follows came_from_ back from the state with id end to the search's
+   * start state
+   *
+   * @return Newly allocated path from start to end
+   **/
+  std::list<State *> *ReconstructPath(unsigned int end);
+
+  /**
+   * Starts a new search over node_count states: sizes the per-state arrays
+   * and empties the open set
+   **/
+  void BeginSearch(unsigned int node_count);
+
+  /**
+   * Sizes the per-state arrays for node_count states without starting a
+   * new search; newly covered states are unvisited
+   **/
+  void GrowSearch(unsigned int node_count);
+
+  /**
+   * Relaxes the edges from the state with id cur_id to its nearby states,
+   * keying the open set on path cost plus weight times the heuristic
+   **/
+  void Expand(unsigned int cur_id, double weight);
+
+  /**
+   * Starts the anytime plan's search over at its current weight
+   **/
+  void RestartAnytimeSearch();
+
+  /**
+   * @return Seconds on a monotonic clock
+   **/
+  static double Now();
+
+  /**
+   * Searches outward from cur_state until every goal (and, if
+   * to_postcondition is set, some state meeting the skill's postconditions)
+   * has been reached or the reachable states run out
+   *
+   * @param paths As for FindPaths
+   * @param postcondition_path Populated with the path to the first state
+   *                           found meeting the postconditions, or NULL
+   * @return Number of goal_states reached
+   **/
+  unsigned int Search(State *cur_state,
+                      std::vector<State *> const &goal_states,
+                      bool to_postcondition,
+                      std::vector<std::list<State *> *> *paths,
+                      std::list<State *> **postcondition_path);
+
+  /**
+   * Search, but answering goals from path_cache_ where it can and only
+   * searching for the rest. Newly found paths (and goals found to be
+   * unreachable, unless the search ran out of time) are cached.
+   **/
+  unsigned int CachedSearch(State *cur_state,
+                            std::vector<State *> const &goal_states,
+                            bool to_postcondition,
+                            std::vector<std::list<State *> *> *paths,
+                            std::list<State *> **postcondition_path);
+
+  /**
+   * @return QTable-internal copy of goal_state, or NULL if the skill's
+   *         QTable doesn't hold it
+   **/
+  State *ResolveGoal(State *goal_state);
+
+  /**
+   * @return true if the state with id was reached by the current search
+   **/
+  bool IsVisited(unsigned int id) const {
+    return visit_stamp_[id] == search_stamp_;
+  }
+
   int ChoosePath();
   void UpdateStateActionGraph();
   void ClearPaths() {
@@ -52,8 +219,13 @@ class AStarExplorer : public ExplorationType {
       std::list<State *> * path = *iter;
       delete path;
     }
+    paths_.clear();
   }
-  double Heuristic(State *cur_state, State *goal_state);
+  /**
+   * @return Euclidean distance from cur_state to the nearest goal of the
+   *         current search, 0 if it has none
+   **/
+  double Heuristic(State *cur_state);
 
   Student *owner_student_;  
   QLearner *active_skill_;
@@ -61,6 +233,37 @@ class AStarExplorer : public ExplorationType {
   std::vector<std::list<State *> * > paths_;
   State *expected_state_;
   QTable *q_table_;
+
+  // Per-search state, indexed by QTable state id. An entry is only
+  // meaningful while visit_stamp_ matches search_stamp_.
+  IndexedHeap open_set_;
+  std::vector<double> best_scores_;
+  std::vector<int> came_from_;
+  std::vector<unsigned int> visit_stamp_;
+  unsigned int search_stamp_;
+  bool search_timed_out_;
+  std::vector<State *> neighbors_;
+
+  PathCache path_cache_;
+  std::vector<unsigned int> path_ids_;
+
+  // Goals of the current search: goal_slot_ maps a state id to its index in
+  // goal_ids_ (-1 for non-goals), and goal_rows_ holds their vectors
+  std::vector<int> goal_slot_;
+  std::vector<unsigned int> goal_ids_;
+  std::vector<double const *> goal_rows_;
+
+  // Anytime plan. plan_stamp_ is the search_stamp_ of the plan's search, so
+  // a mismatch means another search has reused the per-state arrays.
+  State *plan_start_;
+  State *plan_goal_;
+  double plan_weight_;
+  unsigned int plan_stamp_;
+  PlanStatus plan_status_;
+  std::list<State *> plan_path_;
+  double plan_bound_;
+  unsigned int plan_closest_;
+  double plan_closest_distance_;
 };
 
 }  // namespace Primitives
@@ -0,0 +1,232 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the A* explorer and its open-set heap
+ **/
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <list>
+#include <vector>
+#include "Exploration/AStarExplorer.h"
+#include "Exploration/IndexedHeap.h"
+#include "QLearner/QTable.h"
+#include "QLearner/StandardQLearner.h"
+#include "QLearner/State.h"
+
+namespace Primitives {
+
+/**
+ * @test    The heap pops ids in key order, including after decrease-key
+ **/
+TEST(IndexedHeapTest, PopsInKeyOrder) {
+  IndexedHeap heap;
+  heap.Reset(100);
+  srand(11);
+  std::vector<double> keys(100);
+  for (unsigned int id = 0; id < 100; ++id) {
+    keys[id] = rand() % 1000;
+    EXPECT_TRUE(heap.PushOrDecrease(id, keys[id]));
+  }
+  for (unsigned int id = 0; id < 100; id += 3) {
+    EXPECT_FALSE(heap.PushOrDecrease(id, keys[id] + 1.));
+    keys[id] -= 500.;
+    EXPECT_TRUE(heap.PushOrDecrease(id, keys[id]));
+  }
+  EXPECT_TRUE(heap.Contains(42));
+
+  double last = -1E9;
+  while (!heap.empty()) {
+    unsigned int id = heap.Top();
+    EXPECT_DOUBLE_EQ(keys[id], heap.TopKey());
+    EXPECT_EQ(id, heap.Pop());
+    EXPECT_FALSE(heap.Contains(id));
+    EXPECT_LE(last, keys[id]);
+    last = keys[id];
+  }
+
+  heap.PushOrDecrease(7, 1.);
+  heap.Reset(100);
+  EXPECT_TRUE(heap.empty());
+  EXPECT_FALSE(heap.Contains(7));
+}
+
+class AStarExplorerTest : public testing::Test {
+ protected:
+  /**
+   * Builds a 20x20 grid of states one unit apart, where each state is
+   * 'nearby' its eight surrounding states
+   **/
+  AStarExplorerTest() : skill_("grid") {
+    QTable *q_table = skill_.get_q_table();
+    for (int x = 0; x < 20; ++x) {
+      for (int y = 0; y < 20; ++y) {
+        std::vector<double> state_vector;
+        state_vector.push_back(x);
+        state_vector.push_back(y);
+        grid_.push_back(q_table->AddState(State(state_vector)));
+      }
+    }
+    q_table->set_nearby_thresholds(std::vector<double>(2, 1.));
+  }
+
+  State *At(int x, int y) { return grid_[x * 20 + y]; }
+
+  StandardQLearner skill_;
+  std::vector<State *> grid_;
+};
+
+/**
+ * @test    Paths run from start to goal along the diagonal, and repeated
+ *          searches on one explorer give the same answer
+ **/
+TEST_F(AStarExplorerTest, FindsShortestPath) {
+  AStarExplorer explorer(NULL, &skill_, 1.);
+
+  for (int run = 0; run < 2; ++run) {
+    std::list<State *> *path = explorer.FindPath(At(0, 0), At(19, 19));
+    ASSERT_TRUE(path != NULL);
+    ASSERT_EQ(20u, path->size());
+    EXPECT_EQ(At(0, 0), path->front());
+    EXPECT_EQ(At(19, 19), path->back());
+
+    int step = 0;
+    std::list<State *>::iterator iter;
+    for (iter = path->begin(); iter != path->end(); ++iter, ++step)
+      EXPECT_EQ(At(step, step), *iter);
+    delete path;
+  }
+
+  EXPECT_EQ(1u, explorer.get_path_cache().get_hits());
+
+  // Reward changes don't affect path lengths, so the path stays cached
+  At(0, 0)->set_reward(At(1, 0), Registry::LAYER_BASE, 1.);
+  delete explorer.FindPath(At(0, 0), At(19, 19));
+  EXPECT_EQ(2u, explorer.get_path_cache().get_hits());
+
+  std::list<State *> *path = explorer.FindPath(At(5, 3), At(5, 3));
+  ASSERT_TRUE(path != NULL);
+  EXPECT_EQ(1u, path->size());
+  delete path;
+}
+
+/**
+ * @test    One search finds the shortest path to every goal, including
+ *          repeated and unreachable goals
+ **/
+TEST_F(AStarExplorerTest, FindsPathsToEveryGoal) {
+  AStarExplorer explorer(NULL, &skill_, 1.);
+  std::vector<double> far_vector(2, 100.);
+  State *island = skill_.get_q_table()->AddState(State(far_vector));
+
+  std::vector<State *> goals;
+  goals.push_back(At(19, 0));
+  goals.push_back(At(0, 0));
+  goals.push_back(island);
+  goals.push_back(At(10, 15));
+  goals.push_back(At(19, 0));
+
+  std::vector<std::list<State *> *> paths;
+  EXPECT_EQ(4u, explorer.FindPaths(At(0, 5), goals, &paths));
+  ASSERT_EQ(goals.size(), paths.size());
+  EXPECT_TRUE(paths[2] == NULL);
+
+  // Grid paths move diagonally until level with the goal, so each is as
+  // long as the larger coordinate difference
+  unsigned int expected_lengths[] = {20, 6, 0, 11, 20};
+  for (unsigned int i = 0; i < goals.size(); ++i) {
+    if (i == 2) continue;
+    ASSERT_TRUE(paths[i] != NULL);
+    EXPECT_EQ(expected_lengths[i], paths[i]->size());
+    EXPECT_EQ(At(0, 5), paths[i]->front());
+    EXPECT_EQ(goals[i], paths[i]->back());
+  }
+  EXPECT_NE(paths[0], paths[4]);
+
+  for (unsigned int i = 0; i < paths.size(); ++i)
+    delete paths[i];
+}
+
+/**
+ * @test    Anytime planning tightens its bound to an optimal path, keeps
+ *          progress across calls and other searches, and fails cleanly
+ **/
+TEST_F(AStarExplorerTest, AnytimePlan) {
+  AStarExplorer explorer(NULL, &skill_, 1.);
+  std::list<State *> path;
+  double bound = 0.;
+  EXPECT_EQ(AStarExplorer::PLAN_FAILED,
+            explorer.ContinueAnytimePlan(&path, &bound));
+
+  ASSERT_TRUE(explorer.BeginAnytimePlan(At(0, 0), At(19, 19)));
+  AStarExplorer::PlanStatus status = AStarExplorer::PLAN_PARTIAL;
+  for (int call = 0; call < 20 && status != AStarExplorer::PLAN_OPTIMAL;
+       ++call) {
+    status = explorer.ContinueAnytimePlan(&path, &bound);
+    ASSERT_NE(AStarExplorer::PLAN_FAILED, status);
+
+    // Interleaved searches force the plan to restart its current weight
+    std::list<State *> *other = explorer.FindPath(At(3, 3), At(4, 4));
+    delete other;
+  }
+  EXPECT_EQ(AStarExplorer::PLAN_OPTIMAL, status);
+  EXPECT_DOUBLE_EQ(1., bound);
+  EXPECT_EQ(20u, path.size());
+  EXPECT_EQ(At(19, 19), path.back());
+
+  // Finished plans just report their result
+  EXPECT_EQ(AStarExplorer::PLAN_OPTIMAL,
+            explorer.ContinueAnytimePlan(&path, &bound));
+  EXPECT_EQ(20u, path.size());
+
+  std::vector<double> far_vector(2, 100.);
+  State *island = skill_.get_q_table()->AddState(State(far_vector));
+  ASSERT_TRUE(explorer.BeginAnytimePlan(At(0, 0), island));
+  EXPECT_EQ(AStarExplorer::PLAN_FAILED,
+            explorer.ContinueAnytimePlan(&path, &bound));
+  EXPECT_TRUE(path.empty());
+
+  // Out of time, the plan heads for the explored state nearest the goal
+  AStarExplorer hurried(NULL, &skill_, 1E-9);
+  ASSERT_TRUE(hurried.BeginAnytimePlan(At(0, 0), island));
+  EXPECT_EQ(AStarExplorer::PLAN_PARTIAL,
+            hurried.ContinueAnytimePlan(&path, &bound));
+  ASSERT_FALSE(path.empty());
+  EXPECT_EQ(At(0, 0), path.front());
+  EXPECT_EQ(HUGE_VAL, bound);
+}
+
+/**
+ * @test    Unreachable goals and foreign start states give no path
+ **/
+TEST_F(AStarExplorerTest, NoPath) {
+  AStarExplorer explorer(NULL, &skill_, 1.);
+  std::vector<double> far_vector(2, 100.);
+  State *island = skill_.get_q_table()->AddState(State(far_vector));
+  EXPECT_TRUE(explorer.FindPath(At(0, 0), island) == NULL);
+
+  // A bridge of new states makes the island reachable
+  for (int step = 1; step <= 81; ++step) {
+    std::vector<double> state_vector(2, 19. + step);
+    skill_.get_q_table()->AddState(State(state_vector));
+  }
+  std::list<State *> *path = explorer.FindPath(At(0, 0), island);
+  ASSERT_TRUE(path != NULL);
+  EXPECT_EQ(island, path->back());
+  delete path;
+
+  State outside(std::vector<double>(2, 0.));
+  EXPECT_TRUE(explorer.FindPath(&outside, At(1, 1)) == NULL);
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
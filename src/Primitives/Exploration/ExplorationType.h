@@ -15,6 +15,7 @@
 #include <vector>
 #include "Student/Sensor.h"
 #include "QLearner/QLearner.h"
+#include "QLearner/RewardOverlay.h"
 
 namespace Primitives {
 
@@ -45,6 +46,22 @@ class ExplorationType {
   virtual bool GetNextState(State *cur_state,
                             State **next_state,
                             double *reward) = 0;
+
+  /**
+   * As above, but judging transitions by their rewards as seen through
+   * overlay, so a caller can steer one traversal without touching the
+   * graph.  Explorers that step greedily share this default.
+   *
+   * @param     overlay         Rewards to consult, or NULL for the graph's
+   **/
+  virtual bool GetNextState(State *cur_state,
+                            State **next_state,
+                            double *reward,
+                            RewardOverlay *overlay) {
+    if (overlay == NULL) return GetNextState(cur_state, next_state, reward);
+    return overlay->GetBestSuccessor(cur_state, next_state, reward);
+  }
+
  private:
 };
 
@@ -28,28 +28,12 @@ class GreedyExplorer : public ExplorationType {
   bool GetNextState(State *cur_state,
                     State ** next_state,
                     double *reward) {
-    std::map<State*, std::map<std::string, double> > const &rewards =
-      cur_state->get_reward();
-    std::map<State*, std::map<std::string, double> >::const_iterator iter;
-
-    State *best_candidate = NULL;
-    double best_reward = -10000.;
-
-    for (iter = rewards.begin(); iter != rewards.end(); ++iter) {
-      State *prospect = iter->first;
-      double prospect_reward = cur_state->GetRewardValue(prospect);
-      if (best_candidate == NULL || prospect_reward > best_reward) {
-        best_candidate = prospect;
-        best_reward = prospect_reward;
-      }
-    }
-
-    if (best_candidate == NULL) return false;
-
-    *reward = best_reward;
-    *next_state = best_candidate;
-    return true;
+    // Greedy steps come straight from the QTable's cached policy
+    return cur_state->GetBestSuccessor(next_state, reward);
   }
+
+  // Steps through an overlay are greedy as well
+  using ExplorationType::GetNextState;
 };
 
 }  // namespace Primitives
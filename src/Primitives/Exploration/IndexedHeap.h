@@ -0,0 +1,151 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is a binary min-heap over dense integer ids with decrease-key, used
+ * as the open set of graph searches.
+ *
+ * Each id's position in the heap is tracked in a flat array, so membership
+ * tests are O(1) and decrease-key is O(log n) without searching the heap.
+ * Ids must be less than the capacity given to Reset.
+ **/
+
+#ifndef _SHL_PRIMITIVES_EXPLORATION_INDEXEDHEAP_H_
+#define _SHL_PRIMITIVES_EXPLORATION_INDEXEDHEAP_H_
+
+#include <vector>
+
+namespace Primitives {
+
+class IndexedHeap {
+ public:
+  IndexedHeap() {}
+
+  /**
+   * Empties the heap and makes room for ids below capacity. Only touches
+   * the entries still in the heap, so reuse across searches is cheap.
+   **/
+  void Reset(unsigned int capacity) {
+    for (unsigned int i = 0; i < heap_.size(); ++i)
+      position_[heap_[i].id_] = NOT_IN_HEAP;
+    heap_.clear();
+    Reserve(capacity);
+  }
+
+  /**
+   * Makes room for ids below capacity without emptying the heap
+   **/
+  void Reserve(unsigned int capacity) {
+    if (position_.size() < capacity)
+      position_.resize(capacity, static_cast<unsigned int>(NOT_IN_HEAP));
+  }
+
+  bool empty() const { return heap_.empty(); }
+  unsigned int size() const { return heap_.size(); }
+
+  bool Contains(unsigned int id) const {
+    return id < position_.size() && position_[id] != NOT_IN_HEAP;
+  }
+
+  /**
+   * @return Key of an id in the heap
+   **/
+  double GetKey(unsigned int id) const { return heap_[position_[id]].key_; }
+
+  /**
+   * Adds id with key, or lowers its key if it is already in the heap and
+   * key is smaller
+   *
+   * @return false if id was already in the heap with a key <= key
+   **/
+  bool PushOrDecrease(unsigned int id, double key) {
+    if (Contains(id)) {
+      unsigned int pos = position_[id];
+      if (heap_[pos].key_ <= key) return false;
+      heap_[pos].key_ = key;
+      SiftUp(pos);
+      return true;
+    }
+
+    Entry entry;
+    entry.id_ = id;
+    entry.key_ = key;
+    heap_.push_back(entry);
+    position_[id] = heap_.size() - 1;
+    SiftUp(heap_.size() - 1);
+    return true;
+  }
+
+  /**
+   * @return Id with the smallest key; the heap must not be empty
+   **/
+  unsigned int Top() const { return heap_[0].id_; }
+  double TopKey() const { return heap_[0].key_; }
+
+  /**
+   * Removes and returns the id with the smallest key. The heap must not be
+   * empty.
+   **/
+  unsigned int Pop() {
+    unsigned int id = heap_[0].id_;
+    position_[id] = NOT_IN_HEAP;
+
+    Entry last = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty()) {
+      heap_[0] = last;
+      position_[last.id_] = 0;
+      SiftDown(0);
+    }
+    return id;
+  }
+
+ private:
+  struct Entry {
+    unsigned int id_;
+    double key_;
+  };
+
+  static const unsigned int NOT_IN_HEAP = 0xFFFFFFFF;
+
+  void SiftUp(unsigned int pos) {
+    Entry entry = heap_[pos];
+    while (pos > 0) {
+      unsigned int parent = (pos - 1) / 2;
+      if (!(entry.key_ < heap_[parent].key_)) break;
+      Place(pos, heap_[parent]);
+      pos = parent;
+    }
+    Place(pos, entry);
+  }
+
+  void SiftDown(unsigned int pos) {
+    Entry entry = heap_[pos];
+    unsigned int count = heap_.size();
+    while (true) {
+      unsigned int child = 2 * pos + 1;
+      if (child >= count) break;
+      if (child + 1 < count && heap_[child + 1].key_ < heap_[child].key_)
+        ++child;
+      if (!(heap_[child].key_ < entry.key_)) break;
+      Place(pos, heap_[child]);
+      pos = child;
+    }
+    Place(pos, entry);
+  }
+
+  void Place(unsigned int pos, Entry const &entry) {
+    heap_[pos] = entry;
+    position_[entry.id_] = pos;
+  }
+
+  std::vector<Entry> heap_;
+  std::vector<unsigned int> position_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_EXPLORATION_INDEXEDHEAP_H_
@@ -0,0 +1,73 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of a Bloom Filter using double hashing
+ **/
+
+#include "QLearner/BloomFilter.h"
+#include <cmath>
+
+namespace Primitives {
+
+BloomFilter::BloomFilter(unsigned int expected_entries,
+                         double false_positive_rate)
+  : false_positive_rate_(false_positive_rate) {
+  Reset(expected_entries);
+}
+
+void BloomFilter::Reset(unsigned int expected_entries) {
+  const double LN2 = 0.69314718055994530942;
+  if (expected_entries < 64) expected_entries = 64;
+
+  // Optimal sizing: m = -n ln(p) / ln(2)^2 bits, k = (m / n) ln(2) hashes
+  double bits = -static_cast<double>(expected_entries)
+                * log(false_positive_rate_) / (LN2 * LN2);
+  num_bits_ = static_cast<uint64_t>(ceil(bits / 64.)) * 64;
+  num_hashes_ = static_cast<unsigned int>(
+    ceil(static_cast<double>(num_bits_) / expected_entries * LN2));
+  if (num_hashes_ < 1) num_hashes_ = 1;
+
+  bits_.assign(num_bits_ / 64, 0);
+  capacity_ = expected_entries;
+  entry_count_ = 0;
+}
+
+void BloomFilter::HashKey(uint64_t key, uint64_t *h1, uint64_t *h2) {
+  // splitmix64 finalizer: spreads nearby keys over the whole bit array
+  uint64_t z = key + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  *h1 = z ^ (z >> 31);
+
+  z = *h1 + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  *h2 = (z ^ (z >> 31)) | 1;  // Odd stride visits distinct bits
+}
+
+void BloomFilter::Add(uint64_t key) {
+  uint64_t h1, h2;
+  HashKey(key, &h1, &h2);
+  for (unsigned int i = 0; i < num_hashes_; ++i) {
+    uint64_t bit = (h1 + i * h2) % num_bits_;
+    bits_[bit >> 6] |= (1ULL << (bit & 63));
+  }
+  ++entry_count_;
+}
+
+bool BloomFilter::MightContain(uint64_t key) const {
+  uint64_t h1, h2;
+  HashKey(key, &h1, &h2);
+  for (unsigned int i = 0; i < num_hashes_; ++i) {
+    uint64_t bit = (h1 + i * h2) % num_bits_;
+    if (!(bits_[bit >> 6] & (1ULL << (bit & 63))))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace Primitives
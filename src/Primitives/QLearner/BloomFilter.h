@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for a Bloom Filter over 64-bit keys, used by the
+ * QTable to quickly rule out states it has never seen.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_BLOOMFILTER_H_
+#define _SHL_PRIMITIVES_QLEARNER_BLOOMFILTER_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace Primitives {
+
+class BloomFilter {
+ public:
+  /**
+   * Sizes the filter so that it stays under false_positive_rate until it
+   * holds expected_entries keys
+   *
+   * @param expected_entries Number of keys the filter is sized for
+   * @param false_positive_rate Target false positive probability (0 - 1)
+   **/
+  explicit BloomFilter(unsigned int expected_entries,
+                       double false_positive_rate = 0.01);
+
+  /**
+   * Marks key as present in the filter
+   *
+   * @param key Key to insert
+   **/
+  void Add(uint64_t key);
+
+  /**
+   * Checks whether key may have been added. Capable of false positives,
+   * never false negative.
+   *
+   * @param key Key to check for
+   * @return false if key was definitely never added, true otherwise
+   **/
+  bool MightContain(uint64_t key) const;
+
+  /**
+   * Clears all keys and re-sizes the filter for a new expected entry count.
+   * Callers are responsible for re-adding any keys they still need.
+   *
+   * @param expected_entries Number of keys the filter is sized for
+   **/
+  void Reset(unsigned int expected_entries);
+
+  /**
+   * @return true once the filter holds more keys than it was sized for
+   **/
+  bool IsSaturated() const { return entry_count_ > capacity_; }
+
+  unsigned int get_capacity() const { return capacity_; }
+  unsigned int get_entry_count() const { return entry_count_; }
+
+ private:
+  /**
+   * Derives the two base hashes used for double hashing from key
+   **/
+  static void HashKey(uint64_t key, uint64_t *h1, uint64_t *h2);
+
+  /**
+   * Bit array, packed 64 bits per word
+   **/
+  std::vector<uint64_t> bits_;
+
+  uint64_t num_bits_;
+  unsigned int num_hashes_;
+  unsigned int capacity_;
+  unsigned int entry_count_;
+  double false_positive_rate_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_BLOOMFILTER_H_
@@ -0,0 +1,208 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for a compressed sparse row (CSR) adjacency list over
+ * densely numbered nodes, supporting incremental edge insertion.
+ *
+ * Edges live in two places: a compacted base array, where each node's edges
+ * are contiguous, and a pending array where new edges are appended and
+ * chained per node in insertion order. Removed edges are left as dead slots.
+ * Once enough pending or dead slots build up, Compact() folds everything
+ * back into a fresh base array, preserving each node's edge order.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_COMPACTADJACENCY_H_
+#define _SHL_PRIMITIVES_QLEARNER_COMPACTADJACENCY_H_
+
+#include <vector>
+
+namespace Primitives {
+
+template <class Edge>
+class CompactAdjacency {
+ private:
+  struct Slot {
+    Edge edge_;
+    int next_;  // Next pending slot of the same node, or -1
+    bool live_;
+  };
+
+ public:
+  /**
+   * Walks one node's live edges in insertion order. Invalidated by Append
+   * and Compact.
+   **/
+  class iterator {
+   public:
+    iterator() : owner_(NULL), base_(0), base_end_(0), pending_(-1) {}
+
+    bool valid() const { return base_ < base_end_ || pending_ >= 0; }
+
+    Edge &operator*() const { return slot().edge_; }
+    Edge *operator->() const { return &slot().edge_; }
+
+    /**
+     * Marks the current edge as removed
+     **/
+    void Remove() {
+      slot().live_ = false;
+      ++owner_->dead_count_;
+    }
+
+    iterator &operator++() {
+      if (base_ < base_end_)
+        ++base_;
+      else
+        pending_ = owner_->pending_[pending_].next_;
+      SkipDead();
+      return *this;
+    }
+
+   private:
+    friend class CompactAdjacency;
+
+    iterator(CompactAdjacency *owner, unsigned int node)
+      : owner_(owner), base_(owner->offsets_[node]),
+        base_end_(owner->offsets_[node + 1]),
+        pending_(owner->pending_head_[node]) {
+      SkipDead();
+    }
+
+    Slot &slot() const {
+      if (base_ < base_end_) return owner_->base_[base_];
+      return owner_->pending_[pending_];
+    }
+
+    void SkipDead() {
+      while (valid() && !slot().live_) {
+        if (base_ < base_end_)
+          ++base_;
+        else
+          pending_ = owner_->pending_[pending_].next_;
+      }
+    }
+
+    CompactAdjacency *owner_;
+    unsigned int base_;
+    unsigned int base_end_;
+    int pending_;
+  };
+
+  CompactAdjacency() : dead_count_(0) {
+    offsets_.push_back(0);
+  }
+
+  /**
+   * Grows the node count to node_count, giving new nodes no edges
+   **/
+  void Resize(unsigned int node_count) {
+    if (node_count + 1 > offsets_.size())
+      offsets_.resize(node_count + 1, base_.size());
+    if (node_count > pending_head_.size()) {
+      pending_head_.resize(node_count, -1);
+      pending_tail_.resize(node_count, -1);
+    }
+  }
+
+  /**
+   * Adds an edge after every existing edge of node. Invalidates iterators.
+   **/
+  void Append(unsigned int node, Edge const &edge) {
+    Slot slot;
+    slot.edge_ = edge;
+    slot.next_ = -1;
+    slot.live_ = true;
+    pending_.push_back(slot);
+
+    int index = pending_.size() - 1;
+    if (pending_tail_[node] < 0)
+      pending_head_[node] = index;
+    else
+      pending_[pending_tail_[node]].next_ = index;
+    pending_tail_[node] = index;
+
+    if (NeedsCompaction()) Compact();
+  }
+
+  iterator Begin(unsigned int node) {
+    return iterator(this, node);
+  }
+
+  /**
+   * @return true once pending or dead slots make up a large enough share of
+   *         storage that compaction pays for itself
+   **/
+  bool NeedsCompaction() const {
+    unsigned int overhead = pending_.size() + dead_count_;
+    return overhead >= MIN_COMPACTION_SLOTS && overhead >= base_.size() / 2;
+  }
+
+  /**
+   * Rebuilds the base array from every live edge, in per-node order, and
+   * empties the pending array. Invalidates iterators.
+   **/
+  void Compact() {
+    unsigned int node_count = offsets_.size() - 1;
+    std::vector<Slot> base;
+    std::vector<unsigned int> offsets;
+    base.reserve(base_.size() + pending_.size() - dead_count_);
+    offsets.reserve(node_count + 1);
+
+    for (unsigned int node = 0; node < node_count; ++node) {
+      offsets.push_back(base.size());
+      for (iterator iter = Begin(node); iter.valid(); ++iter) {
+        Slot slot = iter.slot();
+        slot.next_ = -1;
+        base.push_back(slot);
+      }
+    }
+    offsets.push_back(base.size());
+
+    base_.swap(base);
+    offsets_.swap(offsets);
+    pending_.clear();
+    pending_head_.assign(node_count, -1);
+    pending_tail_.assign(node_count, -1);
+    dead_count_ = 0;
+  }
+
+  void Clear() {
+    base_.clear();
+    pending_.clear();
+    offsets_.assign(1, 0);
+    pending_head_.clear();
+    pending_tail_.clear();
+    dead_count_ = 0;
+  }
+
+  /**
+   * @return Number of edge slots in use, live or dead
+   **/
+  unsigned int get_slot_count() const {
+    return base_.size() + pending_.size();
+  }
+
+ private:
+  /**
+   * Don't bother compacting until at least this many slots are pending or
+   * dead
+   **/
+  static const unsigned int MIN_COMPACTION_SLOTS = 1024;
+
+  std::vector<Slot> base_;
+  std::vector<unsigned int> offsets_;  // Node n's base edges start here
+
+  std::vector<Slot> pending_;
+  std::vector<int> pending_head_;
+  std::vector<int> pending_tail_;
+
+  unsigned int dead_count_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_COMPACTADJACENCY_H_
@@ -0,0 +1,178 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of the vectorized state distance kernels
+ **/
+
+#include "QLearner/DistanceKernel.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SHL_DISTANCE_AVX
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SHL_DISTANCE_SSE2
+#endif
+
+namespace Primitives {
+
+namespace {
+
+#if defined(SHL_DISTANCE_AVX)
+inline double HorizontalSum(__m256d v) {
+  __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v),
+                           _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+#elif defined(SHL_DISTANCE_SSE2)
+inline double HorizontalSum(__m128d v) {
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+#endif
+
+}  // namespace
+
+char const *DistanceKernel::get_instruction_set() {
+#if defined(SHL_DISTANCE_AVX)
+  return "avx";
+#elif defined(SHL_DISTANCE_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+double DistanceKernel::SquaredDistance(double const *a, double const *b,
+                                       unsigned int dimensions) {
+  unsigned int i = 0;
+  double total = 0.;
+
+#if defined(SHL_DISTANCE_AVX)
+  __m256d sum = _mm256_setzero_pd();
+  for (; i + 4 <= dimensions; i += 4) {
+    __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(a + i),
+                                 _mm256_loadu_pd(b + i));
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(diff, diff));
+  }
+  total = HorizontalSum(sum);
+#elif defined(SHL_DISTANCE_SSE2)
+  __m128d sum = _mm_setzero_pd();
+  for (; i + 2 <= dimensions; i += 2) {
+    __m128d diff = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+    sum = _mm_add_pd(sum, _mm_mul_pd(diff, diff));
+  }
+  total = HorizontalSum(sum);
+#endif
+
+  for (; i < dimensions; ++i) {
+    double diff = a[i] - b[i];
+    total += diff * diff;
+  }
+  return total;
+}
+
+bool DistanceKernel::WithinThresholds(double const *a, double const *b,
+                                      double const *squared_thresholds,
+                                      unsigned int dimensions) {
+  unsigned int i = 0;
+
+#if defined(SHL_DISTANCE_AVX)
+  for (; i + 4 <= dimensions; i += 4) {
+    __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(a + i),
+                                 _mm256_loadu_pd(b + i));
+    __m256d over = _mm256_cmp_pd(_mm256_mul_pd(diff, diff),
+                                 _mm256_loadu_pd(squared_thresholds + i),
+                                 _CMP_GT_OQ);
+    if (_mm256_movemask_pd(over)) return false;
+  }
+#elif defined(SHL_DISTANCE_SSE2)
+  for (; i + 2 <= dimensions; i += 2) {
+    __m128d diff = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+    __m128d over = _mm_cmpgt_pd(_mm_mul_pd(diff, diff),
+                                _mm_loadu_pd(squared_thresholds + i));
+    if (_mm_movemask_pd(over)) return false;
+  }
+#endif
+
+  for (; i < dimensions; ++i) {
+    double diff = a[i] - b[i];
+    if (diff * diff > squared_thresholds[i]) return false;
+  }
+  return true;
+}
+
+double DistanceKernel::ScaledSquaredDistance(double const *a, double const *b,
+                                             double const *scales,
+                                             double sensitivity,
+                                             unsigned int dimensions,
+                                             bool *within) {
+  unsigned int i = 0;
+  double total = 0.;
+  bool all_within = true;
+
+#if defined(SHL_DISTANCE_AVX)
+  __m256d sum = _mm256_setzero_pd();
+  __m256d factor = _mm256_set1_pd(sensitivity);
+  int over_mask = 0;
+  for (; i + 4 <= dimensions; i += 4) {
+    __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(a + i),
+                                 _mm256_loadu_pd(b + i));
+    __m256d squared = _mm256_mul_pd(diff, diff);
+    __m256d scale = _mm256_loadu_pd(scales + i);
+    sum = _mm256_add_pd(sum, _mm256_div_pd(squared, scale));
+    over_mask |= _mm256_movemask_pd(
+      _mm256_cmp_pd(squared, _mm256_mul_pd(scale, factor), _CMP_GT_OQ));
+  }
+  total = HorizontalSum(sum);
+  if (over_mask) all_within = false;
+#elif defined(SHL_DISTANCE_SSE2)
+  __m128d sum = _mm_setzero_pd();
+  __m128d factor = _mm_set1_pd(sensitivity);
+  int over_mask = 0;
+  for (; i + 2 <= dimensions; i += 2) {
+    __m128d diff = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+    __m128d squared = _mm_mul_pd(diff, diff);
+    __m128d scale = _mm_loadu_pd(scales + i);
+    sum = _mm_add_pd(sum, _mm_div_pd(squared, scale));
+    over_mask |= _mm_movemask_pd(
+      _mm_cmpgt_pd(squared, _mm_mul_pd(scale, factor)));
+  }
+  total = HorizontalSum(sum);
+  if (over_mask) all_within = false;
+#endif
+
+  for (; i < dimensions; ++i) {
+    double diff = a[i] - b[i];
+    double squared = diff * diff;
+    total += squared / scales[i];
+    if (squared > scales[i] * sensitivity) all_within = false;
+  }
+
+  if (within) *within = all_within;
+  return total;
+}
+
+unsigned int DistanceKernel::NearestRow(double const *query,
+                                        double const * const *rows,
+                                        unsigned int count,
+                                        unsigned int dimensions,
+                                        double *squared_distance) {
+  unsigned int best = count;
+  double best_distance = 0.;
+  for (unsigned int row = 0; row < count; ++row) {
+    double distance = SquaredDistance(query, rows[row], dimensions);
+    if (best == count || distance < best_distance) {
+      best = row;
+      best_distance = distance;
+    }
+  }
+
+  if (squared_distance && best < count) *squared_distance = best_distance;
+  return best;
+}
+
+}  // namespace Primitives
@@ -0,0 +1,91 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for the vectorized state distance kernels used by the
+ * nearby, nearest and goal state checks.
+ *
+ * Every kernel works on raw state vector values (see State::get_values) and
+ * never allocates. When the compiler targets AVX (build with SIMDFLAGS, e.g.
+ * -mavx2) four dimensions are processed per instruction, two with SSE2 (on
+ * by default for x86-64), and a scalar loop is used everywhere else.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_DISTANCEKERNEL_H_
+#define _SHL_PRIMITIVES_QLEARNER_DISTANCEKERNEL_H_
+
+namespace Primitives {
+
+class DistanceKernel {
+ public:
+  /**
+   * @return Name of the instruction set the kernels were compiled for
+   **/
+  static char const *get_instruction_set();
+
+  /**
+   * Sums the squared per-dimension differences between a and b
+   *
+   * @param a First state vector
+   * @param b Second state vector
+   * @param dimensions Number of values in a and b
+   * @return Squared euclidean distance
+   **/
+  static double SquaredDistance(double const *a, double const *b,
+                                unsigned int dimensions);
+
+  /**
+   * Checks that (a[i] - b[i])^2 <= squared_thresholds[i] in every dimension,
+   * stopping at the first vector block that violates it
+   *
+   * @param a First state vector
+   * @param b Second state vector
+   * @param squared_thresholds Squared per-dimension distance limits
+   * @param dimensions Number of values in a, b and squared_thresholds
+   * @return true if b is within the thresholds of a
+   **/
+  static bool WithinThresholds(double const *a, double const *b,
+                               double const *squared_thresholds,
+                               unsigned int dimensions);
+
+  /**
+   * Sums (a[i] - b[i])^2 / scales[i], and checks whether every
+   * (a[i] - b[i])^2 <= scales[i] * sensitivity along the way
+   *
+   * @param a First state vector
+   * @param b Second state vector
+   * @param scales Per-dimension squared distance units
+   * @param sensitivity Multiple of scales allowed per dimension
+   * @param dimensions Number of values in a, b and scales
+   * @param within Populated with the result of the per-dimension check
+   * @return Sum of the scaled squared distances
+   **/
+  static double ScaledSquaredDistance(double const *a, double const *b,
+                                      double const *scales,
+                                      double sensitivity,
+                                      unsigned int dimensions, bool *within);
+
+  /**
+   * Batched SquaredDistance: finds the row nearest to query. Ties go to the
+   * earliest row.
+   *
+   * @param query State vector to search around
+   * @param rows State vectors to search
+   * @param count Number of rows
+   * @param dimensions Number of values in query and each row
+   * @param squared_distance Populated with the best squared distance, if
+   *                         not NULL
+   * @return Index of the nearest row, or count if there are no rows
+   **/
+  static unsigned int NearestRow(double const *query,
+                                 double const * const *rows,
+                                 unsigned int count, unsigned int dimensions,
+                                 double *squared_distance);
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_DISTANCEKERNEL_H_
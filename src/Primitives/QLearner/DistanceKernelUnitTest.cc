@@ -0,0 +1,92 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the vectorized state distance kernels
+ **/
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+#include "QLearner/DistanceKernel.h"
+
+namespace Primitives {
+
+/**
+ * @test    Every kernel agrees with a scalar reference for dimension counts
+ *          that do and don't fill whole vector blocks
+ **/
+TEST(DistanceKernelTest, MatchesScalarReference) {
+  srand(11);
+  for (unsigned int dims = 1; dims <= 23; ++dims) {
+    std::vector<double> a(dims), b(dims), thresholds(dims);
+    for (unsigned int i = 0; i < dims; ++i) {
+      a[i] = (rand() % 2000) / 1000. - 1.;
+      b[i] = (rand() % 2000) / 1000. - 1.;
+      thresholds[i] = (rand() % 1000) / 1000. + 0.01;
+    }
+
+    double squared = 0.;
+    double scaled = 0.;
+    bool within = true;
+    bool within_double = true;
+    for (unsigned int i = 0; i < dims; ++i) {
+      double diff = a[i] - b[i];
+      squared += diff * diff;
+      scaled += diff * diff / thresholds[i];
+      if (diff * diff > thresholds[i]) within = false;
+      if (diff * diff > thresholds[i] * 2.) within_double = false;
+    }
+
+    EXPECT_NEAR(squared,
+                DistanceKernel::SquaredDistance(&a[0], &b[0], dims), 1E-12);
+    EXPECT_EQ(within, DistanceKernel::WithinThresholds(&a[0], &b[0],
+                                                       &thresholds[0], dims));
+
+    bool kernel_within = false;
+    EXPECT_NEAR(scaled, DistanceKernel::ScaledSquaredDistance(
+                  &a[0], &b[0], &thresholds[0], 2., dims, &kernel_within),
+                1E-9);
+    EXPECT_EQ(within_double, kernel_within);
+
+    // A vector is always within any non-negative threshold of itself
+    EXPECT_TRUE(DistanceKernel::WithinThresholds(&a[0], &a[0],
+                                                 &thresholds[0], dims));
+  }
+}
+
+/**
+ * @test    The batched kernel ranks rows like a one-at-a-time scan
+ **/
+TEST(DistanceKernelTest, NearestRow) {
+  const unsigned int DIMS = 6;
+  std::vector<double> storage;
+  for (unsigned int row = 0; row < 40; ++row) {
+    for (unsigned int dim = 0; dim < DIMS; ++dim)
+      storage.push_back(0.1 * row - 0.01 * dim);
+  }
+  std::vector<double const *> rows;
+  for (unsigned int row = 0; row < 40; ++row)
+    rows.push_back(&storage[row * DIMS]);
+
+  std::vector<double> query(DIMS, 1.5);
+  double distance = -1.;
+  unsigned int nearest = DistanceKernel::NearestRow(&query[0], &rows[0],
+                                                    rows.size(), DIMS,
+                                                    &distance);
+  EXPECT_EQ(15u, nearest);
+  EXPECT_NEAR(DistanceKernel::SquaredDistance(&query[0], rows[15], DIMS),
+              distance, 1E-15);
+  EXPECT_EQ(0u, DistanceKernel::NearestRow(&query[0], &rows[0], 0, DIMS,
+                                           NULL));
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,282 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of the k-d tree spatial index over QTable states
+ **/
+
+#include "QLearner/KdTree.h"
+#include "QLearner/DistanceKernel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Primitives {
+
+namespace {
+
+/**
+ * Weight-balance factor: a subtree is rebuilt once one child holds more than
+ * this fraction of its points
+ **/
+const double BALANCE_ALPHA = 0.7;
+
+/**
+ * Orders point numbers by one coordinate, for median selection
+ **/
+class PointCoordinateLess {
+ public:
+  PointCoordinateLess(StateArena const *arena, unsigned int dim)
+    : arena_(arena), dim_(dim) {}
+
+  bool operator()(unsigned int a, unsigned int b) const {
+    return arena_->Row(a)[dim_] < arena_->Row(b)[dim_];
+  }
+
+ private:
+  StateArena const *arena_;
+  unsigned int dim_;
+};
+
+}  // namespace
+
+bool KdTree::Insert(State *state, unsigned int row) {
+  if (row != states_.size() || row >= arena_->size()) return false;
+
+  unsigned int point_num = row;
+  unsigned int dimensions = arena_->get_dimensions();
+  double const *point = Point(point_num);
+  states_.push_back(state);
+
+  Node leaf;
+  leaf.point_ = point_num;
+  leaf.split_dim_ = 0;
+  leaf.size_ = 1;
+  leaf.left_ = -1;
+  leaf.right_ = -1;
+
+  if (root_ < 0) {
+    nodes_.push_back(leaf);
+    root_ = nodes_.size() - 1;
+    return true;
+  }
+
+  // Walk down to an empty child slot, counting the new point in every
+  // subtree along the way
+  std::vector<int> path;
+  int cur = root_;
+  bool went_left = false;
+  while (true) {
+    path.push_back(cur);
+    Node &node = nodes_[cur];
+    ++node.size_;
+    unsigned int dim = node.split_dim_;
+    went_left = point[dim] < Point(node.point_)[dim];
+    int next = went_left ? node.left_ : node.right_;
+    if (next < 0) break;
+    cur = next;
+  }
+
+  leaf.split_dim_ = (nodes_[cur].split_dim_ + 1) % dimensions;
+  nodes_.push_back(leaf);
+  int leaf_index = nodes_.size() - 1;
+  if (went_left)
+    nodes_[cur].left_ = leaf_index;
+  else
+    nodes_[cur].right_ = leaf_index;
+
+  // If the new leaf is deeper than a balanced tree allows, rebuild the
+  // deepest ancestor whose children have become lopsided
+  double max_depth = log(static_cast<double>(states_.size()))
+                     / log(1. / BALANCE_ALPHA) + 1.;
+  if (static_cast<double>(path.size()) <= max_depth) return true;
+
+  int child_size = 1;
+  for (int i = path.size() - 1; i >= 0; --i) {
+    Node const &ancestor = nodes_[path[i]];
+    if (child_size > BALANCE_ALPHA * ancestor.size_) {
+      int new_root = RebuildSubtree(path[i]);
+      if (i == 0) {
+        root_ = new_root;
+      } else {
+        Node &parent = nodes_[path[i - 1]];
+        if (parent.left_ == path[i])
+          parent.left_ = new_root;
+        else
+          parent.right_ = new_root;
+      }
+      break;
+    }
+    child_size = ancestor.size_;
+  }
+
+  return true;
+}
+
+void KdTree::Clear() {
+  root_ = -1;
+  states_.clear();
+  nodes_.clear();
+}
+
+int KdTree::RebuildSubtree(int node) {
+  std::vector<unsigned int> node_slots;
+  std::vector<unsigned int> points;
+  CollectSubtree(node, &node_slots, &points);
+
+  unsigned int next_slot = 0;
+  return BuildBalanced(&points, 0, points.size(), node_slots, &next_slot);
+}
+
+void KdTree::CollectSubtree(int node, std::vector<unsigned int> *node_slots,
+                            std::vector<unsigned int> *points) const {
+  std::vector<int> pending;
+  pending.push_back(node);
+  while (!pending.empty()) {
+    int cur = pending.back();
+    pending.pop_back();
+    if (cur < 0) continue;
+    node_slots->push_back(cur);
+    points->push_back(nodes_[cur].point_);
+    pending.push_back(nodes_[cur].left_);
+    pending.push_back(nodes_[cur].right_);
+  }
+}
+
+int KdTree::BuildBalanced(std::vector<unsigned int> *points,
+                          unsigned int begin, unsigned int end,
+                          std::vector<unsigned int> const &node_slots,
+                          unsigned int *next_slot) {
+  if (begin >= end) return -1;
+
+  // Split on the dimension with the widest spread of values
+  unsigned int dimensions = arena_->get_dimensions();
+  unsigned int split_dim = 0;
+  double widest_spread = -1.;
+  for (unsigned int dim = 0; dim < dimensions; ++dim) {
+    double low = Point((*points)[begin])[dim];
+    double high = low;
+    for (unsigned int i = begin + 1; i < end; ++i) {
+      double val = Point((*points)[i])[dim];
+      if (val < low) low = val;
+      if (val > high) high = val;
+    }
+    if (high - low > widest_spread) {
+      widest_spread = high - low;
+      split_dim = dim;
+    }
+  }
+
+  unsigned int median = begin + (end - begin) / 2;
+  std::nth_element(points->begin() + begin, points->begin() + median,
+                   points->begin() + end,
+                   PointCoordinateLess(arena_, split_dim));
+
+  int slot = node_slots[(*next_slot)++];
+  nodes_[slot].point_ = (*points)[median];
+  nodes_[slot].split_dim_ = split_dim;
+  nodes_[slot].size_ = end - begin;
+  int left = BuildBalanced(points, begin, median, node_slots, next_slot);
+  int right = BuildBalanced(points, median + 1, end, node_slots, next_slot);
+  nodes_[slot].left_ = left;
+  nodes_[slot].right_ = right;
+  return slot;
+}
+
+void KdTree::QueryBox(double const *center, unsigned int dimensions,
+                      std::vector<double> const &squared_radii,
+                      std::vector<State *> *results) const {
+  if (root_ < 0 || dimensions != get_dimensions()) return;
+
+  // Unconstrained dimensions get an infinite radius. Split-plane pruning
+  // uses a slightly padded radius so sqrt rounding never drops a boundary
+  // point; the exact squared test is done per point.
+  std::vector<double> radii(2 * dimensions, HUGE_VAL);
+  for (unsigned int dim = 0; dim < dimensions
+       && dim < squared_radii.size(); ++dim) {
+    radii[dim] = squared_radii[dim];
+    radii[dimensions + dim] = sqrt(squared_radii[dim]) * (1. + 1E-9)
+                              + 1E-300;
+  }
+
+  std::vector<unsigned int> matches;
+  QueryBox(root_, center, &radii[0], &matches);
+
+  std::sort(matches.begin(), matches.end());
+  std::vector<unsigned int>::iterator iter;
+  for (iter = matches.begin(); iter != matches.end(); ++iter) {
+    results->push_back(states_[*iter]);
+  }
+}
+
+void KdTree::QueryBox(int node, double const *center, double const *radii,
+                      std::vector<unsigned int> *matches) const {
+  unsigned int dimensions = arena_->get_dimensions();
+  while (node >= 0) {
+    Node const &cur = nodes_[node];
+    double const *point = Point(cur.point_);
+
+    if (DistanceKernel::WithinThresholds(point, center, radii, dimensions))
+      matches->push_back(cur.point_);
+
+    unsigned int dim = cur.split_dim_;
+    double padded_radius = radii[dimensions + dim];
+    bool visit_left = center[dim] - padded_radius <= point[dim];
+    bool visit_right = center[dim] + padded_radius >= point[dim];
+
+    // Recurse on one side, loop on the other
+    if (visit_left && visit_right) {
+      QueryBox(cur.left_, center, radii, matches);
+      node = cur.right_;
+    } else if (visit_left) {
+      node = cur.left_;
+    } else if (visit_right) {
+      node = cur.right_;
+    } else {
+      node = -1;
+    }
+  }
+}
+
+State *KdTree::Nearest(double const *query, unsigned int dimensions,
+                       double *squared_distance) const {
+  if (root_ < 0 || dimensions != get_dimensions()) return NULL;
+
+  unsigned int best = states_.size();
+  double best_distance = HUGE_VAL;
+  Nearest(root_, query, &best, &best_distance);
+  if (best == states_.size()) return NULL;
+
+  if (squared_distance) *squared_distance = best_distance;
+  return states_[best];
+}
+
+void KdTree::Nearest(int node, double const *query, unsigned int *best,
+                     double *best_distance) const {
+  if (node < 0) return;
+  Node const &cur = nodes_[node];
+  double const *point = Point(cur.point_);
+
+  double distance = DistanceKernel::SquaredDistance(
+    point, query, arena_->get_dimensions());
+
+  // Ties go to the earliest inserted state, like a front-to-back scan
+  if (distance < *best_distance
+      || (distance == *best_distance && cur.point_ < *best)) {
+    *best_distance = distance;
+    *best = cur.point_;
+  }
+
+  unsigned int dim = cur.split_dim_;
+  double plane_dist = query[dim] - point[dim];
+  int near_side = (plane_dist < 0) ? cur.left_ : cur.right_;
+  int far_side = (plane_dist < 0) ? cur.right_ : cur.left_;
+
+  Nearest(near_side, query, best, best_distance);
+  if (plane_dist * plane_dist <= *best_distance)
+    Nearest(far_side, query, best, best_distance);
+}
+
+}  // namespace Primitives
@@ -0,0 +1,136 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for a k-d tree spatial index over QTable states,
+ * answering per-dimension box queries and nearest neighbour queries.
+ *
+ * The tree is kept balanced scapegoat-style: whenever an insertion lands
+ * too deep, the smallest unbalanced subtree on its path is rebuilt around
+ * its medians. That keeps queries logarithmic even though demonstration
+ * data arrives as long, nearly monotone trajectories.
+ *
+ * Coordinates are read straight out of the QTable's StateArena, so the tree
+ * itself only stores node links; point numbers are arena row numbers.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_KDTREE_H_
+#define _SHL_PRIMITIVES_QLEARNER_KDTREE_H_
+
+#include <vector>
+#include "QLearner/StateArena.h"
+
+namespace Primitives {
+
+class State;
+
+class KdTree {
+ public:
+  /**
+   * @param arena Storage holding the coordinates of every indexed state.
+   *              Must outlive the tree.
+   **/
+  explicit KdTree(StateArena const *arena) : arena_(arena), root_(-1) {}
+
+  /**
+   * Adds a state to the index at the position stored in arena row. Rows
+   * must be inserted in order, starting from 0.
+   *
+   * @param state QTable-internal state to associate with the row
+   * @param row Arena row holding the state vector of state
+   * @return false (and nothing inserted) if row is out of sequence
+   **/
+  bool Insert(State *state, unsigned int row);
+
+  /**
+   * Finds every state whose squared distance to center is within
+   * squared_radii[i] in each dimension i. Dimensions without a radius are
+   * unconstrained. Results are appended in insertion order.
+   *
+   * @param center Point to search around
+   * @param dimensions Number of values in center
+   * @param squared_radii Squared per-dimension search distances
+   * @param results Populated with matching states
+   **/
+  void QueryBox(double const *center, unsigned int dimensions,
+                std::vector<double> const &squared_radii,
+                std::vector<State *> *results) const;
+
+  /**
+   * Finds the state with the smallest squared euclidean distance to query
+   *
+   * @param query Point to search around
+   * @param dimensions Number of values in query
+   * @param squared_distance Populated with the squared distance found
+   * @return Nearest state, or NULL if the tree is empty or query has the
+   *         wrong dimensions
+   **/
+  State *Nearest(double const *query, unsigned int dimensions,
+                 double *squared_distance) const;
+
+  /**
+   * Removes every state from the index
+   **/
+  void Clear();
+
+  unsigned int size() const { return states_.size(); }
+  unsigned int get_dimensions() const {
+    return states_.empty() ? 0 : arena_->get_dimensions();
+  }
+
+ private:
+  /**
+   * A node holds exactly one point and splits its subtree on split_dim_:
+   * points in left_ are <= the node's value, points in right_ are >= it.
+   **/
+  struct Node {
+    unsigned int point_;
+    unsigned int split_dim_;
+    unsigned int size_;
+    int left_;
+    int right_;
+  };
+
+  double const *Point(unsigned int point) const {
+    return arena_->Row(point);
+  }
+
+  /**
+   * Rebuilds the subtree rooted at node into a balanced tree, reusing the
+   * same node slots
+   *
+   * @return index of the new subtree root
+   **/
+  int RebuildSubtree(int node);
+
+  void CollectSubtree(int node, std::vector<unsigned int> *node_slots,
+                      std::vector<unsigned int> *points) const;
+
+  int BuildBalanced(std::vector<unsigned int> *points,
+                    unsigned int begin, unsigned int end,
+                    std::vector<unsigned int> const &node_slots,
+                    unsigned int *next_slot);
+
+  void QueryBox(int node, double const *center, double const *radii,
+                std::vector<unsigned int> *matches) const;
+
+  void Nearest(int node, double const *query, unsigned int *best,
+               double *best_distance) const;
+
+  StateArena const *arena_;
+  int root_;
+
+  /**
+   * State associated with each point, indexed by point (arena row) number
+   **/
+  std::vector<State *> states_;
+
+  std::vector<Node> nodes_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_KDTREE_H_
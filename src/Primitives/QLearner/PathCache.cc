@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of the QTable path cache
+ **/
+
+#include "QLearner/PathCache.h"
+#include "QLearner/State.h"
+#include "QLearner/TransitionGraph.h"
+
+namespace Primitives {
+
+bool PathCache::Lookup(TransitionGraph const &graph, unsigned int start,
+                       unsigned int goal, std::vector<unsigned int> *path) {
+  std::map<EntryKey, Entry>::iterator iter =
+    entries_.find(std::make_pair(start, goal));
+  if (iter == entries_.end()) {
+    ++misses_;
+    return false;
+  }
+  if (IsStale(graph, iter->second)) {
+    entries_.erase(iter);
+    ++misses_;
+    return false;
+  }
+
+  // Everything up to now has been checked, so later lookups only need to
+  // look at changes made after this one
+  iter->second.version_ = graph.get_version();
+  iter->second.node_count_ = graph.size();
+
+  *path = iter->second.path_;
+  ++hits_;
+  return true;
+}
+
+void PathCache::Store(TransitionGraph const &graph, unsigned int start,
+                      unsigned int goal, std::vector<unsigned int> const &path,
+                      std::vector<unsigned int> const &walked) {
+  // Starting over keeps the cache bounded without tracking recency
+  EntryKey key = std::make_pair(start, goal);
+  if (entries_.size() >= max_entries_ && entries_.count(key) == 0)
+    entries_.clear();
+
+  Entry &entry = entries_[key];
+  entry.path_ = path;
+  entry.version_ = graph.get_version();
+  entry.structure_version_ = graph.get_structure_version();
+  entry.node_count_ = graph.size();
+  entry.cost_ = 0.;
+  entry.walked_.clear();
+
+  if (dependency_ == DEPENDS_ON_LINKS) {
+    entry.walked_ = walked;
+  } else {
+    for (unsigned int i = 1; i < path.size(); ++i) {
+      entry.cost_ += graph.get_state(path[i - 1])->GetEuclideanDistance(
+        graph.get_state(path[i]));
+    }
+  }
+}
+
+bool PathCache::IsStale(TransitionGraph const &graph,
+                        Entry const &entry) const {
+  // A graph that went backwards was cleared or replaced outright
+  if (graph.get_version() < entry.version_
+      || graph.size() < entry.node_count_
+      || graph.get_structure_version() != entry.structure_version_)
+    return true;
+
+  if (dependency_ == DEPENDS_ON_LINKS) {
+    std::vector<unsigned int>::const_iterator iter;
+    for (iter = entry.walked_.begin(); iter != entry.walked_.end(); ++iter) {
+      if (graph.get_node_version(*iter) > entry.version_) return true;
+    }
+    return false;
+  }
+
+  // Any new state might connect an unreachable goal
+  if (graph.size() == entry.node_count_) return false;
+  if (entry.path_.empty()) return true;
+
+  // Path costs are Euclidean, so a route through a new state costs at least
+  // its straight-line distance from start plus that to goal. States outside
+  // that ellipse can't shorten the path.
+  State *start = graph.get_state(entry.path_.front());
+  State *goal = graph.get_state(entry.path_.back());
+  for (unsigned int id = entry.node_count_; id < graph.size(); ++id) {
+    State *added = graph.get_state(id);
+    if (start->GetEuclideanDistance(added) + added->GetEuclideanDistance(goal)
+        < entry.cost_)
+      return true;
+  }
+  return false;
+}
+
+}  // namespace Primitives
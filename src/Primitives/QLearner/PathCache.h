@@ -0,0 +1,118 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for a cache of planned paths through one QTable's
+ * transition graph, keyed by start and goal state id.
+ *
+ * Entries are checked against the graph's version counters on lookup
+ * rather than flushed on every change, so a change only evicts the paths
+ * it could actually affect:
+ *
+ *  - DEPENDS_ON_LINKS paths follow reward links (greedy execution), and go
+ *    stale once the links out of any state they walked through change.
+ *  - DEPENDS_ON_DISTANCES paths are shortest paths between nearby states
+ *    (A* search), and go stale once a state is added close enough to the
+ *    start and goal to shorten them. Reward changes never affect them.
+ *
+ * Either kind goes stale when the graph's structure version changes (goal
+ * states, initiate states or nearby thresholds).
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_PATHCACHE_H_
+#define _SHL_PRIMITIVES_QLEARNER_PATHCACHE_H_
+
+#include <stdint.h>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Primitives {
+
+class TransitionGraph;
+
+class PathCache {
+ public:
+  enum Dependency {
+    DEPENDS_ON_LINKS,
+    DEPENDS_ON_DISTANCES
+  };
+
+  /**
+   * Goal id for paths that end at whichever goal is reached first. Only
+   * meaningful for DEPENDS_ON_LINKS caches.
+   **/
+  static const unsigned int ANY_GOAL = 0xFFFFFFFF;
+
+  /**
+   * Entries kept before the cache starts over
+   **/
+  static const unsigned int DEFAULT_MAX_ENTRIES = 1024;
+
+  explicit PathCache(Dependency dependency,
+                     unsigned int max_entries = DEFAULT_MAX_ENTRIES)
+    : dependency_(dependency), max_entries_(max_entries), hits_(0),
+      misses_(0) {}
+
+  /**
+   * Looks up the path from start to goal, evicting it if it is stale
+   *
+   * @param path Populated with the path's state ids from start to goal, or
+   *             emptied if goal was found to be unreachable
+   * @return false if there is no current entry
+   **/
+  bool Lookup(TransitionGraph const &graph, unsigned int start,
+              unsigned int goal, std::vector<unsigned int> *path);
+
+  /**
+   * Caches the path from start to goal, replacing any earlier entry
+   *
+   * @param path State ids from start to goal, empty if goal is unreachable
+   * @param walked For DEPENDS_ON_LINKS, ids of the states whose links were
+   *               read to find path; ignored for DEPENDS_ON_DISTANCES
+   **/
+  void Store(TransitionGraph const &graph, unsigned int start,
+             unsigned int goal, std::vector<unsigned int> const &path,
+             std::vector<unsigned int> const &walked =
+               std::vector<unsigned int>());
+
+  /**
+   * Drops every entry, e.g. when the table behind the graph is replaced
+   **/
+  void Clear() { entries_.clear(); }
+
+  unsigned int size() const { return entries_.size(); }
+  unsigned int get_hits() const { return hits_; }
+  unsigned int get_misses() const { return misses_; }
+
+ private:
+  struct Entry {
+    std::vector<unsigned int> path_;
+    std::vector<unsigned int> walked_;
+    uint64_t version_;
+    uint64_t structure_version_;
+    unsigned int node_count_;
+    double cost_;
+  };
+
+  typedef std::pair<unsigned int, unsigned int> EntryKey;
+
+  /**
+   * @return true if a change to graph since entry was stored may have
+   *         changed its path
+   **/
+  bool IsStale(TransitionGraph const &graph, Entry const &entry) const;
+
+  Dependency dependency_;
+  unsigned int max_entries_;
+  std::map<EntryKey, Entry> entries_;
+  unsigned int hits_;
+  unsigned int misses_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_PATHCACHE_H_
@@ -0,0 +1,162 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the QTable path cache
+ **/
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "QLearner/PathCache.h"
+#include "QLearner/QTable.h"
+#include "QLearner/State.h"
+#include "QLearner/TransitionGraph.h"
+
+namespace Primitives {
+
+class PathCacheTest : public testing::Test {
+ protected:
+  PathCacheTest() {
+    for (int i = 0; i < 5; ++i) {
+      std::vector<double> state_vector(2, static_cast<double>(i));
+      states_.push_back(q_table_.AddState(State(state_vector)));
+    }
+  }
+
+  State *AddState(double x, double y) {
+    std::vector<double> state_vector;
+    state_vector.push_back(x);
+    state_vector.push_back(y);
+    return q_table_.AddState(State(state_vector));
+  }
+
+  std::vector<unsigned int> Ids(unsigned int first, unsigned int last) {
+    std::vector<unsigned int> ids;
+    for (unsigned int i = first; i <= last; ++i)
+      ids.push_back(states_[i]->get_graph_id());
+    return ids;
+  }
+
+  QTable q_table_;
+  std::vector<State *> states_;
+};
+
+/**
+ * @test    Link-following paths only go stale when links out of the states
+ *          they walked change, or the table's goals do
+ **/
+TEST_F(PathCacheTest, LinkDependencies) {
+  TransitionGraph &graph = q_table_.get_graph();
+  PathCache cache(PathCache::DEPENDS_ON_LINKS);
+  std::vector<unsigned int> path;
+  EXPECT_FALSE(cache.Lookup(graph, 0, PathCache::ANY_GOAL, &path));
+
+  for (unsigned int i = 0; i < 3; ++i)
+    states_[i]->set_reward(states_[i + 1], Registry::LAYER_BASE, 1.);
+  cache.Store(graph, 0, PathCache::ANY_GOAL, Ids(0, 3), Ids(0, 2));
+  ASSERT_TRUE(cache.Lookup(graph, 0, PathCache::ANY_GOAL, &path));
+  EXPECT_EQ(Ids(0, 3), path);
+
+  // Links elsewhere, new states and rewrites of the same value are distant
+  states_[3]->set_reward(states_[4], Registry::LAYER_BASE, 1.);
+  states_[4]->ConnectState(states_[0], Registry::ACTION_INTERPOLATE, 1);
+  states_[1]->set_reward(states_[2], Registry::LAYER_BASE, 1.);
+  AddState(7., 7.);
+  EXPECT_TRUE(cache.Lookup(graph, 0, PathCache::ANY_GOAL, &path));
+
+  states_[1]->set_reward(states_[4], Registry::LAYER_WAYPOINT, 2.);
+  EXPECT_FALSE(cache.Lookup(graph, 0, PathCache::ANY_GOAL, &path));
+  EXPECT_EQ(0u, cache.size());
+
+  // Unreachable results are cached too, and table-wide changes evict them
+  cache.Store(graph, 0, PathCache::ANY_GOAL, std::vector<unsigned int>(),
+              Ids(0, 0));
+  ASSERT_TRUE(cache.Lookup(graph, 0, PathCache::ANY_GOAL, &path));
+  EXPECT_TRUE(path.empty());
+  q_table_.AddGoalState(states_[4], true);
+  EXPECT_FALSE(cache.Lookup(graph, 0, PathCache::ANY_GOAL, &path));
+
+  EXPECT_EQ(3u, cache.get_hits());
+  EXPECT_EQ(3u, cache.get_misses());
+}
+
+/**
+ * @test    Shortest paths only go stale when a state is added that could
+ *          shorten them, and never on reward changes
+ **/
+TEST_F(PathCacheTest, DistanceDependencies) {
+  TransitionGraph &graph = q_table_.get_graph();
+  PathCache cache(PathCache::DEPENDS_ON_DISTANCES);
+  State *middle = AddState(1., 0.);
+  State *end = AddState(2., 0.);
+  unsigned int start_id = states_[0]->get_graph_id();
+  unsigned int end_id = end->get_graph_id();
+
+  // The long way round, 0,0 -> 1,1 -> 2,0, and the straight path from 1,0
+  std::vector<unsigned int> long_way;
+  long_way.push_back(start_id);
+  long_way.push_back(states_[1]->get_graph_id());
+  long_way.push_back(end_id);
+  cache.Store(graph, start_id, end_id, long_way);
+
+  std::vector<unsigned int> straight;
+  straight.push_back(middle->get_graph_id());
+  straight.push_back(end_id);
+  cache.Store(graph, middle->get_graph_id(), end_id, straight);
+  cache.Store(graph, start_id, states_[4]->get_graph_id(),
+              std::vector<unsigned int>());
+
+  std::vector<unsigned int> path;
+  states_[0]->set_reward(states_[1], Registry::LAYER_BASE, 5.);
+  AddState(40., -40.);
+  ASSERT_TRUE(cache.Lookup(graph, start_id, end_id, &path));
+  EXPECT_EQ(long_way, path);
+
+  // New states might connect an unreachable goal
+  EXPECT_FALSE(cache.Lookup(graph, start_id, states_[4]->get_graph_id(),
+                            &path));
+
+  // A state just off the line from 0,0 to 2,0 can shorten the long way,
+  // but not the straight path
+  AddState(1., .2);
+  EXPECT_TRUE(cache.Lookup(graph, middle->get_graph_id(), end_id, &path));
+  EXPECT_FALSE(cache.Lookup(graph, start_id, end_id, &path));
+
+  q_table_.set_nearby_thresholds(std::vector<double>(2, 2.));
+  EXPECT_FALSE(cache.Lookup(graph, middle->get_graph_id(), end_id, &path));
+}
+
+/**
+ * @test    Versions never go backwards, and entries from before a clear are
+ *          never served
+ **/
+TEST_F(PathCacheTest, ClearedGraph) {
+  TransitionGraph graph;
+  for (unsigned int i = 0; i < states_.size(); ++i)
+    graph.AddNode(states_[i]);
+  PathCache cache(PathCache::DEPENDS_ON_LINKS, 2);
+  cache.Store(graph, 0, 1, Ids(0, 1), Ids(0, 0));
+  cache.Store(graph, 1, 2, Ids(1, 2), Ids(1, 1));
+  cache.Store(graph, 1, 2, Ids(1, 2), Ids(1, 1));
+  EXPECT_EQ(2u, cache.size());
+  cache.Store(graph, 2, 3, Ids(2, 3), Ids(2, 2));
+  EXPECT_EQ(1u, cache.size());
+
+  uint64_t version = graph.get_version();
+  graph.Clear();
+  EXPECT_LT(version, graph.get_version());
+  for (unsigned int i = 0; i < states_.size(); ++i)
+    graph.AddNode(states_[i]);
+  std::vector<unsigned int> path;
+  EXPECT_FALSE(cache.Lookup(graph, 2, 3, &path));
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
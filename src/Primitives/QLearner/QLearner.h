@@ -14,14 +14,15 @@
 #include <sys/time.h>
 #include <string>
 #include <vector>
-#include <stack>
 #include <fstream>
 #include <iostream>
 #include "QLearner/State.h"
-#include "QLearner/StateHistoryTuple.h"
+#include "QLearner/StateHistory.h"
 #include "Exploration/ExplorationType.h"
 #include "Credit/CreditAssignmentType.h"
 #include "QLearner/QTable.h"
+#include "QLearner/RewardOverlay.h"
+#include "QLearner/DistanceKernel.h"
 #include "QLearner/Object.h"
 #include "QLearner/Condition.h"
 #include "Common/Utils.h"
@@ -46,6 +47,14 @@ public:
     StateSatisfiesPostConditions = &QLearner::always_false;
   }
 
+  /**
+   * As above, starting from a copy of q_table's states and goal states
+   **/
+  explicit QLearner(QTable *q_table) : q_table_(q_table) {
+    StateSatisfiesPreConditions = &QLearner::always_false;
+    StateSatisfiesPostConditions = &QLearner::always_false;
+  }
+
 
   /**
    * Destructor for QLearner must free all memory it received from I/O and
@@ -162,6 +171,19 @@ public:
                             State **next_state,
                             double &reward) = 0;
 
+  /**
+   * Returns the chosen next step with transitions judged through overlay
+   * instead of the QTable alone
+   *
+   * @param     overlay         Rewards to consult, or NULL for the QTable's
+   *
+   * @return True on success, false on lookup error
+   **/
+  virtual bool GetNextState(State *cur_state,
+                            State **next_state,
+                            double &reward,
+                            RewardOverlay *overlay) = 0;
+
   /**
    * Sets the credit assignment type used by this QLearner. Provided object
    * will get a pointer back to this object to allow it to use all
@@ -217,7 +239,8 @@ public:
   virtual bool AssignCredit(double signal) = 0;
 
   /**
-   * Updates the state_history_ stack to reflect this system state
+   * Records this system state in state_history_, which keeps only the most
+   * recent states (see StateHistory)
    *
    * @param state Current state of the system
    **/
@@ -225,8 +248,7 @@ public:
     timeval now;
     gettimeofday(&now, NULL);
     double millis = (now.tv_sec*1000.) + (now.tv_usec/1000.);
-    StateHistoryTuple sht(state, millis);
-    state_history_.push(sht);
+    state_history_.Push(state, millis);
   }
 
   /**
@@ -266,38 +288,31 @@ public:
 
     best_distance = 1E10;
 
+    vector<double> const &nearby_thresholds =
+      q_table_.get_nearby_thresholds();
+    unsigned int dimensions = state.get_dimensions();
+    unsigned int checked_dims = dimensions;
+    if (nearby_thresholds.size() < checked_dims)
+      checked_dims = nearby_thresholds.size();
+
     // Iterate through all candidate goal states...
     for (state_iter = goal_states.begin(); state_iter != goal_states.end();
          ++state_iter) {
-      bool state_fail = false;
-      std::vector<double> dists = state.GetSquaredDistances(*state_iter);
-
-      vector<double> const &nearby_thresholds =
-        q_table_.get_nearby_thresholds();
+      if ((*state_iter)->get_dimensions() != dimensions) continue;
 
+      // Sum each sensor value's distance in units of its nearby threshold,
+      // checking for violation of near-ness along the way
+      bool state_near = true;
       double tmp_distance = 0.;
-
-      // Check each sensor value distance for violation of near-ness
-      for (unsigned int idx = 0;
-           idx < dists.size() && idx < nearby_thresholds.size();
-           ++idx) {
-        double sensor_unit_dist = nearby_thresholds[idx];
-        double distance = dists[idx];
-
-        tmp_distance += distance / sensor_unit_dist;
-        if (distance > sensor_unit_dist * sensitivity) {
-          // Uncomment to get debugging info about distance threshold checks
-          // double dist_val = distance - (sensor_unit_dist * sensitivity);
-          // char buf[1024];
-          // snprintf(buf,1024,"State too far from goal by %g.",dist_val);
-          // Log(stderr,DEBUG,buf);
-          state_fail = true;
-        }
+      if (checked_dims > 0) {
+        tmp_distance = DistanceKernel::ScaledSquaredDistance(
+          state.get_values(), (*state_iter)->get_values(),
+          &nearby_thresholds[0], sensitivity, checked_dims, &state_near);
       }
 
-      tmp_distance /= dists.size();
+      tmp_distance /= dimensions;
       if (tmp_distance < best_distance) best_distance = tmp_distance;
-      if (!state_fail) return true;
+      if (state_near) return true;
     }
     return false;
   }
@@ -317,18 +332,16 @@ public:
   }
 
   /**
-   * Returns a stack of recently visited states
+   * Returns the ring of recently visited states, newest first
    *
-   * @return Stack of StateHistoryTuple
+   * @return Bounded state history
    **/
-  virtual std::stack<StateHistoryTuple> &get_state_history() {
+  virtual StateHistory &get_state_history() {
     return state_history_;
   }
 
   virtual State *get_current_state() {
-    if (state_history_.size())
-      return state_history_.top().state_;
-    return NULL;
+    return state_history_.top();
   }
 
   virtual QTable *get_q_table() {
@@ -386,7 +399,7 @@ public:
   }
 
 protected:
-  std::stack<StateHistoryTuple> state_history_;
+  StateHistory state_history_;
   QTable q_table_;
   int trials_;
   double anticipated_duration_;
@@ -13,67 +13,84 @@
 #include <map>
 #include "QLearner/QTable.h"
 #include "QLearner/State.h"
+#include "QLearner/DistanceKernel.h"
 
 namespace Primitives {
 
 
 std::vector<State*> QTable::GetNearbyStates(State const &needle) {
-  std::vector<State*> nearby_states;
+  return this->GetNearbyStates(needle, nearby_thresholds_);
+}
 
-  std::vector<State*>::iterator iter;
+std::vector<State*> QTable::GetNearbyStates(
+  State const &needle, std::vector<double> const &squared_thresholds) {
+  std::vector<State*> nearby_states;
+  spatial_index_.QueryBox(needle.get_values(), needle.get_dimensions(),
+                          squared_thresholds, &nearby_states);
+  return nearby_states;
+}
 
-  for (iter = states_.begin(); iter != states_.end(); ++iter) {
-    std::vector<double> dists = needle.GetSquaredDistances((*iter));
-
-    bool fail = false;
-    unsigned int idx;
-    for (idx = 0; idx < nearby_thresholds_.size(); ++idx) {
-      double squared_thresh = nearby_thresholds_[idx];
-      double squared_dist = dists[idx];
-      if (squared_dist > squared_thresh) {
-        fail = true;
-        break;
-      }
-    }
+void QTable::GetNearbyStates(State const &needle,
+                             std::vector<State*> *nearby_states) {
+  nearby_states->clear();
+  spatial_index_.QueryBox(needle.get_values(), needle.get_dimensions(),
+                          nearby_thresholds_, nearby_states);
+}
 
-    if (!fail) nearby_states.push_back(*iter);
+State *QTable::GetNearestState(State const &state,
+                               vector<State*> const &candidates) {
+  // Searching the whole table can use the spatial index
+  if (&candidates == &states_) return this->GetNearestState(state);
+
+  // Gather the candidate vectors so the kernel can scan them in one pass
+  unsigned int dimensions = state.get_dimensions();
+  std::vector<double const *> rows;
+  std::vector<State *> row_states;
+  rows.reserve(candidates.size());
+  row_states.reserve(candidates.size());
+  vector<State*>::const_iterator iter;
+  for (iter = candidates.begin(); iter != candidates.end(); ++iter) {
+    if ((*iter)->get_dimensions() != dimensions) continue;
+    rows.push_back((*iter)->get_values());
+    row_states.push_back(*iter);
   }
+  if (rows.empty()) return NULL;
 
-  return nearby_states;
+  unsigned int best = DistanceKernel::NearestRow(state.get_values(), &rows[0],
+                                                 rows.size(), dimensions,
+                                                 NULL);
+  return row_states[best];
 }
 
-State *QTable::GetState(std::string needle_hash) {
-  std::vector<State *>::iterator iter;
-  for (iter = states_.begin(); iter != states_.end(); iter++) {
-    if (*iter == NULL) continue;  // Shouldn't have deleted states in the table
-    std::string state_hash = (*iter)->get_state_hash();
-    if (needle_hash.compare(state_hash) == 0)
-      return (*iter);
-  }  
-  return NULL;
+State *QTable::GetNearestState(State const &state) {
+  return spatial_index_.Nearest(state.get_values(), state.get_dimensions(),
+                                NULL);
 }
 
-State *QTable::GetState(State const &needle, bool add_estimated_state) {
-  // Search through the huge states_ vector for the target state
+State *QTable::GetState(uint64_t needle_hash) {
+  if (!bloom_filter_.MightContain(needle_hash)) return NULL;
 
-  std::vector<double> nearby_state_dists = this->get_nearby_thresholds();
-  std::vector<State *>::iterator iter;
-  for (iter = states_.begin(); iter != states_.end(); iter++) {
-    if (*iter == NULL) continue;  // Shouldn't have deleted states in the table
+  std::tr1::unordered_multimap<uint64_t, State *>::iterator found =
+    state_index_.find(needle_hash);
+  if (found == state_index_.end()) return NULL;
+  return found->second;
+}
 
-    if (needle.Equals(*iter))
-      return (*iter);
+State *QTable::GetState(State const &needle, bool add_estimated_state) {
+  // Look up the target state by hash instead of searching the states_ vector,
+  // skipping the lookup entirely if the bloom filter has never seen it
+  std::vector<double> nearby_state_dists = this->get_nearby_thresholds();
+  if (this->HasState(needle)) {
+    State *found = FindIndexedState(needle);
+    if (found) return found;
   }
 
-
   // Log(stderr,DEBUG,"State not found in GetState.");
 
   if (add_estimated_state) {
-    State s(needle.get_state_vector());
-    State *new_state = this->AddState(s);
+    State *new_state = this->AddState(needle);
 
-    if (new_state->get_state_vector().size() !=
-        needle.get_state_vector().size())
+    if (new_state->get_dimensions() != needle.get_dimensions())
       Log(stderr, ERROR,
           "AddState portion of GetState didn't copy the vector.");
 
@@ -95,61 +112,59 @@ State *QTable::GetState(State const &needle, bool add_estimated_state) {
 
       // Calculate the weight of the transition rewards from the new state
       // based on distance to this nearby, pre-existing state
-      std::vector<double> squared_dists =
-        needle.GetSquaredDistances(*nearby_iter);
-
-      double weight = 0.;
-      unsigned int idx;
-      for (idx = 0;
-          idx < nearby_state_dists.size() && idx < squared_dists.size();
-          ++idx) {
-        weight += 1. - (squared_dists[idx] / nearby_state_dists[idx]);
-      }
-      weight /= squared_dists.size();
+      unsigned int dimensions = needle.get_dimensions();
+      unsigned int weighted_dims = dimensions;
+      if (nearby_state_dists.size() < weighted_dims)
+        weighted_dims = nearby_state_dists.size();
+
+      double weight = weighted_dims;
+      if (weighted_dims > 0)
+        weight -= DistanceKernel::ScaledSquaredDistance(
+          needle.get_values(), near_state->get_values(),
+          &nearby_state_dists[0], 1., weighted_dims, NULL);
+      weight /= dimensions;
       
       // Add the same incoming reward transitions as the found state, reward
       // value weighted by the distance of the found state from the needle state
       // --Only transfer the 'base' layer--
-      vector<State *> & inc_states = near_state->get_incoming_states();
-      vector<State *>::iterator inc_iter;
-      for (inc_iter = inc_states.begin(); inc_iter != inc_states.end();
+      // Linking new_state appends edges, which can compact the graph under a
+      // live iterator, so stage near_state's links in link_scratch_ first
+      link_scratch_.clear();
+      TransitionGraph::IncomingLinkIterator inc_iter;
+      for (inc_iter = near_state->IncomingLinks(); inc_iter.valid();
            ++inc_iter) {
-        State *inc_state = (*inc_iter);
-        double orig_reward = inc_state->GetRewardValue(
-                                near_state, false, "base");
-        inc_state->set_reward(new_state, string("base"), orig_reward * weight);
+        State *inc_state = inc_iter.source();
+        link_scratch_.push_back(std::make_pair(
+          inc_state, inc_state->GetRewardValue(near_state,
+                                               Registry::LAYER_BASE)));
+      }
+      for (unsigned int i = 0; i < link_scratch_.size(); ++i) {
+        link_scratch_[i].first->set_reward(new_state, Registry::LAYER_BASE,
+                                           link_scratch_[i].second * weight);
       }
 
       // Add the same outgoing reward transitions as the found state, reward
       // weighted by the distance of the found state from the needle state
       // --Only transfer the 'base' layer--
-      std::map<State*, std::map<std::string, double> > const &rewards
-        = near_state->get_reward();
-
-      std::map<State*, std::map<std::string, double> >::const_iterator
-        state_reward_iter;
-
-      std::string base_layer = string("base");
+      link_scratch_.clear();
+      TransitionGraph::RewardLinkIterator reward_iter;
+      for (reward_iter = near_state->RewardLinks(); reward_iter.valid();
+           ++reward_iter) {
+        link_scratch_.push_back(std::make_pair(
+          reward_iter.target(), reward_iter.reward(Registry::LAYER_BASE)));
+      }
 
-      // iterate through each state near_state links to, and copy the base
-      // reward layer to the new state
-      for (state_reward_iter = rewards.begin();
-           state_reward_iter != rewards.end();
-           ++state_reward_iter) {
-          State *target_state = (*state_reward_iter).first;
-          std::map<std::string, double> const &reward_layers =
-            (*state_reward_iter).second;
+      for (unsigned int i = 0; i < link_scratch_.size(); ++i) {
+          State *target_state = link_scratch_[i].first;
 
           double base_reward = 1.;
-          std::map<std::string, double>::const_iterator reward_layer =
-            reward_layers.find(base_layer);
-          if (reward_layer != reward_layers.end()) {
-            base_reward = (*reward_layer).second * weight;
-          }
+          if (link_scratch_[i].second != 0.)
+            base_reward = link_scratch_[i].second * weight;
 
-          if (new_state->GetRewardValue(target_state, false, "base") <
+          if (new_state->GetRewardValue(target_state, Registry::LAYER_BASE) <
               base_reward)
-            new_state->set_reward(target_state, base_layer, base_reward);
+            new_state->set_reward(target_state, Registry::LAYER_BASE,
+                                  base_reward);
       }
     }
 
@@ -162,24 +177,87 @@ State *QTable::GetState(State const &needle, bool add_estimated_state) {
 
 
 /**
- * @todo
- * Use a bloom filter to find whether or not the QTable contains the needle.
+ * Uses a bloom filter to find whether or not the QTable contains the needle.
  * Returning true here doesn't actually mean we have the state, it just means
- * that we probably have it, and it's worth the cycles to search for it in the
- * big mess that is the states_ vector.
+ * that we probably have it, and it's worth the cycles to search for it.
  *
  * Returning a value of false means we absolutely 100% have not seen that state.
  **/
 bool QTable::HasState(State const &needle) {
-  return true;
+  return bloom_filter_.MightContain(needle.get_state_hash());
+}
+
+State *QTable::FindIndexedState(State const &needle) {
+  std::pair<std::tr1::unordered_multimap<uint64_t, State *>::iterator,
+            std::tr1::unordered_multimap<uint64_t, State *>::iterator> range =
+    state_index_.equal_range(needle.get_state_hash());
+
+  // Hash collisions between distinct vectors share a bucket, so confirm
+  std::tr1::unordered_multimap<uint64_t, State *>::iterator iter;
+  for (iter = range.first; iter != range.second; ++iter) {
+    if (needle.Equals(iter->second)) return iter->second;
+  }
+  return NULL;
 }
 
 State *QTable::AddState(State const &state) {
-  State *s = new State(state);
+  // Pack the vector into the arena and hand out a handle to it. A vector
+  // that doesn't match the table's dimensions keeps its own storage and is
+  // left out of the spatial index.
+  State *s = NULL;
+  unsigned int row;
+  bool in_arena = arena_.Append(state.get_values(), state.get_dimensions(),
+                                &row);
+  if (in_arena)
+    s = new State(&arena_, row);
+  else
+    s = new State(state);
+  s->set_graph(&graph_, graph_.AddNode(s));
   states_.push_back(s);
+
+  // Only index the first copy of a vector, so duplicates resolve to the
+  // first state added, just like the old front-to-back search did
+  if (FindIndexedState(*s) == NULL)
+    state_index_.insert(std::make_pair(s->get_state_hash(), s));
+  if (in_arena) spatial_index_.Insert(s, row);
+
+  // Double the filter whenever it outgrows its sizing so the false positive
+  // rate stays bounded as the table grows
+  bloom_filter_.Add(s->get_state_hash());
+  if (bloom_filter_.IsSaturated())
+    RebuildBloomFilter(2 * bloom_filter_.get_capacity());
   return s;
 }
 
+void QTable::Clear() {
+  std::vector<State *>::iterator iter;
+  for (iter = states_.begin(); iter != states_.end(); iter++) {
+    if (*iter)
+      delete (*iter);
+  }
+  states_.clear();
+  state_index_.clear();
+  spatial_index_.Clear();
+  arena_.Clear();
+  graph_.Clear();
+  bloom_filter_.Reset(DEFAULT_EXPECTED_STATES);
+  link_scratch_.clear();
+  initiate_states_.clear();
+  goal_states_.clear();
+  trained_goal_states_.clear();
+  nearby_thresholds_.clear();
+}
+
+void QTable::RebuildBloomFilter(unsigned int expected_states) {
+  bloom_filter_.Reset(expected_states);
+
+  std::vector<State *>::iterator iter;
+  for (iter = states_.begin(); iter != states_.end(); ++iter) {
+    if (*iter == NULL) continue;
+    bloom_filter_.Add((*iter)->get_state_hash());
+  }
+}
+
 
 
 std::string QTable::serialize() {
@@ -204,7 +282,8 @@ std::string QTable::serialize() {
   for (initiate_iter = initiate_states_.begin();
        initiate_iter != initiate_states_.end();
        ++initiate_iter) {
-    initiate_state_hashes.append((*initiate_iter)->get_state_hash());
+    initiate_state_hashes.append(
+        State::HashToString((*initiate_iter)->get_state_hash()));
     initiate_state_hashes.append("\n");
   }
 
@@ -212,7 +291,8 @@ std::string QTable::serialize() {
   for (goal_iter = goal_states_.begin();
        goal_iter != goal_states_.end();
        ++goal_iter) {
-    goal_state_hashes.append((*goal_iter)->get_state_hash());
+    goal_state_hashes.append(
+        State::HashToString((*goal_iter)->get_state_hash()));
     goal_state_hashes.append("\n");
   }
 
@@ -220,7 +300,8 @@ std::string QTable::serialize() {
   for (trained_goal_iter = trained_goal_states_.begin();
        trained_goal_iter != trained_goal_states_.end();
        ++trained_goal_iter) {
-    trained_goal_state_hashes.append((*trained_goal_iter)->get_state_hash());
+    trained_goal_state_hashes.append(
+        State::HashToString((*trained_goal_iter)->get_state_hash()));
     trained_goal_state_hashes.append("\n");
   }
   
@@ -266,8 +347,16 @@ bool QTable::unserialize(std::vector<std::string> const &contents) {
   
   stack<string> blocks;
   vector<string>::const_iterator iter;
-  map<string, State*> hash_map;
+  map<uint64_t, State*> hash_map;
   
+  // Size the state storage and bloom filter for everything in the file, so
+  // the filter is rebuilt once rather than doubled repeatedly while loading
+  unsigned int state_count = 0;
+  for (iter = contents.begin(); iter != contents.end(); ++iter) {
+    if (iter->compare("BEGIN state") == 0) ++state_count;
+  }
+  ReserveStates(states_.size() + state_count);
+
   // First Pass: Load all the individual states that were recorded without any
   //             of their connections (for hash-map lookup later)
   bool loaded_vector = false;
@@ -309,7 +398,8 @@ bool QTable::unserialize(std::vector<std::string> const &contents) {
 /*
       char buf[4096];
       snprintf(buf, 4096, "Loaded state with hash: %s",
-               internal_state->get_state_hash().c_str());
+               State::HashToString(
+                 internal_state->get_state_hash()).c_str());
       Log(stdout, DEBUG, buf);
 */
       
@@ -396,13 +486,13 @@ bool QTable::unserialize(std::vector<std::string> const &contents) {
           state_vector.push_back(val);
         }          
         State s(state_vector);
-        map<string, State*>::iterator found_state = 
+        map<uint64_t, State*>::iterator found_state = 
           hash_map.find(s.get_state_hash());
         if (found_state == hash_map.end()) {
           char buf[4096];
           snprintf(buf, sizeof(buf), 
                    "Could not find state with hash %s in hash_map\n",
-                   s.get_state_hash().c_str());
+                   State::HashToString(s.get_state_hash()).c_str());
           Log(stdout, ERROR, buf);
         }  
         active_state = (found_state->second);
@@ -411,18 +501,19 @@ bool QTable::unserialize(std::vector<std::string> const &contents) {
           Log(stdout, ERROR, 
               "Error loading qtable (2): State missing in hashmap");
           snprintf(buf, sizeof(buf), "Missing hash: '%s'\nHashmap size: %ld", 
-                   s.get_state_hash().c_str(), hash_map.size());
+                   State::HashToString(s.get_state_hash()).c_str(),
+                   hash_map.size());
           Log(stdout, ERROR, buf);
           return false;
         }
         loaded_vector = true;
       }
     } else if (blocks.top().compare("initiate_states") == 0) {
-      AddInitiateState(hash_map[*iter]);
+      AddInitiateState(hash_map[State::HashFromString(*iter)]);
     } else if (blocks.top().compare("goal_states") == 0) {
-      AddGoalState(hash_map[*iter], false);
+      AddGoalState(hash_map[State::HashFromString(*iter)], false);
     } else if (blocks.top().compare("trained_goal_states") == 0) {
-      AddGoalState(hash_map[*iter], true);
+      AddGoalState(hash_map[State::HashFromString(*iter)], true);
     } else if (blocks.top().compare("nearby_thresholds") == 0) {
       vector<string> nt_values;
       vector<double> nt_vector;
@@ -437,7 +528,11 @@ bool QTable::unserialize(std::vector<std::string> const &contents) {
       set_nearby_thresholds(nt_vector);
     }
   }
-  
+
+  // Everything loaded went into pending edge storage; pack it once now, and
+  // settle the greedy policy rather than rescanning states on first use
+  graph_.Compact();
+  graph_.RecomputePolicy();
   return true;
 }
 
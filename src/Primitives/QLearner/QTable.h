@@ -12,8 +12,16 @@
 #define _SHL_PRIMITIVES_QLEARNER_QTABLE_H_
 
 #include <string>
+#include <utility>
 #include <vector>
+#include <stdint.h>
+#include <tr1/unordered_map>
 #include "QLearner/State.h"
+#include "QLearner/StateArena.h"
+#include "QLearner/TransitionGraph.h"
+#include "QLearner/BloomFilter.h"
+#include "QLearner/KdTree.h"
+#include "QLearner/DistanceKernel.h"
 #include "Common/Utils.h"
 
 namespace Primitives {
@@ -23,24 +31,31 @@ using Utils::Log;
 
 class QTable {
  public:
+  /**
+   * Number of states the membership filter is sized for until told otherwise
+   **/
+  static const unsigned int DEFAULT_EXPECTED_STATES = 4096;
+
   /**
    * Default Constructor
    **/
-  explicit QTable() { }
+  explicit QTable()
+    : bloom_filter_(DEFAULT_EXPECTED_STATES), spatial_index_(&arena_) { }
 
   /**
    * Copy Constructor
    **/
-  explicit QTable(QTable *q_table) {
+  explicit QTable(QTable *q_table)
+    : bloom_filter_(q_table->get_states().size()), spatial_index_(&arena_) {
     QTable &q = (*q_table);
-    std::vector<State *> qstates = q.get_states();
-    std::vector<State *> goal_states = q.get_goal_states();
-    std::vector<State *> trained_goal_states =
+    std::vector<State *> const &qstates = q.get_states();
+    std::vector<State *> const &goal_states = q.get_goal_states();
+    std::vector<State *> const &trained_goal_states =
         q.get_trained_goal_states();
-    std::vector<State *>::iterator iter;
+    std::vector<State *>::const_iterator iter;
     for (iter = qstates.begin(); iter != qstates.end(); ++iter) {
       State *added_state = this->AddState(**iter);
-      std::vector<State *>::iterator iter;
+      std::vector<State *>::const_iterator iter;
       for (iter = goal_states.begin(); iter != goal_states.end(); ++iter) {
         if ((*iter)->Equals(added_state)) {
           this->AddGoalState(added_state, false);
@@ -61,13 +76,25 @@ class QTable {
   /**
    * Destructor for QTable: Deletes all states internally created/held
    **/
-  virtual ~QTable() {
-    std::vector<State *>::iterator iter;
-    for (iter = states_.begin(); iter != states_.end(); iter++) {
-      if (*iter)
-        delete (*iter);
-    }
-    states_.clear();
+  virtual ~QTable() { Clear(); }
+
+  /**
+   * Deletes every state and returns the table to its default-constructed
+   * contents, goal states and nearby thresholds included
+   **/
+  void Clear();
+
+  /**
+   * Prepares the table to hold expected_states states, re-sizing the
+   * membership filter up front instead of growing it as states arrive.
+   *
+   * @param expected_states Anticipated total number of states in the table
+   **/
+  void ReserveStates(unsigned int expected_states) {
+    states_.reserve(expected_states);
+    arena_.Reserve(expected_states);
+    if (expected_states > bloom_filter_.get_capacity())
+      RebuildBloomFilter(expected_states);
   }
 
   /**
@@ -76,6 +103,16 @@ class QTable {
   std::vector<State *> & get_states() {
     return states_;
   }
+  std::vector<State *> const & get_states() const {
+    return states_;
+  }
+
+  /**
+   * @return Graph of the links between this table's states
+   **/
+  TransitionGraph &get_graph() {
+    return graph_;
+  }
 
   /**
    * @return direct access to 'intuited' goal states vector
@@ -83,6 +120,9 @@ class QTable {
   std::vector<State *> & get_goal_states() {
     return goal_states_;
   }
+  std::vector<State *> const & get_goal_states() const {
+    return goal_states_;
+  }
 
   /**
    * @return direct access to trained goal states vector
@@ -90,6 +130,9 @@ class QTable {
   std::vector<State *> & get_trained_goal_states() {
     return trained_goal_states_;
   }
+  std::vector<State *> const & get_trained_goal_states() const {
+    return trained_goal_states_;
+  }
 
   /**
    * @return "Nearby" threshold distances for each sensor dimension
@@ -116,6 +159,7 @@ class QTable {
       val *= val;
       (*iter) = val;
     }
+    graph_.MarkStructureChanged();
   }
 
   /**
@@ -137,11 +181,12 @@ class QTable {
    * @param needle_hash Hash of State to find within the QTable
    * @return NULL if needle not found, else: state pointer to internal version
    **/
-  State *GetState(std::string needle_hash);
+  State *GetState(uint64_t needle_hash);
 
   /**
    * Checks if the QTable has a state described by needle via Bloom Filter.
    * Faster than GetState, but capable of false positives. Never false negative.
+   * GetState consults this first, so a negative answer skips the lookup.
    *
    * @param needle State to find within QTable
    * @return true if state (probably) contained inside, false if not
@@ -150,12 +195,30 @@ class QTable {
 
   /**
    * Returns a vector of existing states determined to be 'nearby'
-   * to the needle state
+   * to the needle state, in the order they were added to the table
    * @param needle State to look near for existing states
    * @return vector of nearby states
    **/
   std::vector<State*> GetNearbyStates(State const &needle);
 
+  /**
+   * Returns a vector of existing states within the given per-dimension
+   * squared distances of the needle state, in the order they were added
+   * @param needle State to look near for existing states
+   * @param squared_thresholds Squared 'nearby' distance for each dimension.
+   *                           Dimensions past the end are unconstrained.
+   * @return vector of nearby states
+   **/
+  std::vector<State*> GetNearbyStates(
+    State const &needle, std::vector<double> const &squared_thresholds);
+
+  /**
+   * Replaces the contents of nearby_states with the states 'nearby' to the
+   * needle state, so callers in a loop can reuse one vector
+   **/
+  void GetNearbyStates(State const &needle,
+                       std::vector<State*> *nearby_states);
+
   /**
    * Returns a vector of existing states that have an outbound link to the
    * state provided. This is guaranteed to only return states
@@ -163,9 +226,12 @@ class QTable {
   std::vector<State*> GetIncomingStates(State const &s);
 
   /**
-   * Copy the state into a piece of memory that the QTable owns/manages. Doesn't
+   * Copy the state into a piece of memory that the QTable owns/manages. The
+   * state vector is packed into the table's arena and the returned State is a
+   * handle into it (unless its dimensions don't match the table's). Doesn't
    * check for a duplicate existing: assumes that you did your homework and you
-   * aren't re-adding something that already exists.
+   * aren't re-adding something that already exists. If a duplicate is added
+   * anyway, hash lookups keep returning the first copy.
    *
    * @param state State to copy and insert into QTable
    * @return Pointer to internal copy of state param
@@ -186,6 +252,7 @@ class QTable {
       trained_goal_states_.push_back(state);
     else
       goal_states_.push_back(state);
+    graph_.MarkStructureChanged();
   }
 
 
@@ -200,6 +267,7 @@ class QTable {
   void AddInitiateState(State *state) {
     if (IsInitiateState(*state)) return;
     initiate_states_.push_back(state);
+    graph_.MarkStructureChanged();
   }
 
   /**
@@ -233,30 +301,15 @@ class QTable {
    * @param candidates possible states to find closest to
    * @return State pointer to closest found state
    **/
-  State *GetNearestState(State const &state, vector<State*> const &candidates) {
-      vector<State*>::const_iterator iter;
-      double best_dist;
-      State *best_guess = NULL;
-
-      for (iter = candidates.begin(); iter != candidates.end(); ++iter) {
-        State *cand_state = (*iter);
-        vector<double> dists = state.GetSquaredDistances(cand_state);
+  State *GetNearestState(State const &state, vector<State*> const &candidates);
 
-        double dist = 0.;
-        vector<double>::iterator dist_iter;
-        for (dist_iter = dists.begin(); dist_iter != dists.end();
-             ++dist_iter) {
-          dist += *dist_iter;
-        }
-
-        if (best_guess == NULL || dist < best_dist) {
-          best_guess = cand_state;
-          best_dist = dist;
-        }
-      }
-
-      return best_guess;
-  }
+  /**
+   * Returns the nearest state in the whole table to 'state'
+   *
+   * @param state Needle to search for
+   * @return State pointer to closest found state, NULL if table is empty
+   **/
+  State *GetNearestState(State const &state);
 
   /**
    * Checks if the state provided is a known goal state
@@ -304,21 +357,13 @@ class QTable {
    * @return true if a and b are within nearby thresholds for all elements
    */
   bool IsNearState(State const &a, State const &b) {
-    std::vector<double> const &a_sv = a.get_state_vector();
-    std::vector<double> const &b_sv = b.get_state_vector();
-
-    if (a.get_state_vector().size() != b.get_state_vector().size()
-        || a.get_state_vector().size() != nearby_thresholds_.size())
+    if (a.get_dimensions() != b.get_dimensions()
+        || a.get_dimensions() != nearby_thresholds_.size())
       return false;
 
-    unsigned int i;
-    for (i = 0; i < nearby_thresholds_.size(); ++i) {
-      double dist = a_sv[i] - b_sv[i];
-      dist *= dist;
-      if (dist > nearby_thresholds_[i]) return false;
-    }
-
-    return true;
+    return DistanceKernel::WithinThresholds(a.get_values(), b.get_values(),
+                                            &nearby_thresholds_[0],
+                                            nearby_thresholds_.size());
   }
 
 
@@ -333,11 +378,61 @@ class QTable {
   bool unserialize(std::vector<std::string> const &contents);
 
  private:
+  // The k-d tree and states point into this table's own arena and graph,
+  // so a member-wise copy would leave them pointing into the original.
+  // Copy with QTable(QTable *) instead.
+  QTable(QTable const &);
+  QTable &operator=(QTable const &);
+
   /**
    * Huge array of all states seen thus far
    **/
   std::vector<State *> states_;
 
+  /**
+   * Contiguous storage for the state vectors of every state in states_
+   **/
+  StateArena arena_;
+
+  /**
+   * Reward links, incoming links and action transitions between the states
+   * in states_, which are numbered by their position in states_
+   **/
+  TransitionGraph graph_;
+
+  /**
+   * Maps each state hash to the first internal state added with each
+   * distinct vector, so exact lookups don't have to walk the states_ vector
+   **/
+  std::tr1::unordered_multimap<uint64_t, State *> state_index_;
+
+  /**
+   * Membership filter over the hashes of every state in states_
+   **/
+  BloomFilter bloom_filter_;
+
+  /**
+   * k-d tree over the state vectors of every state in states_, used for
+   * nearby and nearest-state queries
+   **/
+  KdTree spatial_index_;
+
+  /**
+   * Reused by GetState to stage a state's links while copying them, so
+   * adding states doesn't allocate once the buffer has grown
+   **/
+  std::vector<std::pair<State *, double> > link_scratch_;
+
+  /**
+   * Re-sizes bloom_filter_ for expected_states and re-adds every state
+   **/
+  void RebuildBloomFilter(unsigned int expected_states);
+
+  /**
+   * Finds the indexed state whose vector Equals needle's, or NULL
+   **/
+  State *FindIndexedState(State const &needle);
+
   /**
    * States that can signal the beginning of this skill
    **/
@@ -0,0 +1,257 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the QTable state storage and lookup
+ **/
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+#include "QLearner/QTable.h"
+#include "QLearner/StandardQLearner.h"
+#include "QLearner/State.h"
+
+namespace Primitives {
+
+class QTableTest : public testing::Test {
+ protected:
+  QTableTest() {
+    for (int i = 0; i < 50; ++i) {
+      std::vector<double> state_vector;
+      state_vector.push_back(0.01 * i);
+      state_vector.push_back(-0.02 * i);
+      state_vector.push_back(10. * i);
+      State s(state_vector);
+      q_table_.AddState(s);
+    }
+  }
+
+  virtual ~QTableTest() {}
+
+  QTable q_table_;
+};
+
+/**
+ * @test    Exact lookups return the internal copy of a state, or NULL
+ **/
+TEST_F(QTableTest, ExactLookup) {
+  std::vector<double> state_vector;
+  state_vector.push_back(0.01 * 7);
+  state_vector.push_back(-0.02 * 7);
+  state_vector.push_back(10. * 7);
+  State needle(state_vector);
+
+  State *found = q_table_.GetState(needle, false);
+  ASSERT_TRUE(found != NULL);
+  EXPECT_EQ(found, q_table_.get_states()[7]);
+  EXPECT_EQ(found, q_table_.GetState(needle.get_state_hash()));
+
+  state_vector[2] = -1.;
+  State missing(state_vector);
+  EXPECT_TRUE(q_table_.GetState(missing, false) == NULL);
+  EXPECT_TRUE(q_table_.GetState(missing.get_state_hash()) == NULL);
+}
+
+/**
+ * @test    State hashes cover every component, ignore last-bit rounding noise
+ *          and survive the hex round trip used for serialization
+ **/
+TEST_F(QTableTest, StateHashing) {
+  std::vector<double> state_vector;
+  state_vector.push_back(0.1 + 0.2);
+  state_vector.push_back(-0.);
+  state_vector.push_back(3.);
+  State a(state_vector);
+
+  state_vector[0] = 0.3;
+  state_vector[1] = 0.;
+  State b(state_vector);
+  EXPECT_EQ(a.get_state_hash(), b.get_state_hash());
+  EXPECT_TRUE(a.Equals(&b));
+
+  state_vector[0] = 0.4;
+  State c(state_vector);
+  EXPECT_NE(a.get_state_hash(), c.get_state_hash());
+  EXPECT_FALSE(a.Equals(&c));
+
+  EXPECT_EQ(a.get_state_hash(),
+            State::HashFromString(State::HashToString(a.get_state_hash())));
+}
+
+/**
+ * @test    Table states are handles into one row-packed arena, and copies of
+ *          them own their vectors
+ **/
+TEST_F(QTableTest, ArenaStorage) {
+  std::vector<State *> &states = q_table_.get_states();
+  double const *first = states[0]->get_values();
+  for (unsigned int i = 0; i < states.size(); ++i) {
+    ASSERT_EQ(3u, states[i]->get_dimensions());
+    EXPECT_EQ(first + 3 * i, states[i]->get_values());
+    EXPECT_DOUBLE_EQ(10. * i, states[i]->get_values()[2]);
+  }
+
+  State copy(*states[7]);
+  EXPECT_NE(states[7]->get_values(), copy.get_values());
+  EXPECT_TRUE(copy.Equals(states[7]));
+  EXPECT_TRUE(copy.get_state_vector() == states[7]->get_state_vector());
+
+  // Vectors of the wrong size are still stored, outside the arena
+  std::vector<double> short_vector(2, 1.);
+  State odd(short_vector);
+  State *added = q_table_.AddState(odd);
+  EXPECT_EQ(added, q_table_.GetState(odd, false));
+  EXPECT_TRUE(q_table_.GetNearbyStates(odd).empty());
+}
+
+/**
+ * @test    States added through lookups and copies stay reachable by hash
+ **/
+TEST_F(QTableTest, IndexMaintained) {
+  std::vector<double> state_vector;
+  state_vector.push_back(5.);
+  state_vector.push_back(5.);
+  state_vector.push_back(5.);
+  State needle(state_vector);
+
+  State *added = q_table_.GetState(needle, true);
+  ASSERT_TRUE(added != NULL);
+  EXPECT_EQ(added, q_table_.GetState(needle, false));
+  EXPECT_EQ(51u, q_table_.get_states().size());
+
+  QTable copy(&q_table_);
+  State *copied = copy.GetState(needle, false);
+  ASSERT_TRUE(copied != NULL);
+  EXPECT_NE(added, copied);
+  EXPECT_TRUE(copied->Equals(added));
+}
+
+/**
+ * @test    The bloom filter never reports a stored state as missing, even
+ *          after growing well past its initial sizing
+ **/
+TEST_F(QTableTest, BloomFilterMembership) {
+  QTable grown;
+  std::vector<State *> added;
+  for (unsigned int i = 0; i < 3 * QTable::DEFAULT_EXPECTED_STATES; ++i) {
+    std::vector<double> state_vector;
+    state_vector.push_back(0.5);
+    state_vector.push_back(0.001 * i);
+    State s(state_vector);
+    added.push_back(grown.AddState(s));
+  }
+
+  std::vector<State *>::iterator iter;
+  for (iter = added.begin(); iter != added.end(); ++iter) {
+    ASSERT_TRUE(grown.HasState(**iter));
+  }
+
+  std::vector<double> state_vector;
+  state_vector.push_back(0.5);
+  state_vector.push_back(-1.);
+  State missing(state_vector);
+  EXPECT_TRUE(grown.GetState(missing, false) == NULL);
+}
+
+/**
+ * @test    Spatial index queries agree with a brute-force scan, including
+ *          on trajectory-shaped (nearly monotone) insertion orders
+ **/
+TEST_F(QTableTest, SpatialQueriesMatchScan) {
+  QTable table;
+  std::vector<double> thresholds(3, 0.05);
+  table.set_nearby_thresholds(thresholds);
+
+  srand(7);
+  for (int i = 0; i < 2000; ++i) {
+    std::vector<double> state_vector;
+    state_vector.push_back(0.0005 * i + (rand() % 100) / 10000.);
+    state_vector.push_back((rand() % 1000) / 1000.);
+    state_vector.push_back(-0.001 * i);
+    State s(state_vector);
+    table.AddState(s);
+  }
+
+  std::vector<State *> &states = table.get_states();
+  for (int query = 0; query < 50; ++query) {
+    std::vector<double> needle_vector;
+    needle_vector.push_back((rand() % 1000) / 1000.);
+    needle_vector.push_back((rand() % 1000) / 1000.);
+    needle_vector.push_back(-(rand() % 2000) / 1000.);
+    State needle(needle_vector);
+
+    std::vector<State *> expected;
+    State *expected_nearest = NULL;
+    double best_dist = 0.;
+    for (unsigned int i = 0; i < states.size(); ++i) {
+      std::vector<double> dists = needle.GetSquaredDistances(states[i]);
+      bool near = true;
+      double dist = 0.;
+      for (unsigned int d = 0; d < dists.size(); ++d) {
+        if (dists[d] > table.get_nearby_thresholds()[d]) near = false;
+        dist += dists[d];
+      }
+      if (near) expected.push_back(states[i]);
+      if (expected_nearest == NULL || dist < best_dist) {
+        expected_nearest = states[i];
+        best_dist = dist;
+      }
+    }
+
+    EXPECT_TRUE(expected == table.GetNearbyStates(needle));
+    EXPECT_EQ(expected_nearest, table.GetNearestState(needle));
+    EXPECT_EQ(expected_nearest, table.GetNearestState(needle, states));
+  }
+}
+
+/**
+ * @test    Clearing empties the table, which then indexes new states afresh
+ **/
+TEST_F(QTableTest, Clear) {
+  q_table_.AddGoalState(q_table_.get_states()[3], true);
+  q_table_.Clear();
+  EXPECT_EQ(0u, q_table_.get_states().size());
+  EXPECT_EQ(0u, q_table_.get_goal_states().size());
+  EXPECT_EQ(0u, q_table_.get_trained_goal_states().size());
+
+  std::vector<double> state_vector(3, 1.);
+  State *added = q_table_.AddState(State(state_vector));
+  ASSERT_TRUE(added != NULL);
+  EXPECT_EQ(added, q_table_.GetState(State(state_vector), false));
+  EXPECT_EQ(added, q_table_.GetNearestState(State(state_vector)));
+}
+
+/**
+ * @test    A learner's table stays usable after Init resets it, and after
+ *          being copied from another table
+ **/
+TEST_F(QTableTest, LearnerTableAfterInit) {
+  StandardQLearner learner("learner");
+  ASSERT_TRUE(learner.Init(std::vector<Sensor *>()));
+  for (int i = 0; i < 3; ++i) {
+    std::vector<double> state_vector(3, static_cast<double>(i));
+    ASSERT_TRUE(learner.get_q_table()->AddState(State(state_vector)) != NULL);
+  }
+  EXPECT_EQ(3u, learner.get_q_table()->get_states().size());
+
+  StandardQLearner copied("copied", &q_table_);
+  QTable *copy = copied.get_q_table();
+  EXPECT_EQ(q_table_.get_states().size(), copy->get_states().size());
+  State *found = copy->GetState(*q_table_.get_states()[7], false);
+  ASSERT_TRUE(found != NULL);
+  EXPECT_NE(q_table_.get_states()[7], found);
+  EXPECT_EQ(found, copy->GetNearestState(*q_table_.get_states()[7]));
+  std::vector<double> state_vector(3, -5.);
+  EXPECT_TRUE(copy->AddState(State(state_vector)) != NULL);
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
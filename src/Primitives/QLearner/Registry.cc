@@ -0,0 +1,117 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of the reward layer and action registry
+ **/
+
+#include "QLearner/Registry.h"
+#include <pthread.h>
+#include <map>
+#include <vector>
+
+namespace Primitives {
+
+namespace {
+
+pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Name <-> ID tables for one kind of interned string
+ **/
+struct InternTable {
+  std::map<std::string, unsigned int> ids_;
+  std::vector<std::string> names_;
+
+  unsigned int Add(std::string const &name) {
+    unsigned int id = names_.size();
+    names_.push_back(name);
+    ids_[name] = id;
+    return id;
+  }
+
+  bool Find(std::string const &name, unsigned int *id) const {
+    std::map<std::string, unsigned int>::const_iterator iter =
+      ids_.find(name);
+    if (iter == ids_.end()) return false;
+    *id = iter->second;
+    return true;
+  }
+};
+
+// Built on first use (under registry_mutex), so the registry works even
+// from other files' static initializers
+InternTable &Layers() {
+  static InternTable layers;
+  if (layers.names_.empty()) {
+    layers.Add("base");
+    layers.Add("waypoint");
+  }
+  return layers;
+}
+
+InternTable &Actions() {
+  static InternTable actions;
+  if (actions.names_.empty()) {
+    actions.Add("NO_ACTION");
+    actions.Add("INTERPOLATE");
+  }
+  return actions;
+}
+
+/**
+ * Holds registry_mutex for the lifetime of the object
+ **/
+class RegistryLock {
+ public:
+  RegistryLock() { pthread_mutex_lock(&registry_mutex); }
+  ~RegistryLock() { pthread_mutex_unlock(&registry_mutex); }
+};
+
+}  // namespace
+
+bool Registry::InternLayer(std::string const &layer, LayerId *id) {
+  RegistryLock lock;
+  InternTable &layers = Layers();
+  if (layers.Find(layer, id)) return true;
+  if (layers.names_.size() >= MAX_LAYERS) return false;
+  *id = layers.Add(layer);
+  return true;
+}
+
+bool Registry::FindLayer(std::string const &layer, LayerId *id) {
+  RegistryLock lock;
+  return Layers().Find(layer, id);
+}
+
+std::string Registry::GetLayerName(LayerId id) {
+  RegistryLock lock;
+  InternTable &layers = Layers();
+  if (id >= layers.names_.size()) return "";
+  return layers.names_[id];
+}
+
+unsigned int Registry::GetLayerCount() {
+  RegistryLock lock;
+  return Layers().names_.size();
+}
+
+ActionId Registry::InternAction(std::string const &action) {
+  RegistryLock lock;
+  InternTable &actions = Actions();
+  ActionId id;
+  if (actions.Find(action, &id)) return id;
+  return actions.Add(action);
+}
+
+std::string Registry::GetActionName(ActionId id) {
+  RegistryLock lock;
+  InternTable &actions = Actions();
+  if (id >= actions.names_.size()) return "";
+  return actions.names_[id];
+}
+
+}  // namespace Primitives
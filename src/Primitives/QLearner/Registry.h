@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for the process-wide registry that interns reward
+ * layer names and serialized actions as small integer IDs.
+ *
+ * Transitions are stored and queried by ID; names are only needed when
+ * reading or writing skill files. The common layers and actions are
+ * registered up front with fixed IDs, so hot paths can use the constants
+ * below without any lookup. Interning is thread-safe.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_REGISTRY_H_
+#define _SHL_PRIMITIVES_QLEARNER_REGISTRY_H_
+
+#include <string>
+
+namespace Primitives {
+
+typedef unsigned int LayerId;
+typedef unsigned int ActionId;
+
+class Registry {
+ public:
+  /**
+   * Number of distinct reward layers that can be registered. Layer IDs are
+   * always less than this, so they can index fixed per-transition slots.
+   **/
+  static const unsigned int MAX_LAYERS = 4;
+
+  // Pre-registered reward layers
+  static const LayerId LAYER_BASE = 0;  // "base"
+  static const LayerId LAYER_WAYPOINT = 1;  // "waypoint"
+
+  // Pre-registered actions, matching the Action constants
+  static const ActionId ACTION_NO_ACTION = 0;  // Action::NO_ACTION
+  static const ActionId ACTION_INTERPOLATE = 1;  // Action::INTERPOLATE
+
+  /**
+   * Finds or registers a reward layer
+   *
+   * @param layer Reward layer name
+   * @param id Populated with the layer's ID
+   * @return false if the layer is new and MAX_LAYERS are already registered
+   **/
+  static bool InternLayer(std::string const &layer, LayerId *id);
+
+  /**
+   * Finds an already registered reward layer, without registering it
+   *
+   * @param layer Reward layer name
+   * @param id Populated with the layer's ID
+   * @return false if no such layer has been registered
+   **/
+  static bool FindLayer(std::string const &layer, LayerId *id);
+
+  /**
+   * @return Name of a registered reward layer
+   **/
+  static std::string GetLayerName(LayerId id);
+
+  /**
+   * @return Number of registered reward layers
+   **/
+  static unsigned int GetLayerCount();
+
+  /**
+   * Finds or registers a serialized action
+   *
+   * @param action Serialized action descriptor
+   * @return ID of the action
+   **/
+  static ActionId InternAction(std::string const &action);
+
+  /**
+   * @return Serialized descriptor of a registered action
+   **/
+  static std::string GetActionName(ActionId id);
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_REGISTRY_H_
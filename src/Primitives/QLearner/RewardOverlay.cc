@@ -0,0 +1,138 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of a scratch reward overlay on a transition
+ * graph
+ **/
+
+#include "QLearner/RewardOverlay.h"
+#include "QLearner/State.h"
+#include "QLearner/TransitionGraph.h"
+
+namespace Primitives {
+
+bool RewardOverlay::GetKey(State const *source, State const *target,
+                           uint64_t *key) const {
+  if (source == NULL || target == NULL || graph_ == NULL) return false;
+  if (source->get_graph() != graph_ || target->get_graph() != graph_)
+    return false;
+  *key = (static_cast<uint64_t>(source->get_graph_id()) << 32)
+         | target->get_graph_id();
+  return true;
+}
+
+void RewardOverlay::FindOverrides(unsigned int source, unsigned int target,
+                                  Link const **link,
+                                  Link const **into_target) const {
+  *link = NULL;
+  *into_target = NULL;
+  if (!links_.empty()) {
+    LinkMap::const_iterator found =
+      links_.find((static_cast<uint64_t>(source) << 32) | target);
+    if (found != links_.end()) *link = &found->second;
+  }
+  if (!targets_.empty() && source != target) {
+    TargetMap::const_iterator found = targets_.find(target);
+    if (found != targets_.end()) *into_target = &found->second;
+  }
+}
+
+double RewardOverlay::GetReward(State const *source, State const *target,
+                                LayerId layer) {
+  uint64_t key;
+  if (layer >= Registry::MAX_LAYERS || !GetKey(source, target, &key))
+    return 0.;
+
+  unsigned int source_id = source->get_graph_id();
+  unsigned int target_id = target->get_graph_id();
+  Link const *link;
+  Link const *into_target;
+  FindOverrides(source_id, target_id, &link, &into_target);
+  return Resolve(link, into_target, layer,
+                 graph_->GetReward(source_id, target_id, layer));
+}
+
+double RewardOverlay::GetTotalReward(State const *source,
+                                     State const *target) {
+  uint64_t key;
+  if (!GetKey(source, target, &key)) return 0.;
+
+  unsigned int source_id = source->get_graph_id();
+  unsigned int target_id = target->get_graph_id();
+  Link const *link;
+  Link const *into_target;
+  FindOverrides(source_id, target_id, &link, &into_target);
+  if (link == NULL && into_target == NULL)
+    return graph_->GetTotalReward(source_id, target_id);
+
+  double total = 0.;
+  for (LayerId layer = 0; layer < Registry::MAX_LAYERS; ++layer)
+    total += Resolve(link, into_target, layer,
+                     graph_->GetReward(source_id, target_id, layer));
+  return total;
+}
+
+bool RewardOverlay::SetReward(State const *source, State const *target,
+                              LayerId layer, double reward) {
+  uint64_t key;
+  if (layer >= Registry::MAX_LAYERS || !GetKey(source, target, &key))
+    return false;
+
+  Link &link = links_[key];
+  link.rewards_[layer] = reward;
+  link.overridden_ |= 1u << layer;
+  return true;
+}
+
+bool RewardOverlay::SetTargetReward(State const *target, LayerId layer,
+                                    double reward) {
+  if (layer >= Registry::MAX_LAYERS || target == NULL || graph_ == NULL
+      || target->get_graph() != graph_)
+    return false;
+
+  Link &into_target = targets_[target->get_graph_id()];
+  into_target.rewards_[layer] = reward;
+  into_target.overridden_ |= 1u << layer;
+  return true;
+}
+
+bool RewardOverlay::GetBestSuccessor(State const *source, State **successor,
+                                     double *value) {
+  if (source == NULL || graph_ == NULL || source->get_graph() != graph_)
+    return false;
+
+  // With nothing overridden the graph's cached policy already has the answer
+  if (links_.empty() && targets_.empty())
+    return source->GetBestSuccessor(successor, value);
+
+  unsigned int source_id = source->get_graph_id();
+  bool found = false;
+  TransitionGraph::RewardLinkIterator link_iter;
+  for (link_iter = graph_->RewardLinks(source_id); link_iter.valid();
+       ++link_iter) {
+    Link const *link;
+    Link const *into_target;
+    FindOverrides(source_id, link_iter.target_id(), &link, &into_target);
+
+    double total = 0.;
+    if (link == NULL && into_target == NULL) {
+      total = link_iter.total_reward();
+    } else {
+      for (LayerId layer = 0; layer < Registry::MAX_LAYERS; ++layer)
+        total += Resolve(link, into_target, layer, link_iter.reward(layer));
+    }
+
+    if (!found || total > *value) {
+      *successor = link_iter.target();
+      *value = total;
+      found = true;
+    }
+  }
+  return found;
+}
+
+}  // namespace Primitives
@@ -0,0 +1,155 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is a scratch layer of reward estimates over one QTable's transition
+ * graph.  Writes land in the overlay instead of the graph, and reads see
+ * the overlay's value for any link layer it has set and the graph's value
+ * otherwise, so a caller can estimate and revise rewards for a while and
+ * then throw every change away by clearing or destroying the overlay.
+ *
+ * The overlay may hold links the graph doesn't have.  Links are keyed by
+ * graph id, so states must belong to the overlay's graph; any others read
+ * as 0 and are never written.
+ *
+ * It can also set a layer on every link into a state at once, which is how
+ * the observer boosts waypoints for a single traversal: one entry per
+ * boosted state, instead of a write to the graph per incoming link that
+ * then has to be undone.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_REWARDOVERLAY_H_
+#define _SHL_PRIMITIVES_QLEARNER_REWARDOVERLAY_H_
+
+#include <stdint.h>
+#include <tr1/unordered_map>
+#include "QLearner/Registry.h"
+
+namespace Primitives {
+
+class State;
+class TransitionGraph;
+
+class RewardOverlay {
+ public:
+  /**
+   * @param graph Graph the overlay sits on; it is only ever read
+   **/
+  explicit RewardOverlay(TransitionGraph *graph) : graph_(graph) {}
+
+  /**
+   * @return Reward of one layer of the link source -> target
+   **/
+  double GetReward(State const *source, State const *target, LayerId layer);
+
+  /**
+   * @return Reward summed over every layer of the link source -> target
+   **/
+  double GetTotalReward(State const *source, State const *target);
+
+  /**
+   * Sets the overlay's reward for one layer of the link source -> target,
+   * leaving the graph untouched
+   *
+   * @return false if either state is not in the overlay's graph
+   **/
+  bool SetReward(State const *source, State const *target, LayerId layer,
+                 double reward);
+
+  /**
+   * Sets the overlay's reward for one layer of every link into target from
+   * another state, existing or not, until ClearTargetRewards.  A layer set
+   * on the link itself with SetReward takes precedence.
+   *
+   * @return false if target is not in the overlay's graph
+   **/
+  bool SetTargetReward(State const *target, LayerId layer, double reward);
+
+  /**
+   * Finds the greedy successor of source as the overlay sees it: the target
+   * of its graph link with the highest total reward, the earliest created
+   * winning ties, as in TransitionGraph::GetBestSuccessor.  Links only the
+   * overlay holds are not considered.
+   *
+   * @param successor Populated with the successor
+   * @param value Populated with the total reward of the link to it
+   * @return false if source has no reward links or is not in the graph
+   **/
+  bool GetBestSuccessor(State const *source, State **successor,
+                        double *value);
+
+  /**
+   * Drops every estimate, so reads see the graph again
+   **/
+  void Clear() {
+    links_.clear();
+    targets_.clear();
+  }
+
+  /**
+   * Drops the rewards set with SetTargetReward, keeping link estimates
+   **/
+  void ClearTargetRewards() { targets_.clear(); }
+
+  /**
+   * @return Number of links the overlay holds an estimate for
+   **/
+  unsigned int size() const { return links_.size(); }
+
+  TransitionGraph *get_graph() const { return graph_; }
+
+ private:
+  struct Link {
+    Link() : overridden_(0) {
+      for (unsigned int i = 0; i < Registry::MAX_LAYERS; ++i)
+        rewards_[i] = 0.;
+    }
+
+    double rewards_[Registry::MAX_LAYERS];
+
+    // Bit i is set if rewards_[i] replaces the graph's value
+    unsigned int overridden_;
+  };
+
+  typedef std::tr1::unordered_map<uint64_t, Link> LinkMap;
+  typedef std::tr1::unordered_map<unsigned int, Link> TargetMap;
+
+  /**
+   * @return Key for the link source -> target, or false if either state
+   *         is not in the overlay's graph
+   **/
+  bool GetKey(State const *source, State const *target, uint64_t *key) const;
+
+  /**
+   * Populates link and into_target with the overrides for the link
+   * source -> target and for links into target, each NULL if there are none
+   **/
+  void FindOverrides(unsigned int source, unsigned int target,
+                     Link const **link, Link const **into_target) const;
+
+  /**
+   * @return Reward of one layer given a link's overrides and its value in
+   *         the graph
+   **/
+  static double Resolve(Link const *link, Link const *into_target,
+                        LayerId layer, double graph_reward) {
+    if (link != NULL && (link->overridden_ & (1u << layer)))
+      return link->rewards_[layer];
+    if (into_target != NULL && (into_target->overridden_ & (1u << layer)))
+      return into_target->rewards_[layer];
+    return graph_reward;
+  }
+
+  TransitionGraph *graph_;
+  LinkMap links_;
+
+  // Layers set on every link into a state, keyed by its graph id
+  TargetMap targets_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_REWARDOVERLAY_H_
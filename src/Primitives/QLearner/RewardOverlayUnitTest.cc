@@ -0,0 +1,144 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the scratch reward overlay
+ **/
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "QLearner/QTable.h"
+#include "QLearner/Registry.h"
+#include "QLearner/RewardOverlay.h"
+#include "QLearner/State.h"
+#include "QLearner/TransitionGraph.h"
+
+namespace Primitives {
+
+class RewardOverlayTest : public testing::Test {
+ protected:
+  /**
+   * Three states, with 0 -> 1 worth 2 (base) + 1 (waypoint)
+   **/
+  RewardOverlayTest() : overlay_(&q_table_.get_graph()) {
+    for (int i = 0; i < 3; ++i) {
+      std::vector<double> state_vector(1, static_cast<double>(i));
+      states_.push_back(q_table_.AddState(State(state_vector)));
+    }
+    states_[0]->set_reward(states_[1], Registry::LAYER_BASE, 2.);
+    states_[0]->set_reward(states_[1], Registry::LAYER_WAYPOINT, 1.);
+  }
+
+  QTable q_table_;
+  std::vector<State *> states_;
+  RewardOverlay overlay_;
+};
+
+/**
+ * @test    Reads fall through to the graph until a layer is overridden
+ **/
+TEST_F(RewardOverlayTest, ReadThrough) {
+  EXPECT_EQ(0u, overlay_.size());
+  EXPECT_DOUBLE_EQ(2., overlay_.GetReward(states_[0], states_[1],
+                                          Registry::LAYER_BASE));
+  EXPECT_DOUBLE_EQ(3., overlay_.GetTotalReward(states_[0], states_[1]));
+
+  ASSERT_TRUE(overlay_.SetReward(states_[0], states_[1],
+                                 Registry::LAYER_BASE, 5.));
+  EXPECT_DOUBLE_EQ(5., overlay_.GetReward(states_[0], states_[1],
+                                          Registry::LAYER_BASE));
+  EXPECT_DOUBLE_EQ(1., overlay_.GetReward(states_[0], states_[1],
+                                          Registry::LAYER_WAYPOINT));
+  EXPECT_DOUBLE_EQ(6., overlay_.GetTotalReward(states_[0], states_[1]));
+
+  // Overriding with 0 hides the graph's value
+  ASSERT_TRUE(overlay_.SetReward(states_[0], states_[1],
+                                 Registry::LAYER_WAYPOINT, 0.));
+  EXPECT_DOUBLE_EQ(5., overlay_.GetTotalReward(states_[0], states_[1]));
+  EXPECT_EQ(1u, overlay_.size());
+
+  // The graph never saw any of it
+  EXPECT_DOUBLE_EQ(2., states_[0]->GetRewardValue(states_[1],
+                                                  Registry::LAYER_BASE));
+  EXPECT_DOUBLE_EQ(3., states_[0]->GetRewardValue(states_[1], true, ""));
+
+  overlay_.Clear();
+  EXPECT_DOUBLE_EQ(3., overlay_.GetTotalReward(states_[0], states_[1]));
+}
+
+/**
+ * @test    Links the graph lacks live only in the overlay, and states from
+ *          another graph are refused
+ **/
+TEST_F(RewardOverlayTest, NewLinksAndForeignStates) {
+  ASSERT_TRUE(overlay_.SetReward(states_[1], states_[2],
+                                 Registry::LAYER_BASE, -1.));
+  EXPECT_DOUBLE_EQ(-1., overlay_.GetTotalReward(states_[1], states_[2]));
+  EXPECT_DOUBLE_EQ(0., states_[1]->GetRewardValue(states_[2], true, ""));
+  EXPECT_FALSE(states_[1]->RewardLinks().valid());
+
+  State outside(std::vector<double>(1, 0.));
+  EXPECT_FALSE(overlay_.SetReward(&outside, states_[1],
+                                  Registry::LAYER_BASE, 1.));
+  EXPECT_DOUBLE_EQ(0., overlay_.GetTotalReward(&outside, states_[1]));
+  EXPECT_FALSE(overlay_.SetReward(states_[0], states_[1],
+                                  Registry::MAX_LAYERS, 1.));
+  EXPECT_EQ(1u, overlay_.size());
+}
+
+/**
+ * @test    Target rewards reach every other link into a state, steer the
+ *          greedy successor, and leave the graph and its policy alone
+ **/
+TEST_F(RewardOverlayTest, TargetRewards) {
+  // 0 -> 1 (3 total), 0 -> 2 (2 total), 2 -> 2 (1 total)
+  states_[0]->set_reward(states_[2], Registry::LAYER_BASE, 2.);
+  states_[2]->set_reward(states_[2], Registry::LAYER_BASE, 1.);
+
+  State *successor = NULL;
+  double value = 0.;
+  ASSERT_TRUE(overlay_.GetBestSuccessor(states_[0], &successor, &value));
+  EXPECT_EQ(states_[1], successor);
+  EXPECT_DOUBLE_EQ(3., value);
+
+  ASSERT_TRUE(overlay_.SetTargetReward(states_[2], Registry::LAYER_WAYPOINT,
+                                       150.));
+  EXPECT_DOUBLE_EQ(152., overlay_.GetTotalReward(states_[0], states_[2]));
+  EXPECT_DOUBLE_EQ(1., overlay_.GetTotalReward(states_[2], states_[2]));
+  ASSERT_TRUE(overlay_.GetBestSuccessor(states_[0], &successor, &value));
+  EXPECT_EQ(states_[2], successor);
+  EXPECT_DOUBLE_EQ(152., value);
+
+  // A layer set on the link itself wins over the target's
+  ASSERT_TRUE(overlay_.SetReward(states_[0], states_[2],
+                                 Registry::LAYER_WAYPOINT, 0.));
+  EXPECT_DOUBLE_EQ(2., overlay_.GetTotalReward(states_[0], states_[2]));
+  ASSERT_TRUE(overlay_.GetBestSuccessor(states_[0], &successor, &value));
+  EXPECT_EQ(states_[1], successor);
+
+  // The graph never saw the boost
+  EXPECT_DOUBLE_EQ(0., states_[0]->GetRewardValue(states_[2],
+                                                  Registry::LAYER_WAYPOINT));
+  ASSERT_TRUE(states_[0]->GetBestSuccessor(&successor, &value));
+  EXPECT_EQ(states_[1], successor);
+
+  overlay_.ClearTargetRewards();
+  EXPECT_EQ(1u, overlay_.size());
+  overlay_.Clear();
+  EXPECT_DOUBLE_EQ(2., overlay_.GetTotalReward(states_[0], states_[2]));
+
+  State outside(std::vector<double>(1, 0.));
+  EXPECT_FALSE(overlay_.SetTargetReward(&outside, Registry::LAYER_WAYPOINT,
+                                        150.));
+  EXPECT_FALSE(overlay_.GetBestSuccessor(&outside, &successor, &value));
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
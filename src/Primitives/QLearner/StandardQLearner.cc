@@ -12,10 +12,12 @@
 #include "QLearner/StandardQLearner.h"
 #include "QLearner/QTable.h"
 #include "QLearner/State.h"
+#include "QLearner/TransitionGraph.h"
 
 namespace Primitives {
 
-StandardQLearner::StandardQLearner(std::string name) {
+StandardQLearner::StandardQLearner(std::string name)
+  : path_cache_(PathCache::DEPENDS_ON_LINKS) {
   name_ = name;
   trials_ = 0;
   anticipated_duration_ = 0;
@@ -23,9 +25,9 @@ StandardQLearner::StandardQLearner(std::string name) {
   credit_assignment_type_ = NULL;
 }
 
-StandardQLearner::StandardQLearner(std::string name, QTable qt) {
+StandardQLearner::StandardQLearner(std::string name, QTable *qt)
+  : QLearner(qt), path_cache_(PathCache::DEPENDS_ON_LINKS) {
   name_ = name;
-  q_table_ = qt;
   trials_ = 0;
   anticipated_duration_ = 0;
   exploration_type_ = NULL;
@@ -33,6 +35,7 @@ StandardQLearner::StandardQLearner(std::string name, QTable qt) {
 }
 
 bool StandardQLearner::Load(string const& filename) {
+  path_cache_.Clear();
   return QLearner::Load(filename);
 }
 
@@ -42,8 +45,8 @@ bool StandardQLearner::Save(string const& filename) {
 
 bool StandardQLearner::Init(std::vector<Sensor *> const &sensors) {
   this->sensors_ = sensors;
-  QTable qt;
-  this->q_table_ = qt;
+  this->q_table_.Clear();
+  path_cache_.Clear();
 
   std::vector<double> thresh;
   std::vector<Sensor *>::const_iterator iter;
@@ -57,42 +60,27 @@ bool StandardQLearner::Init(std::vector<Sensor *> const &sensors) {
 }
 
 /**
- * @todo Requires rewrite to not duplicate functionality introduced in QTable
- *       class. This function is meant mostly for adding possible states into
- *       the QTable so the exploration function has more choices to pick from.
- *       Concept is half-baked at the moment.
+ * This function is meant mostly for adding possible states into
+ * the QTable so the exploration function has more choices to pick from.
+ * Concept is half-baked at the moment.
  **/
 bool StandardQLearner::GetNearbyStates(
   State const& cur_state, std::vector<State const *>& nearby_states) {
   // Retrieve all states within search_distances of the cur_state that are
-  // in the qtable.
-
-  std::vector<State *> all_states = this->q_table_.get_states();
-
-  std::vector<State *>::const_iterator iter;
-  bool state_distance_fail = false;
-  for (iter = all_states.begin(); iter != all_states.end(); ++iter) {
-    State *cmp_state = (*iter);
-    state_distance_fail = false;
-    // iterate through each value in the state and check if it's within required
-    // distance from the current state (according to the internal sensor vector)
-    std::vector<Sensor *>::const_iterator sensor_iter;
-    int i;
-    for (i = 0, sensor_iter = sensors_.begin(); sensor_iter != sensors_.end();
-         ++sensor_iter, ++i) {
-      double dist = cmp_state->get_state_vector()[i]
-                    - cur_state.get_state_vector()[i];
-      dist = (dist < 0) ? -dist : dist;
-      if (dist > (*sensor_iter)->get_nearby_threshold()) {
-        state_distance_fail = true;
-        break;
-      }
-    }
-
-    if (state_distance_fail) continue;
-    nearby_states.push_back(*iter);
+  // in the qtable, using each sensor's nearby threshold for its dimension
+  std::vector<double> squared_thresholds;
+  std::vector<Sensor *>::const_iterator sensor_iter;
+  for (sensor_iter = sensors_.begin(); sensor_iter != sensors_.end();
+       ++sensor_iter) {
+    double thresh = (*sensor_iter)->get_nearby_threshold();
+    squared_thresholds.push_back(thresh * thresh);
   }
 
+  std::vector<State *> found_states =
+    this->q_table_.GetNearbyStates(cur_state, squared_thresholds);
+  nearby_states.insert(nearby_states.end(), found_states.begin(),
+                       found_states.end());
+
   return (nearby_states.size() > 0);
 }
 
@@ -115,11 +103,26 @@ vector<State *> StandardQLearner::GetNearestFixedExecutionPath(
   // No initiation state was found, can't start the action.
   if (initiation_state == NULL) return exec_path;
 
+  // Reuse the last walk from this initiation state while nothing along it
+  // has changed
+  TransitionGraph &graph = this->q_table_.get_graph();
+  bool cacheable = initiation_state->get_graph() == &graph;
+  std::vector<unsigned int> path_ids;
+  if (cacheable && path_cache_.Lookup(graph, initiation_state->get_graph_id(),
+                                      PathCache::ANY_GOAL, &path_ids)) {
+    std::vector<unsigned int>::const_iterator id_iter;
+    for (id_iter = path_ids.begin(); id_iter != path_ids.end(); ++id_iter)
+      exec_path.push_back(graph.get_state(*id_iter));
+    return exec_path;
+  }
+
+  std::vector<unsigned int> walked;
   exec_path.push_back(initiation_state);
   State *prev_state = initiation_state;
   while (true) {
     State *next_state = NULL;
     double transition_reward = 0.;
+    if (cacheable) walked.push_back(prev_state->get_graph_id());
     this->GetNextState(prev_state, &next_state, transition_reward);
 
     // If we hit a dead end or a bad transition, break out
@@ -137,6 +140,15 @@ vector<State *> StandardQLearner::GetNearestFixedExecutionPath(
     prev_state = next_state;
   }
 
+  if (cacheable) {
+    path_ids.clear();
+    std::vector<State *>::const_iterator state_iter;
+    for (state_iter = exec_path.begin(); state_iter != exec_path.end();
+         ++state_iter)
+      path_ids.push_back((*state_iter)->get_graph_id());
+    path_cache_.Store(graph, initiation_state->get_graph_id(),
+                      PathCache::ANY_GOAL, path_ids, walked);
+  }
   return exec_path;
 }
 
@@ -148,7 +160,17 @@ bool StandardQLearner::GetNextState(State *cur_state,
   return exploration_type_->GetNextState(cur_state, next_state, &reward);
 }
 
+bool StandardQLearner::GetNextState(State *cur_state,
+                                    State **next_state,
+                                    double &reward,
+                                    RewardOverlay *overlay) {
+  if (exploration_type_ == NULL) return false;
+  return exploration_type_->GetNextState(cur_state, next_state, &reward,
+                                         overlay);
+}
+
 bool StandardQLearner::AssignCredit(double signal) {
+  if (credit_assignment_type_ == NULL) return false;
   return credit_assignment_type_->ApplyCredit(signal);
 }
 
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <string>
 #include <vector>
+#include "QLearner/PathCache.h"
 #include "QLearner/QLearner.h"
 #include "QLearner/QTable.h"
 #include "QLearner/StateHistoryTuple.h"
@@ -27,7 +28,7 @@ class State;
 class StandardQLearner : public QLearner {
  public:
   explicit StandardQLearner(std::string name);
-  StandardQLearner(std::string name, QTable qt);
+  StandardQLearner(std::string name, QTable *qt);
   ~StandardQLearner() {
     if (exploration_type_)
       delete exploration_type_;
@@ -88,6 +89,19 @@ class StandardQLearner : public QLearner {
   virtual bool GetNextState(State *cur_state,
                             State **next_state,
                             double &reward);
+  virtual bool GetNextState(State *cur_state,
+                            State **next_state,
+                            double &reward,
+                            RewardOverlay *overlay);
+
+  /**
+   * Sets the exploration function, dropping any fixed execution paths
+   * planned with the previous one
+   **/
+  virtual bool SetExplorationFunction(ExplorationType* explorer) {
+    path_cache_.Clear();
+    return QLearner::SetExplorationFunction(explorer);
+  }
 
 
   /**
@@ -106,8 +120,19 @@ class StandardQLearner : public QLearner {
    */
   virtual vector<State *> GetNearestFixedExecutionPath(State *current_state);
 
+  /**
+   * @return Cache of fixed execution paths, keyed by initiation state
+   **/
+  PathCache const &get_path_cache() const { return path_cache_; }
+
  private:
-  StandardQLearner() {}
+  StandardQLearner() : path_cache_(PathCache::DEPENDS_ON_LINKS) {}
+
+  /**
+   * Fixed execution paths already walked, reused until the rewards along
+   * them (or the table's goal and initiate states) change
+   **/
+  PathCache path_cache_;
 };
 
 }  // namespace Primitives
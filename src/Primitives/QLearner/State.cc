@@ -10,13 +10,61 @@
  */
 
 #include "QLearner/State.h"
+#include <cstring>
+#include "QLearner/DistanceKernel.h"
 using Utils::Log;
 
 namespace Primitives {
 
+namespace {
+
+/**
+ * Returns the bit pattern of val with its low-order mantissa bits cleared and
+ * -0.0 folded into 0.0, so values that only differ by rounding noise agree
+ **/
+inline uint64_t QuantizeValue(double val) {
+  if (val == 0.) return 0;
+  uint64_t bits;
+  memcpy(&bits, &val, sizeof(bits));
+  return bits & ~((1ULL << State::HASH_QUANTIZATION_BITS) - 1);
+}
+
+}  // namespace
+
+void State::generateHash() {
+  // 64-bit multiply/rotate mix (MurmurHash64A-style) over each quantized value
+  const uint64_t MULTIPLIER = 0xC6A4A7935BD1E995ULL;
+  double const *values = get_values();
+  unsigned int dimensions = get_dimensions();
+  uint64_t hash = 0x9E3779B97F4A7C15ULL ^ (dimensions * MULTIPLIER);
+
+  for (unsigned int i = 0; i < dimensions; ++i) {
+    uint64_t k = QuantizeValue(values[i]) * MULTIPLIER;
+    k ^= k >> 47;
+    k *= MULTIPLIER;
+    hash ^= k;
+    hash *= MULTIPLIER;
+  }
+
+  hash ^= hash >> 47;
+  hash *= MULTIPLIER;
+  hash ^= hash >> 47;
+  state_hash_ = hash;
+}
+
+std::string State::HashToString(uint64_t hash) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%016llx",
+           static_cast<unsigned long long>(hash));  // NOLINT
+  return std::string(buf);
+}
+
+uint64_t State::HashFromString(std::string const &hash_str) {
+  return static_cast<uint64_t>(strtoull(hash_str.c_str(), NULL, 16));
+}
 
 bool State::unserialize(std::vector<std::string> const &contents,
-                        std::map<std::string, State*> &hash_map) {
+                        std::map<uint64_t, State*> &hash_map) {
   using std::string;
   using std::stack;
   using std::vector;
@@ -91,7 +139,7 @@ bool State::unserialize(std::vector<std::string> const &contents,
       // Load all the reward layers and transitions into the active_state
       if (iter->substr(0, 6).compare("Target") == 0) {
         // Loading a transition consists of three lines: 
-        // Target <hash> (string)
+        // Target <hash> (hex string)
         // Layer <Layer Name> (string)
         // Reward <Reward Value> (double)
         string target;
@@ -114,7 +162,8 @@ bool State::unserialize(std::vector<std::string> const &contents,
           }
         }
         
-        State *target_state = (hash_map[target]);
+        uint64_t target_hash = HashFromString(target);
+        State *target_state = (hash_map[target_hash]);
         if (!target_state) {
           Log(stdout, ERROR, "Error loading state from qtable: "
               "Target missing in hashmap");
@@ -123,17 +172,17 @@ bool State::unserialize(std::vector<std::string> const &contents,
                    hash_map.size(), target.c_str());
           Log(stdout, ERROR, buf);
           
-          map<string, State*>::iterator iter;
+          map<uint64_t, State*>::iterator iter;
           for (iter = hash_map.begin(); iter != hash_map.end(); ++iter) {
             snprintf(buf, sizeof(buf), "Hash: '%s'",
-                     iter->first.c_str());
+                     HashToString(iter->first).c_str());
             Log(stdout, ERROR, buf);
           }
           
-          State *test = (hash_map.find(target)->second);
+          State *test = (hash_map.find(target_hash)->second);
           if (test) {
             snprintf(buf, sizeof(buf), "Found a state with hash %s.",
-                     test->get_state_hash().c_str());
+                     HashToString(test->get_state_hash()).c_str());
             Log(stdout, ERROR, buf);
           } else {
             Log(stdout, ERROR, 
@@ -158,7 +207,7 @@ bool State::unserialize(std::vector<std::string> const &contents,
             Log(stdout, ERROR, "Incomplete Action transition Target group");
             return false;
           } else if (iter->substr(0, 5).compare("Target") == 0) {
-            target_state = (hash_map[iter->substr(7)]);
+            target_state = (hash_map[HashFromString(iter->substr(7))]);
             if (!target_state) {
               Log(stdout, ERROR, "Error loading state actions: Target missing"
                                  " in hashmap");
@@ -179,20 +228,17 @@ bool State::unserialize(std::vector<std::string> const &contents,
 }
 
 bool State::Equals(State *state) const {
-  if (state->get_state_vector().size() != state_vector_.size())
-    return false;
-
-  return (state->get_state_hash().compare(this->get_state_hash()) == 0);
-
-  /*
-  vector<double> const &cmp_vector = state->get_state_vector();
-  int vector_size = state_vector_.size();
-  for (int i = 0; i < vector_size; ++i) {
-    if (fabs((state_vector_[i]) - (cmp_vector[i])) > 1E-10) {
+  if (state->state_hash_ != state_hash_) return false;
+  unsigned int vector_size = get_dimensions();
+  if (state->get_dimensions() != vector_size) return false;
+
+  // Rule out hash collisions
+  double const *values = get_values();
+  double const *cmp_values = state->get_values();
+  for (unsigned int i = 0; i < vector_size; ++i) {
+    if (QuantizeValue(values[i]) != QuantizeValue(cmp_values[i]))
       return false;
-    }
   }
-  */
   return true;
 }
 
@@ -209,48 +255,49 @@ std::string State::serialize() {
   string serialized_state;
   
   memset(buf, 0, BUFFER_SIZE);
-  for (unsigned int i = 0; i < state_vector_.size(); ++i) {
-    snprintf(buf, BUFFER_SIZE, "%g", state_vector_[i]);
+  double const *values = get_values();
+  unsigned int dimensions = get_dimensions();
+  for (unsigned int i = 0; i < dimensions; ++i) {
+    // Round-trippable precision so a reloaded state hashes identically
+    snprintf(buf, BUFFER_SIZE, "%.17g", values[i]);
     state_vector.append(buf);
-    if (i+1 < state_vector_.size()) state_vector.append(",");
+    if (i+1 < dimensions) state_vector.append(",");
   }
   state_vector.append("\n");
 //  state_vector.append("Hash ");
 //  state_vector.append(this->get_state_hash());
 //  state_vector.append("\n");
   
-  map<State*, map<string, double> >::iterator reward_iter;
-  for (reward_iter = reward_.begin(); reward_iter != reward_.end();
-       ++reward_iter) {
-    State *to_state = reward_iter->first;
+  TransitionGraph::RewardLinkIterator reward_iter;
+  for (reward_iter = RewardLinks(); reward_iter.valid(); ++reward_iter) {
     snprintf(buf, BUFFER_SIZE, "Target %s\n",
-             to_state->get_state_hash().c_str());
+             HashToString(reward_iter.target()->get_state_hash()).c_str());
     reward_transitions.append(buf);
-  
-    map<string, double>::iterator layer_iter;
-    for (layer_iter = reward_iter->second.begin(); 
-         layer_iter != reward_iter->second.end();
-         ++layer_iter) {
-      string label = layer_iter->first;
-      double val = layer_iter->second;
-      snprintf(buf, BUFFER_SIZE, "Layer %s\nReward %g\n", label.c_str(), val);
-      reward_transitions.append(buf);        
+
+    for (LayerId layer = 0; layer < TransitionGraph::MAX_REWARD_LAYERS;
+         ++layer) {
+      double val = reward_iter.reward(layer);
+      if (val == 0.) continue;
+      snprintf(buf, BUFFER_SIZE, "Layer %s\nReward %g\n",
+               Registry::GetLayerName(layer).c_str(), val);
+      reward_transitions.append(buf);
     }
   }
 
-  vector<State*>::iterator  incoming_iter;
-  for (incoming_iter = incoming_states_.begin();
-       incoming_iter != incoming_states_.end();
-       incoming_iter++) {
+  TransitionGraph::IncomingLinkIterator incoming_iter;
+  for (incoming_iter = IncomingLinks(); incoming_iter.valid();
+       ++incoming_iter) {
     snprintf(buf, BUFFER_SIZE, "%s\n",
-             (*incoming_iter)->get_state_hash().c_str());
+             HashToString(incoming_iter.source()->get_state_hash()).c_str());
     incoming_states.append(buf);
   }
   
+  map<string, vector<pair<State *, int> > > out_transitions;
+  if (graph_) graph_->GetActionTransitions(graph_id_, &out_transitions);
   map<string, vector<pair<State *, int> > >::iterator action_iter;
   
-  for (action_iter = out_transitions_.begin();
-       action_iter != out_transitions_.end();
+  for (action_iter = out_transitions.begin();
+       action_iter != out_transitions.end();
        ++action_iter) {
     snprintf(buf, BUFFER_SIZE, "Action %s\n", action_iter->first.c_str());
     action_transitions.append(buf);
@@ -260,7 +307,7 @@ std::string State::serialize() {
          target_iter != action_iter->second.end();
          ++target_iter) {
       snprintf(buf, BUFFER_SIZE, "Target %s\nFrequency %d\n",
-               target_iter->first->get_state_hash().c_str(),
+               HashToString(target_iter->first->get_state_hash()).c_str(),
                target_iter->second);
       action_transitions.append(buf);
     }
@@ -288,17 +335,17 @@ std::vector<double> State::GetSquaredDistances(State const * const state)
   std::vector<double> distances;
   if (!state) return distances;
 
-  if (state->get_state_vector().size() != state_vector_.size())
+  unsigned int dimensions = get_dimensions();
+  if (state->get_dimensions() != dimensions)
     return distances;
 
-  vector<double> const &cmp_vector = state->get_state_vector();
+  double const *values = get_values();
+  double const *cmp_values = state->get_values();
 
-  double distance = 0.;
-  unsigned int idx;
-  for (idx = 0; idx < state_vector_.size(); ++idx) {
-    distance = (state_vector_[idx] - cmp_vector[idx])
-    * (state_vector_[idx] - cmp_vector[idx]);
-    distances.push_back(distance);
+  distances.resize(dimensions);
+  for (unsigned int idx = 0; idx < dimensions; ++idx) {
+    double diff = values[idx] - cmp_values[idx];
+    distances[idx] = diff * diff;
   }
 
   return distances;
@@ -306,82 +353,46 @@ std::vector<double> State::GetSquaredDistances(State const * const state)
 
 
 double State::GetEuclideanDistance(State const * const state) const {
-  std::vector<double> squared_dists = this->GetSquaredDistances(state);
-  
-  double real_dist = 0.;
-  
-  std::vector<double>::iterator iter;
-  for (iter = squared_dists.begin(); iter != squared_dists.end(); ++iter) {
-    real_dist += *iter;
-  }
-  
-  real_dist = sqrt(real_dist);
-  return real_dist;
+  if (!state || state->get_dimensions() != get_dimensions()) return 0.;
+  return sqrt(DistanceKernel::SquaredDistance(get_values(),
+                                              state->get_values(),
+                                              get_dimensions()));
 }
 
 
 double State::GetRewardValue(State *target, bool all_layers,
                               std::string layer) {
-  if (reward_.find(target) == reward_.end()) return 0.;
-  std::map<std::string, double> &reward_layers = reward_[target];
-  std::map<std::string, double>::const_iterator iter;
-
-  double total = 0.;
-  if (all_layers) {
-    for (iter = reward_layers.begin(); iter != reward_layers.end();
-        ++iter) {
-      total += (*iter).second;
-    }
-  } else {
-    iter = reward_layers.find(layer);
-    if (iter != reward_layers.end())
-      total = (*iter).second;
-  }
+  if (!graph_ || !target || target->graph_ != graph_) return 0.;
+  if (all_layers) return graph_->GetTotalReward(graph_id_, target->graph_id_);
+
+  LayerId layer_id;
+  if (!Registry::FindLayer(layer, &layer_id)) return 0.;
+  return graph_->GetReward(graph_id_, target->graph_id_, layer_id);
+}
 
-    return total;
+double State::GetRewardValue(State *target, LayerId layer) {
+  if (!graph_ || !target || target->graph_ != graph_) return 0.;
+  return graph_->GetReward(graph_id_, target->graph_id_, layer);
+}
+
+std::map<State*, std::map<std::string, double> > State::get_reward() const {
+  std::map<State*, std::map<std::string, double> > rewards;
+  if (graph_) graph_->GetRewards(graph_id_, &rewards);
+  return rewards;
+}
+
+std::vector<State *> State::get_incoming_states() const {
+  std::vector<State *> incoming;
+  if (graph_) graph_->GetIncoming(graph_id_, &incoming);
+  return incoming;
 }
 
 std::string State::GetActionForTransition(State *target_state) {
-  using std::pair;
-  using std::string;
-  using std::map;
-  using std::vector;
-  
-  map<string, vector<pair<State *, int> > >::iterator action_iter;
-  double best_probability = 0.;
-  string best_action = "";
-  
-  // Iterate over all known action transitions from this state
-  for (action_iter = this->out_transitions_.begin();
-       action_iter != this->out_transitions_.end();
-       ++action_iter) {
-      vector<pair<State *, int> > &destinations = action_iter->second;
-      vector<pair<State *, int> >::iterator iter;      
-      
-      // Count how many transition examples we have from a given action
-      double total_entries = 0.;
-      double action_prb = 0.;  // Probability of going to target_state with
-                               // this action
-                              
-      // Iterate over all states previously reached with this action
-      for (iter = destinations.begin(); iter != destinations.end(); ++iter) {
-        total_entries += (*iter).second;
-        if ((*iter).first == target_state) {
-          double prb = static_cast<double>((*iter).second);
-          action_prb = prb;
-        }
-      }
-      
-      action_prb /= total_entries;  // Normalize the probability
-      
-      // Keep track of the best possible action to reach the desired state
-      if (action_prb > best_probability) {
-        best_probability = action_prb;
-        best_action = action_iter->first;
-      }
-  }
-  
-  return best_action;
+  if (!graph_ || !target_state || target_state->graph_ != graph_) return "";
+  ActionId action;
+  if (!graph_->GetBestAction(graph_id_, target_state->graph_id_, &action))
+    return "";
+  return Registry::GetActionName(action);
 }
 
 
@@ -391,98 +402,41 @@ bool State::ConnectState(State *target, std::string action) {
 
 bool State::ConnectState(State *target, std::string action, 
                          int default_frequency) {
-  using std::pair;
-  using std::string;
-  using std::map;
-  using std::vector;
-  
-  map<string, vector<pair<State *, int> > >::iterator
-      iter;
-
-  // See if this action has already been transitioned from in this state
-  iter = this->out_transitions_.find(action);
-
-  // If action hasn't been done yet, add it to the action/transition map
-  if (iter == this->out_transitions_.end()) {
-    vector<pair<State *, int> > transition_probabilities;
-    pair<State *, int> transition(target, default_frequency);
-    transition_probabilities.push_back(transition);
-    this->out_transitions_[action] = transition_probabilities;
-  } else {
-    // Have done this action before, so just add the new transition info
-    vector<pair<State *, int> > &transition_probabilities = iter->second;
-    vector<pair<State *, int> >::iterator state_iter;
-    
-    bool found_state = false;
-    for (state_iter = transition_probabilities.begin();
-         state_iter != transition_probabilities.end();
-         ++state_iter) {
-      if (state_iter->first == target) {
-        ++(state_iter->second);
-        found_state = true;
-        break;
-      }
-    }
-    
-    // If we've never transitioned to this state with this action, add it
-    if (!found_state) {
-      pair<State *, int> transition(target, default_frequency);
-      transition_probabilities.push_back(transition);
-    }
+  return ConnectState(target, Registry::InternAction(action),
+                      default_frequency);
+}
+
+bool State::ConnectState(State *target, ActionId action,
+                         int default_frequency) {
+  if (!graph_ || !target || target->graph_ != graph_) {
+    Log(stderr, ERROR, "ConnectState: States aren't in the same QTable");
+    return false;
   }
+  graph_->Connect(graph_id_, target->graph_id_, action, default_frequency);
   return true;
 }
 
 void State::set_reward(State *target, std::string layer, double val) {
-  if (target == NULL) return;
-  std::vector<State *> &inc_states = target->get_incoming_states();
-
-  // If setting the reward layer to something
-  if (val != 0) {
-    std::map<State*, std::map<std::string, double> >::iterator
-      layer_map = (reward_.find(target));
-
-    // If there is no existing link to target, make one
-    if (layer_map == reward_.end()) {
-      reward_[target] = std::map<std::string, double>();
-    }
-    (reward_[target])[layer] = val;
-
-
-    vector<State *>::iterator inc_iter;
-    bool found = false;
-    for (inc_iter = inc_states.begin(); inc_iter != inc_states.end();
-         ++inc_iter) {
-      if ((*inc_iter)->Equals(this)) {
-        found = true;
-        break;
-      }
-    }
+  LayerId layer_id;
+  bool known = val == 0. ? Registry::FindLayer(layer, &layer_id)
+                         : Registry::InternLayer(layer, &layer_id);
+  if (!known) {
+    if (val == 0.) return;
+    char buf[1024];
+    snprintf(buf, 1024, "set_reward: No room for reward layer %s",
+             layer.c_str());
+    Log(stderr, ERROR, buf);
+    return;
+  }
+  set_reward(target, layer_id, val);
+}
 
-    if (!found)
-      inc_states.push_back(this);
-  } else {
-    if (reward_.find(target) == reward_.end()) return;
-
-    // Clearing the reward layer away
-    std::map<std::string, double>::iterator iter;
-    iter = (reward_[target]).find(layer);
-    if (iter != reward_[target].end())
-      (reward_[target]).erase(iter);
-
-    if (reward_[target].size() == 0) {
-      vector<State *>::iterator inc_iter;
-      bool found = false;
-      for (inc_iter = inc_states.begin(); inc_iter != inc_states.end();
-           ++inc_iter) {
-        if (*inc_iter == this) {
-          found = true;
-          break;
-        }
-      }
-      if (found)
-        inc_states.erase(inc_iter);
-    }
+void State::set_reward(State *target, LayerId layer, double val) {
+  if (target == NULL) return;
+  if (!graph_ || target->graph_ != graph_) {
+    Log(stderr, ERROR, "set_reward: States aren't in the same QTable");
+    return;
   }
+  graph_->SetReward(graph_id_, target->graph_id_, layer, val);
 }
 }  // namespace primitives
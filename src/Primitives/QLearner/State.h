@@ -12,7 +12,7 @@
 #define _SHL_PRIMITIVES_QLEARNER_STATE_H_
 
 #include <stdio.h>
-#include <hashlibpp.h>
+#include <stdint.h>
 #include <cstdlib>
 #include <utility>
 #include <vector>
@@ -22,6 +22,9 @@
 #include <string>
 #include "Common/Utils.h"
 #include "Primitives/QLearner/Action.h"
+#include "Primitives/QLearner/Registry.h"
+#include "Primitives/QLearner/StateArena.h"
+#include "Primitives/QLearner/TransitionGraph.h"
 
 namespace Primitives {
 using std::vector;
@@ -37,26 +40,47 @@ class State {
    * @param state_descriptor    Description of state being represented
    **/
   explicit State(const std::vector<double> &state_descriptor)
-    : state_vector_(state_descriptor), out_transitions_sample_count_(0) { 
+    : state_vector_(state_descriptor), arena_(NULL), arena_row_(0),
+      graph_(NULL), graph_id_(0) { 
     generateHash();
   }
 
   /**
-   * Copy constructor. Disregards all state transitions from s.
+   * Copy constructor. Disregards all state transitions from s. The copy owns
+   * its own state vector, even if s is a handle into a QTable's arena.
    **/
-  explicit State(State const &s) : state_vector_(s.get_state_vector()),
-      out_transitions_sample_count_(0) {
+  explicit State(State const &s)
+    : state_vector_(s.get_values(), s.get_values() + s.get_dimensions()),
+      arena_(NULL), arena_row_(0), graph_(NULL), graph_id_(0) {
     generateHash();        
   }
 
+  /**
+   * Constructs a lightweight handle to a state vector already stored in a
+   * QTable's arena. The arena must outlive the State.
+   *
+   * @param arena Storage holding the state vector
+   * @param row Row of arena holding the state vector
+   **/
+  explicit State(StateArena const *arena, unsigned int row)
+    : arena_(arena), arena_row_(row), graph_(NULL), graph_id_(0) {
+    generateHash();
+  }
+
   /**
    * Shouldn't have to free anything here
    **/
   virtual ~State() {}
 
+  /**
+   * Number of low-order mantissa bits ignored when hashing or comparing
+   * state vector values, so floating point noise doesn't split a state
+   **/
+  static const unsigned int HASH_QUANTIZATION_BITS = 8;
+
   /**
    * Determines if this state is equal to the provided state parameter by
-   * comparing the state_vector_ variables in each.
+   * comparing the hashes, then the quantized state_vector_ values, of each.
    * @param state State to compare to
    * @return true if state vectors are equal, false if not
    **/
@@ -75,7 +99,7 @@ class State {
    * END {BLOCK}
    * 
    * Block "rewards"
-   * Line 1: "Target " + MD5 Target Hash
+   * Line 1: "Target " + Target Hash (hex)
    * Line 2: Layer Name
    * Line 3: Reward Value
    * Line 4: Layer Name
@@ -84,20 +108,15 @@ class State {
    * Block "incoming"
    * Line 1: Incoming state hash
    * 
-  std::vector<double> state_vector_;
-  std::map<State*, std::map<std::string, double> > reward_;
-  std::vector<State*> incoming_states_;
-  
-  // Maps action IDs (strings) to a list of states/probabilities
-  std::map<std::string, std::vector<std::pair<State *, int> > > 
-      out_transitions_;
-  unsigned int out_transitions_sample_count_;
-
+   * Block "actions"
+   * Line 1: "Action " + Serialized Action
+   * Line 2: "Target " + Target Hash (hex)
+   * Line 3: "Frequency " + Transition Count
    */
   virtual std::string serialize();
   
   virtual bool unserialize(std::vector<std::string> const &contents,
-                           std::map<std::string, State*> &hash_map);
+                           std::map<uint64_t, State*> &hash_map);
 
   /**
    * Finds the euclidean squared distance between two states
@@ -123,15 +142,34 @@ class State {
   virtual double GetRewardValue(State *target, bool all_layers = true,
                                 std::string layer = "");
 
+  /**
+   * @return Reward of a single layer on the link to target, 0 if unset
+   **/
+  double GetRewardValue(State *target, LayerId layer);
+
 
   /**
-   * Returns an immutable state descriptor vector of doubles.
+   * Returns a copy of the state descriptor vector of doubles. Prefer
+   * get_values() on hot paths, which doesn't allocate.
    *
-   * @return    Const reference to state descriptor
+   * @return    Copy of state descriptor
    **/
   virtual std::vector<double> get_state_vector() const {
-    return state_vector_;
+    return std::vector<double>(get_values(), get_values() + get_dimensions());
   };
+
+  /**
+   * @return Pointer to the get_dimensions() state descriptor values, either
+   *         in the owning QTable's arena or in this State's own vector
+   **/
+  double const *get_values() const {
+    if (arena_) return arena_->Row(arena_row_);
+    return state_vector_.empty() ? NULL : &state_vector_[0];
+  }
+
+  unsigned int get_dimensions() const {
+    return arena_ ? arena_->get_dimensions() : state_vector_.size();
+  }
   
   
   
@@ -148,7 +186,8 @@ class State {
 
   /**
    * Associates an transition count with a target state/action pair, which
-   * can be used to determine transition probabilities for an action.
+   * can be used to determine transition probabilities for an action. Only
+   * states inside a QTable can hold transitions.
    * 
    * @param target State pointer to state **internal** to the skill's QTable
    * @param action Serialized action to be associated with the transition
@@ -156,75 +195,128 @@ class State {
   virtual bool ConnectState(State *target, std::string action);
   virtual bool ConnectState(State *target, std::string action,
                             int default_frequency);
+  bool ConnectState(State *target, ActionId action, int default_frequency);
   /**
-   * Sets a reward with key 'layer' to value 'val' on this state
+   * Sets a reward with key 'layer' to value 'val' on the link from this
+   * state to target. Both must be internal to the same QTable.
    *
    * @param layer Keyword associated with value
    * @param val Reward value to assign
    **/
   virtual void set_reward(State *target, std::string layer, double val);
+  void set_reward(State *target, LayerId layer, double val);
 
 
   /**
-   * Retrieves the reward (transition function) on this state object
+   * Retrieves the reward (transition function) on this state object. Built
+   * from the QTable's transition graph on every call, so prefer
+   * RewardLinks() on hot paths.
    * @return Function mapping State* to reward layers
    */
-  virtual std::map<State*, std::map<std::string, double> > get_reward() const {
-    return reward_;
+  virtual std::map<State*, std::map<std::string, double> > get_reward() const;
+
+  /**
+   * @return Copy of the states with a reward link into this state, in the
+   *         order the links were made. Prefer IncomingLinks() on hot paths.
+   **/
+  virtual std::vector<State *> get_incoming_states() const;
+
+  /**
+   * @return Allocation-free iterator over this state's outgoing reward
+   *         links; empty if the state isn't in a QTable
+   **/
+  TransitionGraph::RewardLinkIterator RewardLinks() const {
+    if (!graph_) return TransitionGraph::RewardLinkIterator();
+    return graph_->RewardLinks(graph_id_);
   }
 
-  virtual std::vector<State *> &get_incoming_states() {
-    return incoming_states_;
+  /**
+   * Finds the greedy successor of this state from its QTable's cached
+   * policy: the reward link with the highest total reward, the earliest
+   * created winning ties
+   *
+   * @param successor Populated with the QTable-internal successor
+   * @param value Populated with the total reward of the link to it
+   * @return false if this state has no reward links
+   **/
+  bool GetBestSuccessor(State **successor, double *value) const {
+    unsigned int target;
+    if (!graph_ || !graph_->GetBestSuccessor(graph_id_, &target, value))
+      return false;
+    *successor = graph_->get_state(target);
+    return true;
+  }
+
+  /**
+   * @return Allocation-free iterator over the states linking into this one;
+   *         empty if the state isn't in a QTable
+   **/
+  TransitionGraph::IncomingLinkIterator IncomingLinks() const {
+    if (!graph_) return TransitionGraph::IncomingLinkIterator();
+    return graph_->IncomingLinks(graph_id_);
+  }
+
+  /**
+   * Attaches this state to its QTable's transition graph. Called by QTable
+   * when the state is added.
+   *
+   * @param graph Graph holding this state's links
+   * @param id Dense id of this state within graph
+   **/
+  void set_graph(TransitionGraph *graph, unsigned int id) {
+    graph_ = graph;
+    graph_id_ = id;
   }
 
+  TransitionGraph *get_graph() const { return graph_; }
+  unsigned int get_graph_id() const { return graph_id_; }
+
   virtual std::string to_string() {
-    char buf[4096];
-    unsigned int state_count = state_vector_.size();
+    char buf[64];
+    std::string str;
+    double const *values = get_values();
+    unsigned int state_count = get_dimensions();
     for (unsigned int i = 0; i < state_count; ++i) {
-      if (i)
-        snprintf(buf, sizeof(buf), "%s, %g", buf, state_vector_[i]);
-      else
-        snprintf(buf, sizeof(buf), "%g", state_vector_[i]);
+      snprintf(buf, sizeof(buf), i ? ", %g" : "%g", values[i]);
+      str.append(buf);
     }
-    return std::string(buf);
+    return str;
   }
 
-  std::string get_state_hash() const { return state_hash_; }
+  uint64_t get_state_hash() const { return state_hash_; }
+
+  /**
+   * Formats a state hash as the fixed-width hex string used in serialized
+   * QTables
+   **/
+  static std::string HashToString(uint64_t hash);
+
+  /**
+   * Parses a hex state hash written by HashToString
+   **/
+  static uint64_t HashFromString(std::string const &hash_str);
 
  private:
-  explicit State() {}
-  
+  explicit State()
+    : arena_(NULL), arena_row_(0), graph_(NULL), graph_id_(0) {}
+
   /**
-   * Populates the state_hash_ with an MD5 hash of the state vector values
+   * Populates the state_hash_ with a 64-bit hash of the quantized binary
+   * state vector values. Doesn't allocate.
    */
-  void generateHash() {
-    hashwrapper *hash_gen = new md5wrapper();
-    char buf[4096];
-    std::string buf_str;
-    if (state_vector_.size() == 0) return;
-    
-    snprintf(buf, sizeof(buf), "%g", state_vector_[0]);
-    buf_str = std::string(buf);
-    for (unsigned int i = 1; i < state_vector_.size(); ++i) {
-     memset(buf, 0, sizeof(buf));
-     snprintf(buf, sizeof(buf), "%g", state_vector_[i]);
-     buf_str.append(buf);
-    }
-
-    state_hash_ = hash_gen->getHashFromString(std::string(buf));
-  }
-  
+  void generateHash();
 
+  // Only used by standalone states; QTable states live in arena_
   std::vector<double> state_vector_;
-  std::map<State*, std::map<std::string, double> > reward_;
-  std::vector<State*> incoming_states_;
-  
-  // Maps action IDs (strings) to a list of states/probabilities
-  std::map<std::string, std::vector<std::pair<State *, int> > > 
-      out_transitions_;
-  unsigned int out_transitions_sample_count_;
-  
-  std::string state_hash_;  // MD5 Hash of State Vector
+  StateArena const *arena_;
+  unsigned int arena_row_;
+
+  // Rewards, incoming links and action transitions live in the QTable's
+  // graph; standalone states have none
+  TransitionGraph *graph_;
+  unsigned int graph_id_;
+
+  uint64_t state_hash_;  // Hash of quantized State Vector
 };
 
 }  // namespace Primitives
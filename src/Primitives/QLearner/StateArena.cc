@@ -0,0 +1,40 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of the contiguous QTable state vector storage
+ **/
+
+#include "QLearner/StateArena.h"
+
+namespace Primitives {
+
+bool StateArena::Append(double const *values, unsigned int dimensions,
+                        unsigned int *row) {
+  if (dimensions == 0) return false;
+  if (rows_ == 0) {
+    dimensions_ = dimensions;
+    values_.reserve(reserved_rows_ * dimensions_);
+  }
+  if (dimensions != dimensions_) return false;
+
+  values_.insert(values_.end(), values, values + dimensions);
+  *row = rows_++;
+  return true;
+}
+
+void StateArena::Reserve(unsigned int row_count) {
+  reserved_rows_ = row_count;
+  if (dimensions_ > 0) values_.reserve(row_count * dimensions_);
+}
+
+void StateArena::Clear() {
+  dimensions_ = 0;
+  rows_ = 0;
+  values_.clear();
+}
+
+}  // namespace Primitives
@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for the contiguous storage of QTable state vectors.
+ *
+ * Every state vector in a table is packed row-wise into one array of doubles,
+ * dimensions_ values per row, so distance scans stream through memory instead
+ * of chasing a separately allocated vector for every state. Internal States
+ * are handles that refer to their row by number; rows are never moved or
+ * removed, so a row number stays valid as the arena grows.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_STATEARENA_H_
+#define _SHL_PRIMITIVES_QLEARNER_STATEARENA_H_
+
+#include <vector>
+
+namespace Primitives {
+
+class StateArena {
+ public:
+  StateArena() : dimensions_(0), rows_(0), reserved_rows_(0) {}
+
+  /**
+   * Copies a state vector into the next free row. The first row appended
+   * fixes the dimensionality of the arena.
+   *
+   * @param values State vector values to copy
+   * @param dimensions Number of values
+   * @param row Populated with the row number the values were stored at
+   * @return false (and nothing stored) if dimensions doesn't match the arena
+   **/
+  bool Append(double const *values, unsigned int dimensions,
+              unsigned int *row);
+
+  /**
+   * Pre-allocates space for row_count rows. If no row has been appended yet
+   * the allocation happens once the first row fixes the dimensionality.
+   *
+   * @param row_count Anticipated total number of rows
+   **/
+  void Reserve(unsigned int row_count);
+
+  /**
+   * Removes every row and forgets the dimensionality
+   **/
+  void Clear();
+
+  /**
+   * @return Pointer to the first of dimensions_ values stored in row. Only
+   *         valid until the next Append.
+   **/
+  double const *Row(unsigned int row) const {
+    return &values_[row * dimensions_];
+  }
+
+  unsigned int size() const { return rows_; }
+  unsigned int get_dimensions() const { return dimensions_; }
+
+ private:
+  unsigned int dimensions_;
+  unsigned int rows_;
+  unsigned int reserved_rows_;
+
+  /**
+   * Row-packed values of every state vector, dimensions_ doubles per row
+   **/
+  std::vector<double> values_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_STATEARENA_H_
@@ -0,0 +1,111 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is a fixed-capacity ring buffer of recently entered states and the
+ * times they were entered.  Once full, each new state overwrites the
+ * oldest, so a long-running learner's history stays bounded.
+ *
+ * Entries are addressed by age: 0 is the newest.  States and timestamps
+ * are kept in separate arrays so credit assignment can walk recent history
+ * in one tight pass.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_STATEHISTORY_H_
+#define _SHL_PRIMITIVES_QLEARNER_STATEHISTORY_H_
+
+#include <vector>
+
+namespace Primitives {
+
+class State;
+
+class StateHistory {
+ public:
+  static const unsigned int DEFAULT_CAPACITY = 1024;
+
+  explicit StateHistory(unsigned int capacity = DEFAULT_CAPACITY)
+    : next_(0), size_(0) {
+    set_capacity(capacity);
+  }
+
+  /**
+   * Records that state was entered at timestamp, dropping the oldest entry
+   * if the history is full
+   *
+   * @param timestamp System time in milliseconds when state was entered
+   **/
+  void Push(State *state, double timestamp) {
+    states_[next_] = state;
+    timestamps_[next_] = timestamp;
+    next_ = (next_ + 1) % states_.size();
+    if (size_ < states_.size()) ++size_;
+  }
+
+  /**
+   * @return State entered age entries ago; age must be less than size()
+   **/
+  State *GetState(unsigned int age) const { return states_[Slot(age)]; }
+
+  /**
+   * @return Time in milliseconds the state age entries ago was entered
+   **/
+  double GetTimestamp(unsigned int age) const {
+    return timestamps_[Slot(age)];
+  }
+
+  /**
+   * @return Newest state, or NULL if the history is empty
+   **/
+  State *top() const { return size_ > 0 ? GetState(0) : NULL; }
+
+  bool empty() const { return size_ == 0; }
+  unsigned int size() const { return size_; }
+  unsigned int get_capacity() const { return states_.size(); }
+
+  /**
+   * Resizes the ring, keeping the newest entries that fit
+   *
+   * @param capacity Maximum entries kept (at least 1)
+   **/
+  void set_capacity(unsigned int capacity) {
+    if (capacity == 0) capacity = 1;
+    unsigned int kept = size_ < capacity ? size_ : capacity;
+
+    // Unroll oldest-first into the new arrays
+    std::vector<State *> states(capacity, static_cast<State *>(NULL));
+    std::vector<double> timestamps(capacity, 0.);
+    for (unsigned int i = 0; i < kept; ++i) {
+      states[i] = GetState(kept - 1 - i);
+      timestamps[i] = GetTimestamp(kept - 1 - i);
+    }
+
+    states_.swap(states);
+    timestamps_.swap(timestamps);
+    size_ = kept;
+    next_ = kept % capacity;
+  }
+
+  void Clear() {
+    size_ = 0;
+    next_ = 0;
+  }
+
+ private:
+  unsigned int Slot(unsigned int age) const {
+    unsigned int capacity = states_.size();
+    return (next_ + capacity - 1 - age) % capacity;
+  }
+
+  std::vector<State *> states_;
+  std::vector<double> timestamps_;
+  unsigned int next_;
+  unsigned int size_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_STATEHISTORY_H_
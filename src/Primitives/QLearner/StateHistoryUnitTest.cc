@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the bounded state history ring
+ **/
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "QLearner/StandardQLearner.h"
+#include "QLearner/State.h"
+#include "QLearner/StateHistory.h"
+
+namespace Primitives {
+
+/**
+ * @test    The ring keeps the newest entries, addressed newest first, and
+ *          resizing keeps as many of them as fit
+ **/
+TEST(StateHistoryTest, Ring) {
+  std::vector<State *> states;
+  for (int i = 0; i < 10; ++i)
+    states.push_back(new State(std::vector<double>(1, i)));
+
+  StateHistory history(4);
+  EXPECT_TRUE(history.empty());
+  EXPECT_TRUE(history.top() == NULL);
+  for (int i = 0; i < 10; ++i)
+    history.Push(states[i], 100. * i);
+
+  ASSERT_EQ(4u, history.size());
+  EXPECT_EQ(states[9], history.top());
+  for (unsigned int age = 0; age < 4; ++age) {
+    EXPECT_EQ(states[9 - age], history.GetState(age));
+    EXPECT_DOUBLE_EQ(100. * (9 - age), history.GetTimestamp(age));
+  }
+
+  history.set_capacity(2);
+  ASSERT_EQ(2u, history.size());
+  EXPECT_EQ(states[8], history.GetState(1));
+  history.set_capacity(5);
+  history.Push(states[0], 0.);
+  ASSERT_EQ(3u, history.size());
+  EXPECT_EQ(states[0], history.GetState(0));
+  EXPECT_EQ(states[8], history.GetState(2));
+
+  history.Clear();
+  EXPECT_TRUE(history.empty());
+  for (int i = 0; i < 10; ++i)
+    delete states[i];
+}
+
+/**
+ * @test    Learners keep a bounded history of their current states
+ **/
+TEST(StateHistoryTest, LearnerHistory) {
+  StandardQLearner skill("history");
+  State state(std::vector<double>(1, 0.));
+  EXPECT_TRUE(skill.get_current_state() == NULL);
+  for (unsigned int i = 0; i < StateHistory::DEFAULT_CAPACITY + 10; ++i)
+    skill.SetCurrentState(&state);
+  EXPECT_EQ(&state, skill.get_current_state());
+  EXPECT_EQ(static_cast<unsigned int>(StateHistory::DEFAULT_CAPACITY),
+            skill.get_state_history().size());
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,251 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of the QTable transition graph
+ **/
+
+#include "QLearner/TransitionGraph.h"
+#include "Common/Utils.h"
+
+namespace Primitives {
+
+unsigned int TransitionGraph::AddNode(State *state) {
+  states_.push_back(state);
+  rewards_.Resize(states_.size());
+  incoming_.Resize(states_.size());
+  actions_.Resize(states_.size());
+
+  PolicyEntry entry;
+  entry.target_ = NO_SUCCESSOR;
+  entry.value_ = 0.;
+  entry.stale_ = false;
+  policy_.push_back(entry);
+  node_version_.push_back(++version_);
+  return states_.size() - 1;
+}
+
+void TransitionGraph::SetReward(unsigned int source, unsigned int target,
+                                LayerId layer, double val) {
+  if (layer >= MAX_REWARD_LAYERS) return;
+
+  reward_iterator iter;
+  for (iter = rewards_.Begin(source); iter.valid(); ++iter) {
+    if (iter->target_ == target) break;
+  }
+
+  if (!iter.valid()) {
+    if (val == 0.) return;
+    TouchNode(source);
+    RewardEdge edge;
+    edge.target_ = target;
+    for (unsigned int i = 0; i < MAX_REWARD_LAYERS; ++i)
+      edge.rewards_[i] = 0.;
+    edge.rewards_[layer] = val;
+    rewards_.Append(source, edge);
+
+    IncomingEdge incoming;
+    incoming.source_ = source;
+    incoming_.Append(target, incoming);
+
+    UpdatePolicy(source, target, val, true);
+    return;
+  }
+
+  if (iter->rewards_[layer] == val) return;
+  iter->rewards_[layer] = val;
+  TouchNode(source);
+
+  // Drop the link once its last layer is cleared
+  bool empty = val == 0.;
+  for (unsigned int i = 0; empty && i < MAX_REWARD_LAYERS; ++i) {
+    if (iter->rewards_[i] != 0.) empty = false;
+  }
+  if (!empty) {
+    UpdatePolicy(source, target, SumRewards(*iter), false);
+    return;
+  }
+
+  iter.Remove();
+  RemoveIncoming(source, target);
+  if (policy_[source].target_ == target) policy_[source].stale_ = true;
+}
+
+double TransitionGraph::GetReward(unsigned int source, unsigned int target,
+                                  LayerId layer) {
+  if (layer >= MAX_REWARD_LAYERS) return 0.;
+
+  for (reward_iterator iter = rewards_.Begin(source); iter.valid(); ++iter) {
+    if (iter->target_ == target) return iter->rewards_[layer];
+  }
+  return 0.;
+}
+
+double TransitionGraph::GetTotalReward(unsigned int source,
+                                       unsigned int target) {
+  for (reward_iterator iter = rewards_.Begin(source); iter.valid(); ++iter) {
+    if (iter->target_ == target) return SumRewards(*iter);
+  }
+  return 0.;
+}
+
+void TransitionGraph::GetRewards(
+    unsigned int source,
+    std::map<State*, std::map<std::string, double> > *rewards) {
+  for (reward_iterator iter = rewards_.Begin(source); iter.valid(); ++iter) {
+    std::map<std::string, double> &layers = (*rewards)[states_[iter->target_]];
+    for (LayerId layer = 0; layer < MAX_REWARD_LAYERS; ++layer) {
+      if (iter->rewards_[layer] != 0.)
+        layers[Registry::GetLayerName(layer)] = iter->rewards_[layer];
+    }
+  }
+}
+
+void TransitionGraph::GetIncoming(unsigned int target,
+                                  std::vector<State *> *sources) {
+  CompactAdjacency<IncomingEdge>::iterator iter;
+  for (iter = incoming_.Begin(target); iter.valid(); ++iter) {
+    sources->push_back(states_[iter->source_]);
+  }
+}
+
+void TransitionGraph::RemoveIncoming(unsigned int source,
+                                     unsigned int target) {
+  CompactAdjacency<IncomingEdge>::iterator iter;
+  for (iter = incoming_.Begin(target); iter.valid(); ++iter) {
+    if (iter->source_ == source) {
+      iter.Remove();
+      return;
+    }
+  }
+}
+
+void TransitionGraph::UpdatePolicy(unsigned int source, unsigned int target,
+                                   double total, bool appended) {
+  PolicyEntry &entry = policy_[source];
+  if (entry.stale_) return;
+
+  if (entry.target_ == target) {
+    // The best link only stays best if it didn't lose value
+    if (total >= entry.value_)
+      entry.value_ = total;
+    else
+      entry.stale_ = true;
+  } else if (entry.target_ == NO_SUCCESSOR || total > entry.value_) {
+    entry.target_ = target;
+    entry.value_ = total;
+  } else if (total == entry.value_ && !appended) {
+    // A tie is won by whichever link is older, which takes a rescan
+    entry.stale_ = true;
+  }
+}
+
+void TransitionGraph::RecomputePolicy(unsigned int source) {
+  PolicyEntry &entry = policy_[source];
+  entry.target_ = NO_SUCCESSOR;
+  entry.value_ = 0.;
+  entry.stale_ = false;
+
+  for (reward_iterator iter = rewards_.Begin(source); iter.valid(); ++iter) {
+    double total = SumRewards(*iter);
+    if (entry.target_ == NO_SUCCESSOR || total > entry.value_) {
+      entry.target_ = iter->target_;
+      entry.value_ = total;
+    }
+  }
+}
+
+void TransitionGraph::RecomputePolicy() {
+  for (unsigned int source = 0; source < policy_.size(); ++source)
+    RecomputePolicy(source);
+}
+
+bool TransitionGraph::GetBestSuccessor(unsigned int source,
+                                       unsigned int *target, double *value) {
+  if (policy_[source].stale_) RecomputePolicy(source);
+
+  PolicyEntry const &entry = policy_[source];
+  if (entry.target_ == NO_SUCCESSOR) return false;
+  *target = entry.target_;
+  *value = entry.value_;
+  return true;
+}
+
+void TransitionGraph::Connect(unsigned int source, unsigned int target,
+                              ActionId action, int frequency) {
+  TouchNode(source);
+  CompactAdjacency<ActionEdge>::iterator iter;
+  for (iter = actions_.Begin(source); iter.valid(); ++iter) {
+    if (iter->action_ == action && iter->target_ == target) {
+      ++(iter->frequency_);
+      return;
+    }
+  }
+
+  ActionEdge edge;
+  edge.action_ = action;
+  edge.target_ = target;
+  edge.frequency_ = frequency;
+  actions_.Append(source, edge);
+}
+
+bool TransitionGraph::GetBestAction(unsigned int source, unsigned int target,
+                                    ActionId *action) {
+  // Per action: (total samples, samples reaching target)
+  std::map<ActionId, std::pair<double, double> > counts;
+  CompactAdjacency<ActionEdge>::iterator iter;
+  for (iter = actions_.Begin(source); iter.valid(); ++iter) {
+    std::pair<double, double> &count = counts[iter->action_];
+    count.first += iter->frequency_;
+    if (iter->target_ == target) count.second = iter->frequency_;
+  }
+
+  double best_probability = 0.;
+  bool found = false;
+  std::map<ActionId, std::pair<double, double> >::iterator count_iter;
+  for (count_iter = counts.begin(); count_iter != counts.end(); ++count_iter) {
+    double probability = count_iter->second.second / count_iter->second.first;
+    if (probability > best_probability
+        || (found && probability == best_probability
+            && Registry::GetActionName(count_iter->first)
+               < Registry::GetActionName(*action))) {
+      best_probability = probability;
+      *action = count_iter->first;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+void TransitionGraph::GetActionTransitions(
+    unsigned int source,
+    std::map<std::string, std::vector<std::pair<State *, int> > >
+      *transitions) {
+  CompactAdjacency<ActionEdge>::iterator iter;
+  for (iter = actions_.Begin(source); iter.valid(); ++iter) {
+    (*transitions)[Registry::GetActionName(iter->action_)].push_back(
+      std::make_pair(states_[iter->target_], iter->frequency_));
+  }
+}
+
+void TransitionGraph::Compact() {
+  rewards_.Compact();
+  incoming_.Compact();
+  actions_.Compact();
+}
+
+void TransitionGraph::Clear() {
+  states_.clear();
+  policy_.clear();
+  node_version_.clear();
+  MarkStructureChanged();
+  rewards_.Clear();
+  incoming_.Clear();
+  actions_.Clear();
+}
+
+}  // namespace Primitives
@@ -0,0 +1,345 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for the QTable-owned transition graph, holding every
+ * reward link, incoming link and action transition between the table's
+ * states.
+ *
+ * States are numbered densely in the order they join the table. Reward
+ * links keep one value per reward layer in fixed slots instead of a map
+ * keyed by layer name (slots are Registry layer IDs), and actions are
+ * stored as Registry action IDs. All three kinds of edge are stored in
+ * CompactAdjacency lists, so an edge costs a few bytes in a shared array
+ * instead of several map nodes.
+ *
+ * The graph also caches each state's greedy policy: the reward link with
+ * the highest total reward (the earliest such link on ties). SetReward
+ * keeps the cache current where it can do so in O(1) and otherwise marks
+ * it stale, to be rebuilt on the next lookup.
+ *
+ * Every change bumps a version counter, and each state remembers the
+ * version at which its outgoing links last changed, so results derived
+ * from part of the graph (like cached paths) can tell whether that part
+ * has changed since.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_TRANSITIONGRAPH_H_
+#define _SHL_PRIMITIVES_QLEARNER_TRANSITIONGRAPH_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "QLearner/CompactAdjacency.h"
+#include "QLearner/Registry.h"
+
+namespace Primitives {
+
+class State;
+
+class TransitionGraph {
+ public:
+  /**
+   * Number of distinct reward layers a graph can hold
+   **/
+  static const unsigned int MAX_REWARD_LAYERS = Registry::MAX_LAYERS;
+
+  /**
+   * A reward link to target. A layer is set when its value is non-zero;
+   * the link is removed once every layer is cleared.
+   **/
+  struct RewardEdge {
+    unsigned int target_;
+    double rewards_[MAX_REWARD_LAYERS];
+  };
+
+  struct IncomingEdge {
+    unsigned int source_;
+  };
+
+  /**
+   * frequency_ samples of action leading to target
+   **/
+  struct ActionEdge {
+    ActionId action_;
+    unsigned int target_;
+    int frequency_;
+  };
+
+  typedef CompactAdjacency<RewardEdge>::iterator reward_iterator;
+
+  /**
+   * Walks the reward links out of one state without copying them. Changing
+   * or clearing the rewards of existing links is safe mid-walk; adding a
+   * link invalidates the iterator.
+   **/
+  class RewardLinkIterator {
+   public:
+    RewardLinkIterator() : graph_(NULL) {}
+
+    bool valid() const { return graph_ != NULL && iter_.valid(); }
+    RewardLinkIterator &operator++() {
+      ++iter_;
+      return *this;
+    }
+
+    State *target() const { return graph_->get_state(iter_->target_); }
+    unsigned int target_id() const { return iter_->target_; }
+    double reward(LayerId layer) const { return iter_->rewards_[layer]; }
+    double total_reward() const { return SumRewards(*iter_); }
+
+   private:
+    friend class TransitionGraph;
+
+    RewardLinkIterator(TransitionGraph *graph, unsigned int source)
+      : graph_(graph), iter_(graph->rewards_.Begin(source)) {}
+
+    TransitionGraph *graph_;
+    reward_iterator iter_;
+  };
+
+  /**
+   * Walks the states with a reward link into one state, under the same
+   * rules as RewardLinkIterator
+   **/
+  class IncomingLinkIterator {
+   public:
+    IncomingLinkIterator() : graph_(NULL) {}
+
+    bool valid() const { return graph_ != NULL && iter_.valid(); }
+    IncomingLinkIterator &operator++() {
+      ++iter_;
+      return *this;
+    }
+
+    State *source() const { return graph_->get_state(iter_->source_); }
+    unsigned int source_id() const { return iter_->source_; }
+
+   private:
+    friend class TransitionGraph;
+
+    IncomingLinkIterator(TransitionGraph *graph, unsigned int target)
+      : graph_(graph), iter_(graph->incoming_.Begin(target)) {}
+
+    TransitionGraph *graph_;
+    CompactAdjacency<IncomingEdge>::iterator iter_;
+  };
+
+  TransitionGraph() : version_(0), structure_version_(0) {}
+
+  /**
+   * Adds a state to the graph with no links
+   *
+   * @param state QTable-internal state
+   * @return Dense id of the state within this graph
+   **/
+  unsigned int AddNode(State *state);
+
+  State *get_state(unsigned int id) const { return states_[id]; }
+  unsigned int size() const { return states_.size(); }
+
+  /**
+   * @return Counter bumped by every change to the graph's states or links,
+   *         and by MarkStructureChanged. It never goes backwards, even
+   *         across Clear.
+   **/
+  uint64_t get_version() const { return version_; }
+
+  /**
+   * @return get_version() as of the last change to the links out of the
+   *         state with id (or its addition to the graph)
+   **/
+  uint64_t get_node_version(unsigned int id) const {
+    return node_version_[id];
+  }
+
+  /**
+   * @return get_version() as of the last MarkStructureChanged or Clear
+   **/
+  uint64_t get_structure_version() const { return structure_version_; }
+
+  /**
+   * Records a change outside the graph that still affects every path
+   * through it, such as the owning table's goal states or nearby
+   * thresholds
+   **/
+  void MarkStructureChanged() { structure_version_ = ++version_; }
+
+  /**
+   * Sets the reward of one layer on the link source -> target, creating the
+   * link if needed. A value of 0 clears the layer, and clearing the last
+   * layer removes the link.
+   **/
+  void SetReward(unsigned int source, unsigned int target, LayerId layer,
+                 double val);
+
+  /**
+   * @return Reward of one layer of the link source -> target, 0 if there is
+   *         no link
+   **/
+  double GetReward(unsigned int source, unsigned int target, LayerId layer);
+
+  /**
+   * @return Reward summed over every layer of the link source -> target, 0
+   *         if there is no link
+   **/
+  double GetTotalReward(unsigned int source, unsigned int target);
+
+  /**
+   * Finds the greedy successor of source: the target of its reward link with
+   * the highest total reward, the earliest created winning ties. O(1) unless
+   * source's links changed in a way that needs a rescan.
+   *
+   * @param target Populated with the successor's id
+   * @param value Populated with the total reward of the link to it
+   * @return false if source has no reward links
+   **/
+  bool GetBestSuccessor(unsigned int source, unsigned int *target,
+                        double *value);
+
+  /**
+   * Rebuilds every state's cached greedy successor. Lookups do this lazily
+   * per state, so this only front-loads the cost after large reward changes.
+   **/
+  void RecomputePolicy();
+
+  /**
+   * Iterates over the raw reward edges out of source, in the order they were
+   * created. Invalidated when a link is added.
+   **/
+  reward_iterator RewardsBegin(unsigned int source) {
+    return rewards_.Begin(source);
+  }
+
+  /**
+   * @return Iterator over the reward links out of source, in the order they
+   *         were created
+   **/
+  RewardLinkIterator RewardLinks(unsigned int source) {
+    return RewardLinkIterator(this, source);
+  }
+
+  /**
+   * @return Iterator over the states linking into target, in the order the
+   *         links were created
+   **/
+  IncomingLinkIterator IncomingLinks(unsigned int target) {
+    return IncomingLinkIterator(this, target);
+  }
+
+  /**
+   * @return Sum of every reward layer on edge
+   **/
+  static double SumRewards(RewardEdge const &edge) {
+    double total = 0.;
+    for (unsigned int slot = 0; slot < MAX_REWARD_LAYERS; ++slot)
+      total += edge.rewards_[slot];
+    return total;
+  }
+
+  /**
+   * Populates rewards with every reward link out of source, keyed by
+   * target state and then by layer name
+   **/
+  void GetRewards(unsigned int source,
+                  std::map<State*, std::map<std::string, double> > *rewards);
+
+  /**
+   * Populates sources with every state that has a reward link into target,
+   * in the order the links were created
+   **/
+  void GetIncoming(unsigned int target, std::vector<State *> *sources);
+
+  /**
+   * Records a sample of action leading from source to target. A new
+   * transition starts at frequency; an existing one is incremented.
+   **/
+  void Connect(unsigned int source, unsigned int target, ActionId action,
+               int frequency);
+
+  /**
+   * Finds the action most likely to lead from source to target. Ties go to
+   * the action whose serialized form sorts first.
+   *
+   * @param action Populated with the best action's ID
+   * @return false if no action is known to lead from source to target
+   **/
+  bool GetBestAction(unsigned int source, unsigned int target,
+                     ActionId *action);
+
+  /**
+   * Populates transitions with every action transition out of source, keyed
+   * by action and listed in the order they were first recorded
+   **/
+  void GetActionTransitions(
+    unsigned int source,
+    std::map<std::string, std::vector<std::pair<State *, int> > >
+      *transitions);
+
+  /**
+   * Folds pending and removed edges back into compacted storage
+   **/
+  void Compact();
+
+  /**
+   * Removes every state and link
+   **/
+  void Clear();
+
+ private:
+  /**
+   * Unlinks source from target's incoming edges
+   **/
+  void RemoveIncoming(unsigned int source, unsigned int target);
+
+  /**
+   * Bumps the version for a change to the links out of source
+   **/
+  void TouchNode(unsigned int source) { node_version_[source] = ++version_; }
+
+  /**
+   * Updates source's cached successor after the total reward of its link to
+   * target became total
+   *
+   * @param appended The link was just created, so it is source's last link
+   **/
+  void UpdatePolicy(unsigned int source, unsigned int target, double total,
+                    bool appended);
+
+  /**
+   * Rescans source's links to rebuild its cached successor
+   **/
+  void RecomputePolicy(unsigned int source);
+
+  /**
+   * Cached greedy successor of one state. target_ is NO_SUCCESSOR while the
+   * state has no links.
+   **/
+  struct PolicyEntry {
+    unsigned int target_;
+    double value_;
+    bool stale_;
+  };
+
+  static const unsigned int NO_SUCCESSOR = 0xFFFFFFFF;
+
+  std::vector<State *> states_;
+  std::vector<PolicyEntry> policy_;
+
+  uint64_t version_;
+  uint64_t structure_version_;
+  std::vector<uint64_t> node_version_;
+
+  CompactAdjacency<RewardEdge> rewards_;
+  CompactAdjacency<IncomingEdge> incoming_;
+  CompactAdjacency<ActionEdge> actions_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_TRANSITIONGRAPH_H_
@@ -0,0 +1,287 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for the QTable transition graph
+ **/
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include "QLearner/QTable.h"
+#include "QLearner/State.h"
+#include "QLearner/TransitionGraph.h"
+
+namespace Primitives {
+
+class TransitionGraphTest : public testing::Test {
+ protected:
+  TransitionGraphTest() {
+    for (int i = 0; i < 10; ++i) {
+      std::vector<double> state_vector(2, static_cast<double>(i));
+      State s(state_vector);
+      states_.push_back(q_table_.AddState(s));
+    }
+  }
+
+  virtual ~TransitionGraphTest() {}
+
+  QTable q_table_;
+  std::vector<State *> states_;
+};
+
+/**
+ * @test    Reward layers are set, summed and cleared per link, and links
+ *          disappear (along with their incoming entry) once empty
+ **/
+TEST_F(TransitionGraphTest, RewardLayers) {
+  State *a = states_[0], *b = states_[1], *c = states_[2];
+  a->set_reward(b, "base", 2.);
+  a->set_reward(b, "waypoint", 150.);
+  a->set_reward(c, "base", -1.);
+  c->set_reward(b, "base", 4.);
+
+  EXPECT_DOUBLE_EQ(152., a->GetRewardValue(b));
+  EXPECT_DOUBLE_EQ(2., a->GetRewardValue(b, false, "base"));
+  EXPECT_DOUBLE_EQ(0., a->GetRewardValue(b, false, "unknown"));
+  EXPECT_DOUBLE_EQ(0., b->GetRewardValue(a));
+
+  std::map<State*, std::map<std::string, double> > rewards = a->get_reward();
+  ASSERT_EQ(2u, rewards.size());
+  EXPECT_EQ(2u, rewards[b].size());
+  EXPECT_DOUBLE_EQ(150., rewards[b]["waypoint"]);
+
+  std::vector<State *> incoming = b->get_incoming_states();
+  ASSERT_EQ(2u, incoming.size());
+  EXPECT_EQ(a, incoming[0]);
+  EXPECT_EQ(c, incoming[1]);
+
+  a->set_reward(b, "waypoint", 0.);
+  EXPECT_EQ(2u, b->get_incoming_states().size());
+  a->set_reward(b, "base", 0.);
+  EXPECT_EQ(1u, a->get_reward().size());
+  incoming = b->get_incoming_states();
+  ASSERT_EQ(1u, incoming.size());
+  EXPECT_EQ(c, incoming[0]);
+
+  // Re-linking goes to the back of the incoming list
+  a->set_reward(b, "base", 1.);
+  incoming = b->get_incoming_states();
+  ASSERT_EQ(2u, incoming.size());
+  EXPECT_EQ(a, incoming[1]);
+}
+
+/**
+ * @test    Link iterators walk the same links as the copying accessors, and
+ *          survive links being cleared mid-walk
+ **/
+TEST_F(TransitionGraphTest, LinkIterators) {
+  State *a = states_[0], *b = states_[1], *c = states_[2];
+  a->set_reward(b, Registry::LAYER_BASE, 2.);
+  a->set_reward(b, Registry::LAYER_WAYPOINT, 3.);
+  a->set_reward(c, Registry::LAYER_WAYPOINT, 4.);
+  c->set_reward(b, Registry::LAYER_BASE, 1.);
+
+  TransitionGraph::RewardLinkIterator out = a->RewardLinks();
+  ASSERT_TRUE(out.valid());
+  EXPECT_EQ(b, out.target());
+  EXPECT_DOUBLE_EQ(2., out.reward(Registry::LAYER_BASE));
+  EXPECT_DOUBLE_EQ(5., out.total_reward());
+  ++out;
+  ASSERT_TRUE(out.valid());
+  EXPECT_EQ(c, out.target());
+  EXPECT_DOUBLE_EQ(0., out.reward(Registry::LAYER_BASE));
+  EXPECT_FALSE((++out).valid());
+
+  std::vector<State *> sources;
+  TransitionGraph::IncomingLinkIterator in;
+  for (in = b->IncomingLinks(); in.valid(); ++in) {
+    sources.push_back(in.source());
+    in.source()->set_reward(b, Registry::LAYER_BASE, 0.);
+  }
+  ASSERT_EQ(2u, sources.size());
+  EXPECT_EQ(a, sources[0]);
+  EXPECT_EQ(c, sources[1]);
+  EXPECT_EQ(1u, b->get_incoming_states().size());
+
+  State outside(std::vector<double>(2, 0.5));
+  EXPECT_FALSE(outside.RewardLinks().valid());
+  EXPECT_FALSE(outside.IncomingLinks().valid());
+}
+
+/**
+ * @test    The cached greedy successor tracks reward changes, ties and
+ *          removed links, and always matches a full rescan
+ **/
+TEST_F(TransitionGraphTest, BestSuccessor) {
+  State *a = states_[0], *b = states_[1], *c = states_[2], *d = states_[3];
+  State *successor = NULL;
+  double value = 0.;
+  EXPECT_FALSE(a->GetBestSuccessor(&successor, &value));
+
+  a->set_reward(b, Registry::LAYER_BASE, 2.);
+  a->set_reward(c, Registry::LAYER_BASE, 2.);
+  ASSERT_TRUE(a->GetBestSuccessor(&successor, &value));
+  EXPECT_EQ(b, successor);
+
+  a->set_reward(c, Registry::LAYER_WAYPOINT, 1.);
+  ASSERT_TRUE(a->GetBestSuccessor(&successor, &value));
+  EXPECT_EQ(c, successor);
+  EXPECT_DOUBLE_EQ(3., value);
+
+  // Lowering c back into a tie hands the step back to the older link
+  a->set_reward(c, Registry::LAYER_WAYPOINT, 0.);
+  ASSERT_TRUE(a->GetBestSuccessor(&successor, &value));
+  EXPECT_EQ(b, successor);
+
+  a->set_reward(d, Registry::LAYER_BASE, -1.);
+  a->set_reward(b, Registry::LAYER_BASE, 0.);
+  a->set_reward(c, Registry::LAYER_BASE, 0.);
+  ASSERT_TRUE(a->GetBestSuccessor(&successor, &value));
+  EXPECT_EQ(d, successor);
+  EXPECT_DOUBLE_EQ(-1., value);
+
+  // Random updates never leave the cache disagreeing with a rescan
+  srand(7);
+  TransitionGraph &graph = q_table_.get_graph();
+  for (int step = 0; step < 2000; ++step) {
+    State *source = states_[rand() % states_.size()];
+    State *target = states_[rand() % states_.size()];
+    LayerId layer = rand() % 2;
+    double reward = static_cast<double>(rand() % 5 - 1);
+    source->set_reward(target, layer, reward);
+
+    State *expected = NULL;
+    double expected_value = 0.;
+    TransitionGraph::RewardLinkIterator iter;
+    for (iter = source->RewardLinks(); iter.valid(); ++iter) {
+      if (expected == NULL || iter.total_reward() > expected_value) {
+        expected = iter.target();
+        expected_value = iter.total_reward();
+      }
+    }
+
+    successor = NULL;
+    EXPECT_EQ(expected != NULL, source->GetBestSuccessor(&successor, &value));
+    EXPECT_EQ(expected, successor);
+    if (step % 500 == 0) graph.RecomputePolicy();
+  }
+}
+
+/**
+ * @test    Action transitions count samples and pick the likeliest action
+ **/
+TEST_F(TransitionGraphTest, ActionTransitions) {
+  State *a = states_[0], *b = states_[1], *c = states_[2];
+  a->ConnectState(b, "left");
+  a->ConnectState(b, "left");
+  a->ConnectState(c, "left");
+  a->ConnectState(b, "right", 5);
+  a->ConnectState(c, "right", 5);
+
+  EXPECT_EQ("left", a->GetActionForTransition(b));
+  EXPECT_EQ("right", a->GetActionForTransition(c));
+  EXPECT_EQ("", a->GetActionForTransition(states_[3]));
+  EXPECT_EQ("", b->GetActionForTransition(a));
+
+  State outside(std::vector<double>(2, 0.5));
+  EXPECT_FALSE(a->ConnectState(&outside, "left"));
+}
+
+/**
+ * @test    Interned IDs and their string wrappers address the same layers
+ *          and actions
+ **/
+TEST_F(TransitionGraphTest, InternedIds) {
+  State *a = states_[0], *b = states_[1];
+  EXPECT_EQ("base", Registry::GetLayerName(Registry::LAYER_BASE));
+  EXPECT_EQ("waypoint", Registry::GetLayerName(Registry::LAYER_WAYPOINT));
+  EXPECT_EQ(Action::INTERPOLATE,
+            Registry::GetActionName(Registry::ACTION_INTERPOLATE));
+
+  a->set_reward(b, Registry::LAYER_WAYPOINT, 150.);
+  a->set_reward(b, "base", 2.);
+  EXPECT_DOUBLE_EQ(150., a->GetRewardValue(b, false, "waypoint"));
+  EXPECT_DOUBLE_EQ(2., a->GetRewardValue(b, Registry::LAYER_BASE));
+
+  a->ConnectState(b, Registry::ACTION_INTERPOLATE, 1);
+  EXPECT_EQ(Action::INTERPOLATE, a->GetActionForTransition(b));
+
+  ActionId id = Registry::InternAction("custom");
+  EXPECT_EQ(id, Registry::InternAction("custom"));
+  EXPECT_EQ("custom", Registry::GetActionName(id));
+
+  // Layers fill up at MAX_LAYERS; unknown layers are never registered by
+  // lookups
+  LayerId layer;
+  EXPECT_FALSE(Registry::FindLayer("unknown", &layer));
+  for (unsigned int i = Registry::GetLayerCount(); i < Registry::MAX_LAYERS;
+       ++i) {
+    char name[16];
+    snprintf(name, sizeof(name), "layer%u", i);
+    EXPECT_TRUE(Registry::InternLayer(name, &layer));
+    EXPECT_EQ(i, layer);
+  }
+  EXPECT_FALSE(Registry::InternLayer("overflow", &layer));
+}
+
+/**
+ * @test    Links survive compaction, including when compaction is triggered
+ *          part-way through building a state's links
+ **/
+TEST_F(TransitionGraphTest, Compaction) {
+  QTable table;
+  std::vector<State *> states;
+  for (int i = 0; i < 300; ++i) {
+    std::vector<double> state_vector(1, static_cast<double>(i));
+    State s(state_vector);
+    states.push_back(table.AddState(s));
+  }
+
+  // Interleave sources so every state's links end up split between
+  // compacted and pending storage
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 300; ++i) {
+      states[i]->set_reward(states[(i + round + 1) % 300], "base",
+                            round + 1.);
+    }
+  }
+  for (int i = 0; i < 300; i += 2)
+    states[i]->set_reward(states[(i + 3) % 300], "base", 0.);
+  table.get_graph().Compact();
+
+  for (int i = 0; i < 300; ++i) {
+    std::vector<int> expected_targets;
+    for (int round = 0; round < 10; ++round) {
+      if (i % 2 == 0 && round == 2) continue;
+      expected_targets.push_back((i + round + 1) % 300);
+    }
+
+    TransitionGraph &graph = table.get_graph();
+    TransitionGraph::reward_iterator iter;
+    unsigned int edge = 0;
+    for (iter = graph.RewardsBegin(states[i]->get_graph_id()); iter.valid();
+         ++iter, ++edge) {
+      ASSERT_LT(edge, expected_targets.size());
+      EXPECT_EQ(states[expected_targets[edge]],
+                graph.get_state(iter->target_));
+    }
+    EXPECT_EQ(expected_targets.size(), edge);
+
+    // Only the link from i - 3 was cleared, and only for even sources
+    unsigned int expected_incoming = ((i + 297) % 300) % 2 == 0 ? 9u : 10u;
+    EXPECT_EQ(expected_incoming, states[i]->get_incoming_states().size());
+  }
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,180 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an implementation of parallel value iteration over a QTable
+ **/
+
+#include <cmath>
+#include <ctime>
+#include "QLearner/ValueIteration.h"
+#include "QLearner/QTable.h"
+#include "QLearner/State.h"
+#include "QLearner/TransitionGraph.h"
+#include "Common/Utils.h"
+
+namespace Primitives {
+
+const double ValueIteration::DEFAULT_DISCOUNT_FACTOR = .9;
+const double ValueIteration::DEFAULT_THRESHOLD = 1E-6;
+
+/**
+ * @return Seconds on a monotonic clock
+ **/
+static double Now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + static_cast<double>(time.tv_nsec) / 1E9;
+}
+
+void ValueIteration::Snapshot() {
+  TransitionGraph &graph = q_table_->get_graph();
+  unsigned int node_count = graph.size();
+
+  offsets_.assign(1, 0);
+  targets_.clear();
+  rewards_.clear();
+  policy_link_.assign(node_count, -1);
+  for (unsigned int id = 0; id < node_count; ++id) {
+    unsigned int successor = 0;
+    double successor_value = 0.;
+    bool has_successor = mode_ == GREEDY_POLICY
+      && graph.GetBestSuccessor(id, &successor, &successor_value);
+
+    TransitionGraph::RewardLinkIterator iter;
+    for (iter = graph.RewardLinks(id); iter.valid(); ++iter) {
+      if (has_successor && iter.target_id() == successor)
+        policy_link_[id] = targets_.size();
+      targets_.push_back(iter.target_id());
+      rewards_.push_back(iter.total_reward() - iter.reward(value_layer_));
+    }
+    offsets_.push_back(targets_.size());
+  }
+
+  terminal_.assign(node_count, false);
+  std::vector<State *> const &goal_states = q_table_->get_goal_states();
+  std::vector<State *> const &trained_goal_states =
+    q_table_->get_trained_goal_states();
+  std::vector<State *>::const_iterator goal_iter;
+  for (goal_iter = goal_states.begin(); goal_iter != goal_states.end();
+       ++goal_iter) {
+    if ((*goal_iter)->get_graph() == &graph)
+      terminal_[(*goal_iter)->get_graph_id()] = true;
+  }
+  for (goal_iter = trained_goal_states.begin();
+       goal_iter != trained_goal_states.end(); ++goal_iter) {
+    if ((*goal_iter)->get_graph() == &graph)
+      terminal_[(*goal_iter)->get_graph_id()] = true;
+  }
+}
+
+void ValueIteration::SweepTask(void *arg, unsigned int worker,
+                               unsigned int begin, unsigned int end) {
+  ValueIteration *engine = reinterpret_cast<ValueIteration *>(arg);
+  std::vector<double> const &values = engine->values_[engine->current_];
+  std::vector<double> &next_values = engine->values_[1 - engine->current_];
+  double discount = engine->discount_factor_;
+  double residual = 0.;
+
+  for (unsigned int id = begin; id < end; ++id) {
+    double value = 0.;
+    if (engine->terminal_[id]) {
+      value = 0.;
+    } else if (engine->mode_ == GREEDY_POLICY) {
+      int link = engine->policy_link_[id];
+      if (link >= 0) {
+        value = engine->rewards_[link]
+                + discount * values[engine->targets_[link]];
+      }
+    } else {
+      unsigned int link_end = engine->offsets_[id + 1];
+      for (unsigned int link = engine->offsets_[id]; link < link_end;
+           ++link) {
+        double link_value = engine->rewards_[link]
+                            + discount * values[engine->targets_[link]];
+        if (link == engine->offsets_[id] || link_value > value)
+          value = link_value;
+      }
+    }
+
+    next_values[id] = value;
+    double change = fabs(value - values[id]);
+    if (change > residual) residual = change;
+  }
+
+  engine->residuals_[worker].residual_ = residual;
+}
+
+ValueIteration::Result ValueIteration::Run() {
+  Snapshot();
+  unsigned int node_count = offsets_.size() - 1;
+  values_[0].assign(node_count, 0.);
+  values_[1].assign(node_count, 0.);
+  current_ = 0;
+  residuals_.resize(pool_->size());
+
+  Result result;
+  result.sweeps_ = 0;
+  result.residual_ = 0.;
+  result.converged_ = false;
+
+  double start = Now();
+  while (result.sweeps_ < max_sweeps_) {
+    for (unsigned int i = 0; i < residuals_.size(); ++i)
+      residuals_[i].residual_ = 0.;
+    pool_->Run(&SweepTask, this, node_count);
+    current_ = 1 - current_;
+    ++result.sweeps_;
+
+    result.residual_ = 0.;
+    for (unsigned int i = 0; i < residuals_.size(); ++i) {
+      if (residuals_[i].residual_ > result.residual_)
+        result.residual_ = residuals_[i].residual_;
+    }
+    if (result.residual_ <= threshold_) {
+      result.converged_ = true;
+      break;
+    }
+  }
+  result.seconds_ = Now() - start;
+  result.sweeps_per_second_ = result.seconds_ > 0.
+                              ? result.sweeps_ / result.seconds_ : 0.;
+
+  char buf[1024];
+  snprintf(buf, sizeof(buf), "ValueIteration: %u sweeps over %u states "
+           "(%g sweeps/s on %u workers), residual %g%s", result.sweeps_,
+           node_count, result.sweeps_per_second_, pool_->size(),
+           result.residual_, result.converged_ ? "" : " (not converged)");
+  Log(stderr, DEBUG, buf);
+  return result;
+}
+
+double ValueIteration::GetValue(State const *state) const {
+  if (state == NULL || state->get_graph() != &q_table_->get_graph()
+      || state->get_graph_id() >= values_[current_].size())
+    return 0.;
+  return values_[current_][state->get_graph_id()];
+}
+
+unsigned int ValueIteration::ApplyValues() {
+  TransitionGraph &graph = q_table_->get_graph();
+  std::vector<double> const &values = values_[current_];
+  unsigned int written = 0;
+
+  // Only existing links are rewritten, so walking them stays valid
+  for (unsigned int id = 0; id < values.size(); ++id) {
+    TransitionGraph::RewardLinkIterator iter;
+    for (iter = graph.RewardLinks(id); iter.valid(); ++iter) {
+      if (iter.target_id() >= values.size()) continue;
+      graph.SetReward(id, iter.target_id(), value_layer_,
+                      discount_factor_ * values[iter.target_id()]);
+      ++written;
+    }
+  }
+  return written;
+}
+
+}  // namespace Primitives
@@ -0,0 +1,146 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * This is an interface for synchronous value iteration over a QTable's
+ * transition graph, treating each reward link as a deterministic
+ * transition worth its total reward and the table's goal states as
+ * terminal.
+ *
+ * Run first snapshots the graph into flat arrays, then sweeps every state
+ * once per iteration across a WorkerPool. Sweeps are double-buffered: each
+ * reads only the previous sweep's values and writes only its own states'
+ * new values, so workers never share writes and the result does not
+ * depend on how states are split between them.
+ *
+ * One reward layer holds the engine's output (see ApplyValues) and is left
+ * out of the rewards it reads, so refining a skill repeatedly never counts
+ * earlier results as reward.
+ **/
+
+#ifndef _SHL_PRIMITIVES_QLEARNER_VALUEITERATION_H_
+#define _SHL_PRIMITIVES_QLEARNER_VALUEITERATION_H_
+
+#include <vector>
+#include "Common/WorkerPool.h"
+#include "QLearner/Registry.h"
+
+namespace Primitives {
+
+class QTable;
+class State;
+
+class ValueIteration {
+ public:
+  enum Mode {
+    OPTIMAL_VALUES,  // Value iteration: each state takes its best link
+    GREEDY_POLICY    // Policy evaluation of the table's greedy successors
+  };
+
+  /**
+   * Outcome of one Run
+   **/
+  struct Result {
+    unsigned int sweeps_;
+    double residual_;  // Largest change in any value during the last sweep
+    bool converged_;
+    double seconds_;
+    double sweeps_per_second_;
+  };
+
+  static const double DEFAULT_DISCOUNT_FACTOR;
+  static const double DEFAULT_THRESHOLD;
+  static const unsigned int DEFAULT_MAX_SWEEPS = 1000;
+
+  /**
+   * @param q_table Table whose transition graph is evaluated
+   * @param pool Workers to sweep with; not owned
+   * @param value_layer Layer ApplyValues writes to, ignored when reading
+   *                    rewards
+   **/
+  ValueIteration(QTable *q_table, WorkerPool *pool, LayerId value_layer)
+    : q_table_(q_table), pool_(pool), value_layer_(value_layer),
+      mode_(OPTIMAL_VALUES), discount_factor_(DEFAULT_DISCOUNT_FACTOR),
+      threshold_(DEFAULT_THRESHOLD), max_sweeps_(DEFAULT_MAX_SWEEPS),
+      current_(0) {}
+
+  void set_mode(Mode mode) { mode_ = mode; }
+  void set_discount_factor(double discount) { discount_factor_ = discount; }
+
+  /**
+   * Sweeping stops once no value changes by more than threshold
+   **/
+  void set_threshold(double threshold) { threshold_ = threshold; }
+  void set_max_sweeps(unsigned int sweeps) { max_sweeps_ = sweeps; }
+
+  /**
+   * Snapshots the table and sweeps from all-zero values until they
+   * converge or max_sweeps is reached
+   **/
+  Result Run();
+
+  /**
+   * @return Value of state after the last Run, 0 for states the run didn't
+   *         cover
+   **/
+  double GetValue(State const *state) const;
+
+  /**
+   * Writes the discounted value of each link's target into value_layer on
+   * every reward link the last Run covered, so the table's greedy policy
+   * follows the highest reward-plus-value link
+   *
+   * @return Number of links written
+   **/
+  unsigned int ApplyValues();
+
+ private:
+  /**
+   * Flattens the table's reward links (less value_layer) into offsets_,
+   * targets_ and rewards_, and marks its goal states terminal
+   **/
+  void Snapshot();
+
+  /**
+   * WorkerPool task: computes the next values of states [begin, end)
+   **/
+  static void SweepTask(void *arg, unsigned int worker, unsigned int begin,
+                        unsigned int end);
+
+  /**
+   * Largest change made by one worker's share of a sweep, padded so
+   * workers don't write to the same cache line
+   **/
+  struct WorkerResidual {
+    double residual_;
+    char padding_[64 - sizeof(double)];
+  };
+
+  QTable *q_table_;
+  WorkerPool *pool_;
+  LayerId value_layer_;
+  Mode mode_;
+  double discount_factor_;
+  double threshold_;
+  unsigned int max_sweeps_;
+
+  // Snapshot: links out of state i are [offsets_[i], offsets_[i + 1]).
+  // policy_link_ is the index of each state's greedy link, -1 for none.
+  std::vector<unsigned int> offsets_;
+  std::vector<unsigned int> targets_;
+  std::vector<double> rewards_;
+  std::vector<int> policy_link_;
+  std::vector<bool> terminal_;
+
+  // values_[current_] holds the latest sweep's values
+  std::vector<double> values_[2];
+  unsigned int current_;
+  std::vector<WorkerResidual> residuals_;
+};
+
+}  // namespace Primitives
+
+#endif  // _SHL_PRIMITIVES_QLEARNER_VALUEITERATION_H_
@@ -0,0 +1,139 @@
+/**
+ * @file
+ * @author Brad Hayes <hayesbh@gmail.com>
+ * @version 0.1
+ *
+ * @section DESCRIPTION
+ *
+ * Testing for parallel value iteration over a QTable
+ **/
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "Common/WorkerPool.h"
+#include "QLearner/QTable.h"
+#include "QLearner/Registry.h"
+#include "QLearner/State.h"
+#include "QLearner/ValueIteration.h"
+
+namespace Primitives {
+
+class ValueIterationTest : public testing::Test {
+ protected:
+  /**
+   * A chain 0 -> 1 -> ... -> 5 worth 1 per step, ending at goal state 5,
+   * plus a shortcut 0 -> 4 worth 2 and a dead end 0 -> 6 worth 2.2
+   **/
+  ValueIterationTest() {
+    for (int i = 0; i < 7; ++i) {
+      std::vector<double> state_vector(1, static_cast<double>(i));
+      states_.push_back(q_table_.AddState(State(state_vector)));
+    }
+    for (int i = 0; i < 5; ++i)
+      states_[i]->set_reward(states_[i + 1], Registry::LAYER_BASE, 1.);
+    states_[0]->set_reward(states_[4], Registry::LAYER_BASE, 2.);
+    states_[0]->set_reward(states_[6], Registry::LAYER_BASE, 2.2);
+    q_table_.AddGoalState(states_[5], true);
+    Registry::InternLayer("value", &value_layer_);
+  }
+
+  QTable q_table_;
+  std::vector<State *> states_;
+  LayerId value_layer_;
+};
+
+/**
+ * @test    Values match the Bellman optimality equation on a small chain
+ **/
+TEST_F(ValueIterationTest, OptimalValues) {
+  WorkerPool pool(3);
+  ValueIteration engine(&q_table_, &pool, value_layer_);
+  engine.set_discount_factor(.5);
+  ValueIteration::Result result = engine.Run();
+  EXPECT_TRUE(result.converged_);
+  EXPECT_GT(result.sweeps_per_second_, 0.);
+
+  EXPECT_DOUBLE_EQ(0., engine.GetValue(states_[5]));
+  EXPECT_DOUBLE_EQ(1., engine.GetValue(states_[4]));
+  EXPECT_DOUBLE_EQ(1.5, engine.GetValue(states_[3]));
+  EXPECT_DOUBLE_EQ(1.75, engine.GetValue(states_[2]));
+  EXPECT_DOUBLE_EQ(1.875, engine.GetValue(states_[1]));
+  EXPECT_DOUBLE_EQ(2.5, engine.GetValue(states_[0]));
+
+  // Following the rewards alone takes the dead end; following the values
+  // takes the chain. Re-running ignores the values already written.
+  State *successor = NULL;
+  double value = 0.;
+  ASSERT_TRUE(states_[0]->GetBestSuccessor(&successor, &value));
+  EXPECT_EQ(states_[6], successor);
+  EXPECT_EQ(7u, engine.ApplyValues());
+  engine.Run();
+  EXPECT_DOUBLE_EQ(2.5, engine.GetValue(states_[0]));
+  ASSERT_TRUE(states_[0]->GetBestSuccessor(&successor, &value));
+  EXPECT_EQ(states_[4], successor);
+  EXPECT_DOUBLE_EQ(2.5, value);
+}
+
+/**
+ * @test    Policy evaluation follows the greedy successor instead of the
+ *          best link
+ **/
+TEST_F(ValueIterationTest, GreedyPolicy) {
+  WorkerPool pool(2);
+  ValueIteration engine(&q_table_, &pool, value_layer_);
+  engine.set_mode(ValueIteration::GREEDY_POLICY);
+  engine.set_discount_factor(.5);
+  engine.Run();
+  EXPECT_DOUBLE_EQ(2.2, engine.GetValue(states_[0]));
+  EXPECT_DOUBLE_EQ(1.875, engine.GetValue(states_[1]));
+
+  states_[0]->set_reward(states_[6], Registry::LAYER_BASE, 0.);
+  engine.Run();
+  EXPECT_DOUBLE_EQ(2.5, engine.GetValue(states_[0]));
+
+  State outside(std::vector<double>(1, 0.));
+  EXPECT_DOUBLE_EQ(0., engine.GetValue(&outside));
+}
+
+/**
+ * @test    Sweeps stop at max_sweeps, and any number of workers gives the
+ *          same values as one
+ **/
+TEST_F(ValueIterationTest, WorkerCounts) {
+  QTable table;
+  std::vector<State *> states;
+  srand(5);
+  for (int i = 0; i < 500; ++i) {
+    std::vector<double> state_vector(1, static_cast<double>(i));
+    states.push_back(table.AddState(State(state_vector)));
+  }
+  for (int i = 0; i < 3000; ++i) {
+    states[rand() % 500]->set_reward(states[rand() % 500],
+                                     Registry::LAYER_BASE,
+                                     static_cast<double>(rand() % 7 - 2));
+  }
+
+  WorkerPool single(1);
+  ValueIteration reference(&table, &single, value_layer_);
+  reference.set_max_sweeps(5);
+  ValueIteration::Result result = reference.Run();
+  EXPECT_EQ(5u, result.sweeps_);
+  EXPECT_FALSE(result.converged_);
+  reference.set_max_sweeps(ValueIteration::DEFAULT_MAX_SWEEPS);
+  reference.Run();
+
+  WorkerPool pool(4);
+  ValueIteration engine(&table, &pool, value_layer_);
+  engine.Run();
+  for (int i = 0; i < 500; ++i)
+    EXPECT_EQ(reference.GetValue(states[i]), engine.GetValue(states[i]));
+}
+
+}  // namespace Primitives
+
+int main(int argc, char* argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -183,8 +183,8 @@ QLearner* LBDStudent::LearnSkillFromFile(string filename, string skill_name) {
 
       weight = MAX_REWARD / (static_cast<double>(connect_count));
       if (root != connect_state) {
-       root->set_reward(connect_state, "base", weight);
-       root->ConnectState(connect_state, Primitives::Action::INTERPOLATE);
+       root->set_reward(connect_state, Registry::LAYER_BASE, weight);
+       root->ConnectState(connect_state, Registry::ACTION_INTERPOLATE, 1);
       }
     }
     
@@ -194,6 +194,10 @@ QLearner* LBDStudent::LearnSkillFromFile(string filename, string skill_name) {
 
   training_file.close();
 
+  // Every state's links were just rebuilt; settle the greedy policy in one
+  // pass instead of rescanning each state on its first traversal
+  qt->get_graph().RecomputePolicy();
+
   char buf[4096];
   snprintf(buf, sizeof(buf), "Finished loading %d frames into LBD Student "
     "for %s. It now has %ld states", (frame_num-1), skill_name.c_str(),
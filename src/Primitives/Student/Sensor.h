@@ -75,6 +75,14 @@ class Sensor {
    **/
   virtual std::string const &get_name() const { return name_; }
 
+  /**
+   * Tells whether the sensor still has data to give.  Live sensors always
+   * do; a recording stops once it has played out.
+   *
+   * @return False once the sensor has nothing left to read
+   **/
+  virtual bool running() { return true; }
+
  protected:
   /**
    * Polls the associated sensor to get its new value